@@ -0,0 +1,1096 @@
+// Render benchmarks for the map layers.
+//
+// Runs headless (offscreen platform) on synthetic data so results do not
+// depend on the shipped GeoJSON files. Usage:
+//   mapbench [--list] [case ...]
+#include <cstdlib>
+#include <atomic>
+#include <algorithm>
+#include <QGuiApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QStringList>
+#include <QThread>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+#include <QFileInfo>
+#include <QtMath>
+#include <QFontMetrics>
+#include <QLoggingCategory>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QFile>
+#include <QDir>
+#include <QMap>
+#include <functional>
+#include "maprenderer.h"
+#include "stationsearchindex.h"
+#include "reversegeocoder.h"
+#include "geometrytilestore.h"
+#include "spatialorder.h"
+#include "rastertilearchive.h"
+#include "framearena.h"
+#include "memoryreport.h"
+#include "mapstyle.h"
+#include "geojsonloader.h"
+#include "vectortilesource.h"
+#include "framecache.h"
+
+namespace {
+
+// Heap allocations made by the whole process so far
+std::atomic<qint64> allocationCount(0);
+
+} // namespace
+
+// Counting allocator. glibc lets the executable interpose malloc, so every
+// heap allocation (operator new, Qt's containers, the paint engine) passes
+// through here on its way to the real allocator.
+#if defined(__GLIBC__)
+#define ALLOCATION_COUNTING
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+}
+#endif
+
+namespace {
+
+QTextStream out(stdout);
+
+struct BenchCase {
+    const char *name;
+    const char *description;
+    std::function<void()> run;
+};
+
+// India-sized bounding box in lon/lat
+const double MIN_LON = 68.0, MAX_LON = 97.0;
+const double MIN_LAT = 8.0, MAX_LAT = 37.0;
+
+struct SyntheticMap {
+    MapScene scene;
+    TrackGeometryCache trackCache;
+};
+
+// Wavy ring around the middle of the box
+QPolygonF syntheticBoundary(int vertices = 20000)
+{
+    QPolygonF boundary;
+    for (int i = 0; i < vertices; ++i) {
+        double a = 2 * M_PI * i / vertices;
+        double r = 1.0 + 0.05 * std::sin(a * 40);
+        boundary << QPointF((MIN_LON + MAX_LON) / 2 + 13 * r * std::cos(a),
+                            (MIN_LAT + MAX_LAT) / 2 + 13 * r * std::sin(a));
+    }
+    return boundary;
+}
+
+// Stations on a random walk (so consecutive stations are near each other,
+// like a real line), a many-vertex boundary, a grid of states and rivers
+void buildSyntheticMap(SyntheticMap &map, int stationCount, int riverVertices, quint32 seed = 42)
+{
+    QRandomGenerator rng(seed);
+    MapScene &scene = map.scene;
+
+    double lon = (MIN_LON + MAX_LON) / 2, lat = (MIN_LAT + MAX_LAT) / 2;
+    QVector<QPointF> trackNodes;
+    for (int i = 0; i < stationCount; ++i) {
+        lon = qBound(MIN_LON, lon + (rng.generateDouble() - 0.5) * 0.4, MAX_LON);
+        lat = qBound(MIN_LAT, lat + (rng.generateDouble() - 0.5) * 0.4, MAX_LAT);
+        Station station;
+        station.id = i;
+        station.name = QString("Station %1 (S%1)").arg(i);
+        station.lat = lat;
+        station.lon = lon;
+        scene.stations.append(station);
+        trackNodes.append(QPointF(lon, lat));
+    }
+    map.trackCache.setNodes(trackNodes);
+    scene.trackCache = &map.trackCache;
+
+    scene.indiaBoundary.append(LocalPolygon::fromGeo(syntheticBoundary(), scene.view.projection, true));
+
+    for (int gx = 0; gx < 6; ++gx) {
+        for (int gy = 0; gy < 6; ++gy) {
+            StateFeature state;
+            state.name = QString("State %1-%2").arg(gx).arg(gy);
+            state.type = "state_border";
+            state.minZoom = 0;
+            double x0 = MIN_LON + gx * 4.5, y0 = MIN_LAT + gy * 4.5;
+            QPolygonF polygon;
+            for (int i = 0; i <= 200; ++i) polygon << QPointF(x0 + 4.5 * i / 200, y0 + 0.1 * std::sin(i));
+            for (int i = 0; i <= 200; ++i) polygon << QPointF(x0 + 4.5, y0 + 4.5 * i / 200);
+            for (int i = 200; i >= 0; --i) polygon << QPointF(x0 + 4.5 * i / 200, y0 + 4.5);
+            for (int i = 200; i >= 0; --i) polygon << QPointF(x0, y0 + 4.5 * i / 200);
+            state.polygons.append(polygon);
+            state.reproject(scene.view.projection);
+            scene.stateBoundaries.append(state);
+        }
+    }
+
+    if (riverVertices > 1) {
+        StateFeature river;
+        river.name = "River";
+        river.type = "river";
+        river.minZoom = 0;
+        for (int i = 0; i < riverVertices; ++i) {
+            double t = static_cast<double>(i) / (riverVertices - 1);
+            river.lineString << QPointF(MIN_LON + t * (MAX_LON - MIN_LON),
+                                        MIN_LAT + 10 + 3 * std::sin(t * 60));
+        }
+        river.reproject(scene.view.projection);
+        scene.stateBoundaries.append(river);
+    }
+    MapStyle::defaultStyle().compile(scene.stateBoundaries);
+
+    scene.view.centerLat = (MIN_LAT + MAX_LAT) / 2;
+    scene.view.centerLon = (MIN_LON + MAX_LON) / 2;
+    scene.view.size = QSize(1920, 1080);
+    scene.view.scale = 0.35;
+}
+
+// Average milliseconds per call of fn over at least minMs of wall time
+double timeMs(const std::function<void()> &fn, int minIterations = 5, qint64 minMs = 500)
+{
+    fn(); // Warm up caches
+    QElapsedTimer timer;
+    timer.start();
+    int iterations = 0;
+    while (iterations < minIterations || timer.elapsed() < minMs) {
+        fn();
+        ++iterations;
+    }
+    return static_cast<double>(timer.nsecsElapsed()) / 1e6 / iterations;
+}
+
+void benchRenderThreads()
+{
+    SyntheticMap map;
+    buildSyntheticMap(map, 20000, 100000);
+
+    const double scales[] = { 0.35, 5.0 };
+    for (double scale : scales) {
+        map.scene.view.scale = scale;
+        out << "scale " << scale << ", " << map.scene.view.size.width() << "x" << map.scene.view.size.height() << "\n";
+
+        // 1, 2, 4, ... and the machine's core count
+        int maxThreads = qMax(1, QThread::idealThreadCount());
+        QVector<int> threadCounts;
+        for (int threads = 1; threads < maxThreads; threads *= 2) threadCounts.append(threads);
+        threadCounts.append(maxThreads);
+
+        double baseline = 0;
+        for (int threads : threadCounts) {
+            MapRenderer renderer(threads);
+            double ms = timeMs([&]() { renderer.renderStaticLayers(map.scene); });
+            if (threads == 1) baseline = ms;
+            out << QString("  threads %1  %2 ms/frame  speedup %3x\n")
+                   .arg(threads, 2).arg(ms, 8, 'f', 2).arg(baseline / ms, 5, 'f', 2);
+            out.flush();
+        }
+    }
+}
+
+// Pronounceable names with a station code, e.g. "Varamkota Junction (VMK)"
+QVector<Station> syntheticStationNames(int count, quint32 seed = 7)
+{
+    static const char *syllables[] = {
+        "ba", "bad", "del", "gan", "gar", "hi", "jam", "ka", "kot", "lu", "ma", "na",
+        "nag", "pur", "ra", "ram", "sa", "tal", "ur", "va", "wa", "ya", "pat", "cha"
+    };
+    static const char *suffixes[] = { "", "", "", " Junction", " Cantt", " Road", " City", " Town" };
+    const int syllableCount = int(sizeof(syllables) / sizeof(syllables[0]));
+    const int suffixCount = int(sizeof(suffixes) / sizeof(suffixes[0]));
+
+    QRandomGenerator rng(seed);
+    QVector<Station> stations(count);
+    for (int i = 0; i < count; ++i) {
+        QString word;
+        int parts = 2 + rng.bounded(3);
+        for (int p = 0; p < parts; ++p) word += syllables[rng.bounded(syllableCount)];
+        word[0] = word[0].toUpper();
+
+        QString code;
+        int codeLength = 2 + rng.bounded(3);
+        for (int c = 0; c < codeLength; ++c) code += QChar('A' + rng.bounded(26));
+
+        stations[i].id = i;
+        stations[i].name = QString("%1%2 (%3)").arg(word, suffixes[rng.bounded(suffixCount)], code);
+    }
+    return stations;
+}
+
+void benchStationSearch()
+{
+    const int counts[] = { 10000, 100000 };
+    for (int count : counts) {
+        QVector<Station> stations = syntheticStationNames(count);
+        StationSearchIndex index;
+        double buildMs = timeMs([&]() { index.build(stations); }, 3, 0);
+        out << QString("stations %1  cold build %2 ms\n").arg(count, 6).arg(buildMs, 8, 'f', 2);
+
+        // Typed one key at a time: a name, its code, a multi-word query and a typo
+        QString name = stations[count / 2].name;
+        QString code = name.mid(name.lastIndexOf('(') + 1).chopped(1);
+        QString word = name.left(name.indexOf(QRegularExpression("[ (]")));
+        QStringList queries = {
+            name.left(name.lastIndexOf('(')).trimmed(),
+            code,
+            word.left(3) + " " + code.left(2),
+            word.left(2) + word.mid(3) // One letter dropped
+        };
+
+        for (const QString &query : queries) {
+            double totalUs = 0, worstUs = 0;
+            int matches = 0;
+            for (int length = 1; length <= query.size(); ++length) {
+                QString typed = query.left(length);
+                double us = timeMs([&]() { matches = index.search(typed).size(); }, 20, 2) * 1000;
+                totalUs += us;
+                worstUs = qMax(worstUs, us);
+            }
+            out << QString("  %1  %2 us/key avg  %3 us/key worst  %4 results\n")
+                   .arg(QString("\"%1\"").arg(query), -28).arg(totalUs / query.size(), 7, 'f', 1)
+                   .arg(worstUs, 7, 'f', 1).arg(matches);
+            out.flush();
+        }
+    }
+}
+
+void benchReverseGeocode()
+{
+    SyntheticMap map;
+    buildSyntheticMap(map, 100000, 0);
+
+    ReverseGeocoder geocoder;
+    QElapsedTimer timer;
+    timer.start();
+    geocoder.setStations(map.scene.stations);
+    geocoder.setFeatures(map.scene.stateBoundaries);
+    out << QString("index build %1 ms (%2 stations, %3 features)\n")
+           .arg(timer.nsecsElapsed() / 1e6, 0, 'f', 2).arg(map.scene.stations.size()).arg(map.scene.stateBoundaries.size());
+
+    QRandomGenerator rng(1);
+    QVector<QPointF> queries(10000);
+    for (QPointF &query : queries) {
+        query = QPointF(MIN_LON + rng.generateDouble() * (MAX_LON - MIN_LON),
+                        MIN_LAT + rng.generateDouble() * (MAX_LAT - MIN_LAT));
+    }
+
+    int hits = 0;
+    double stateMs = timeMs([&]() {
+        hits = 0;
+        for (const QPointF &query : queries) hits += geocoder.featureAt(query.y(), query.x()) >= 0;
+    });
+    out << QString("  state at point      %1 us/query  (%2% inside a state)\n")
+           .arg(stateMs * 1000 / queries.size(), 7, 'f', 2).arg(100.0 * hits / queries.size(), 0, 'f', 1);
+
+    const int ks[] = { 1, 10 };
+    for (int k : ks) {
+        double nearestMs = timeMs([&]() {
+            for (const QPointF &query : queries) geocoder.nearestStations(query.y(), query.x(), k);
+        });
+        out << QString("  nearest %1 station%2  %3 us/query\n")
+               .arg(k, 2).arg(k == 1 ? " " : "s").arg(nearestMs * 1000 / queries.size(), 7, 'f', 2);
+    }
+    out.flush();
+}
+
+void benchPolygonFill()
+{
+    SyntheticMap map;
+    buildSyntheticMap(map, 0, 0);
+    map.scene.stateBoundaries.clear();
+    map.scene.trackCache = nullptr;
+
+    QElapsedTimer timer;
+    timer.start();
+    const LocalPolygon &boundary = map.scene.indiaBoundary.first();
+    PolygonMesh mesh(boundary.points);
+    out << QString("triangulate %1 vertices -> %2 triangles in %3 ms\n")
+           .arg(boundary.points.size()).arg(mesh.triangleCount()).arg(timer.nsecsElapsed() / 1e6, 0, 'f', 2);
+
+    // Same scene without meshes: every frame fills the whole outline
+    MapScene plain = map.scene;
+    for (LocalPolygon &polygon : plain.indiaBoundary) polygon.mesh = PolygonMesh();
+
+    MapRenderer renderer(1);
+    const double scales[] = { 0.35, 5.0, 40.0 };
+    for (double scale : scales) {
+        map.scene.view.scale = plain.view.scale = scale;
+        // Look at the boundary rather than the empty middle when zoomed in
+        map.scene.view.centerLat = plain.view.centerLat = (MIN_LAT + MAX_LAT) / 2 + 13;
+        double polygonMs = timeMs([&]() { renderer.renderStaticLayers(plain); });
+        double meshMs = timeMs([&]() { renderer.renderStaticLayers(map.scene); });
+        out << QString("  scale %1  drawPolygon %2 ms  mesh %3 ms\n")
+               .arg(scale, 5).arg(polygonMs, 7, 'f', 2).arg(meshMs, 7, 'f', 2);
+        out.flush();
+    }
+}
+
+void benchAnimationFrame()
+{
+    SyntheticMap map;
+    buildSyntheticMap(map, 20000, 100000);
+    MapRenderer renderer;
+
+    // A settled frame, then one step of a 1.2x zoom
+    MapView settled = map.scene.view;
+    QImage cached = renderer.renderStaticLayers(map.scene);
+    map.scene.view.scale *= 1.1;
+    QImage frame(map.scene.view.size, QImage::Format_ARGB32_Premultiplied);
+
+    double renderMs = timeMs([&]() { renderer.renderStaticLayers(map.scene); });
+    double scaledMs = timeMs([&]() {
+        QPainter painter(&frame);
+        painter.fillRect(frame.rect(), Qt::white);
+        painter.setTransform(map.scene.view.transformFrom(settled));
+        painter.drawImage(0, 0, cached);
+    });
+    out << QString("  re-render %1 ms/frame  scaled cache %2 ms/frame\n")
+           .arg(renderMs, 7, 'f', 2).arg(scaledMs, 7, 'f', 2);
+    out.flush();
+}
+
+void benchTileStream()
+{
+    SyntheticMap map;
+    buildSyntheticMap(map, 0, 100000);
+    map.scene.trackCache = nullptr;
+
+    QTemporaryDir directory;
+    QElapsedTimer timer;
+    timer.start();
+    QVector<QPolygonF> boundary = { syntheticBoundary() };
+    if (!GeometryTileStore::build(directory.filePath("geometry.store"), map.scene.stateBoundaries, boundary, QString())) return;
+    GeometryTileStore store;
+    store.open(directory.filePath("geometry.store"));
+    out << QString("store build %1 ms\n").arg(timer.nsecsElapsed() / 1e6, 0, 'f', 2);
+
+    qint64 points = boundary.first().size();
+    for (const auto &feature : map.scene.stateBoundaries) {
+        for (const auto &polygon : feature.polygons) points += polygon.size();
+        points += feature.lineString.size();
+    }
+    out << QString("source geometry %1 KB as doubles, store file %2 KB (all levels, quantized on disk)\n")
+           .arg(points * sizeof(QPointF) / 1024).arg(QFileInfo(directory.filePath("geometry.store")).size() / 1024);
+
+    // Same data, drawn from tiles instead of the in-memory features
+    MapScene streamed = map.scene;
+    streamed.tileStore = &store;
+
+    MapRenderer renderer(1);
+    const double scales[] = { 0.35, 5.0, 40.0, 400.0 };
+    for (double scale : scales) {
+        map.scene.view.scale = streamed.view.scale = scale;
+        // Look at the boundary, where the detail is
+        map.scene.view.centerLat = streamed.view.centerLat = (MIN_LAT + MAX_LAT) / 2 + 13;
+        double memoryMs = timeMs([&]() { renderer.renderStaticLayers(map.scene); });
+        double streamedMs = timeMs([&]() { renderer.renderStaticLayers(streamed); });
+        out << QString("  scale %1  in-memory %2 ms  streamed %3 ms  (level %4, %5 KB of tiles cached)\n")
+               .arg(scale, 5).arg(memoryMs, 7, 'f', 2).arg(streamedMs, 7, 'f', 2)
+               .arg(store.levelFor(streamed.view.pixelsPerUnit()), 2).arg(store.cachedKilobytes());
+        out.flush();
+    }
+}
+
+void benchStationOrder()
+{
+    // Stations listed in no spatial order (like zone-by-zone files) against
+    // the same stations sorted along the Hilbert curve
+    SyntheticMap map;
+    buildSyntheticMap(map, 100000, 0);
+    map.scene.trackCache = nullptr;
+    map.scene.indiaBoundary.clear();
+    map.scene.stateBoundaries.clear();
+
+    QVector<Station> shuffled = map.scene.stations;
+    QRandomGenerator rng(3);
+    for (int i = shuffled.size() - 1; i > 0; --i) {
+        std::swap(shuffled[i], shuffled[rng.bounded(i + 1)]);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<QPointF> points;
+    for (const auto &station : shuffled) points.append(QPointF(station.lon, station.lat));
+    QVector<Station> sorted;
+    for (int index : SpatialOrder::hilbertOrder(points)) sorted.append(shuffled[index]);
+    out << QString("reorder %1 stations in %2 ms\n").arg(sorted.size()).arg(timer.nsecsElapsed() / 1e6, 0, 'f', 2);
+
+    const char *names[] = { "file order   ", "Hilbert order" };
+    const QVector<Station> *orders[] = { &shuffled, &sorted };
+
+    QVector<QPointF> queries(10000);
+    for (QPointF &query : queries) {
+        query = QPointF(MIN_LON + rng.generateDouble() * (MAX_LON - MIN_LON),
+                        MIN_LAT + rng.generateDouble() * (MAX_LAT - MIN_LAT));
+    }
+    for (int o = 0; o < 2; ++o) {
+        ReverseGeocoder geocoder;
+        geocoder.setStations(*orders[o]);
+        double nearestMs = timeMs([&]() {
+            for (const QPointF &query : queries) geocoder.nearestStations(query.y(), query.x(), 10);
+        });
+        out << QString("  %1  nearest 10 stations %2 us/query\n")
+               .arg(names[o]).arg(nearestMs * 1000 / queries.size(), 7, 'f', 2);
+    }
+
+    MapRenderer renderer;
+    const double scales[] = { 5.0, 40.0 };
+    for (double scale : scales) {
+        map.scene.view.scale = scale;
+        ViewTransform view = map.scene.view.transform();
+        QRectF viewport(QPointF(0, 0), QSizeF(map.scene.view.size));
+        for (int o = 0; o < 2; ++o) {
+            map.scene.stations = *orders[o];
+
+            // Project and cull, as the station layer and hit-testing do
+            int visible = 0;
+            double cullMs = timeMs([&]() {
+                visible = 0;
+                for (const auto &station : map.scene.stations) {
+                    visible += viewport.contains(view.map(map.scene.view.projection.forward(station.lon, station.lat)));
+                }
+            });
+            double renderMs = timeMs([&]() { renderer.renderStaticLayers(map.scene); });
+            out << QString("  scale %1  %2  cull %3 ms  render %4 ms  (%5 visible)\n")
+                   .arg(scale, 5).arg(names[o]).arg(cullMs, 7, 'f', 3).arg(renderMs, 7, 'f', 2).arg(visible);
+            out.flush();
+        }
+    }
+}
+
+void benchRasterBase()
+{
+    SyntheticMap map;
+    buildSyntheticMap(map, 20000, 100000);
+    MapRenderer renderer;
+    QTemporaryDir directory;
+    QString path = directory.filePath("tiles.archive");
+
+    const double scales[] = { 5.0, 40.0 };
+    for (double scale : scales) {
+        map.scene.view.scale = scale;
+        map.scene.rasterTiles = nullptr;
+        double vectorMs = timeMs([&]() { renderer.renderStaticLayers(map.scene); });
+
+        // Pre-render the tiles under the view at the level the widget would use
+        const int tileSize = 256;
+        int level = int(std::ceil(std::log2(map.scene.view.pixelsPerUnit() * 360.0 / tileSize)));
+        ViewTransform view = map.scene.view.transform();
+        QRect range = RasterTileArchive::tileRange(view.unmapRect(QRectF(QPointF(0, 0), QSizeF(map.scene.view.size))), level);
+        QElapsedTimer timer;
+        timer.start();
+        {
+            RasterTileArchive::Writer writer(path, map.scene.view.projection.type(), tileSize);
+            MapRenderer tileRenderer(1);
+            MapScene tileScene = map.scene;
+            tileScene.view.size = QSize(tileSize, tileSize);
+            for (int y = range.top(); y <= range.bottom(); ++y) {
+                for (int x = range.left(); x <= range.right(); ++x) {
+                    QPointF center = tileScene.view.projection.inverse(RasterTileArchive::tileRect(level, x, y).center());
+                    tileScene.view.centerLon = center.x();
+                    tileScene.view.centerLat = center.y();
+                    writer.addTile(level, x, y, tileRenderer.renderStaticLayers(tileScene));
+                }
+            }
+            writer.finish();
+        }
+        double buildMs = timer.nsecsElapsed() / 1e6;
+
+        RasterTileArchive archive;
+        archive.open(path);
+        map.scene.rasterTiles = &archive;
+        timer.restart();
+        renderer.renderStaticLayers(map.scene);
+        double coldMs = timer.nsecsElapsed() / 1e6;
+        double warmMs = timeMs([&]() { renderer.renderStaticLayers(map.scene); });
+        out << QString("  scale %1  vector %2 ms  raster cold %3 ms  warm %4 ms  (%5 tiles, level %6, built in %7 ms)\n")
+               .arg(scale, 5).arg(vectorMs, 7, 'f', 2).arg(coldMs, 7, 'f', 2).arg(warmMs, 7, 'f', 2)
+               .arg(range.width() * range.height()).arg(level).arg(buildMs, 0, 'f', 0);
+        out.flush();
+        map.scene.rasterTiles = nullptr;
+    }
+}
+
+// Allocations made while fn runs once
+qint64 countAllocations(const std::function<void()> &fn)
+{
+    qint64 before = allocationCount.load();
+    fn();
+    return allocationCount.load() - before;
+}
+
+void benchFrameAllocations()
+{
+#ifndef ALLOCATION_COUNTING
+    out << "  allocation counting needs glibc\n";
+    return;
+#endif
+    SyntheticMap map;
+    buildSyntheticMap(map, 20000, 100000);
+
+    // Drawing alone uses a painter and target that persist, as a band's
+    // would if the paint engine were kept between frames; the full frames
+    // add the frame buffer, band painters and pool dispatch
+    QImage target(map.scene.view.size, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&target);
+    painter.setRenderHint(QPainter::Antialiasing);
+    FrameArena arena;
+    auto drawFrame = [&]() {
+        arena.reset();
+        MapRenderer::drawStaticLayers(painter, map.scene, target.rect(), arena);
+    };
+    MapRenderer singleThreaded(1), multiThreaded;
+
+    // Above 1.5 the station labels are drawn, and text layout allocates inside Qt
+    const double scales[] = { 0.35, 1.2, 5.0 };
+    for (double scale : scales) {
+        map.scene.view.scale = scale;
+
+        // Warm up: arena growth, track cells, glyph caches
+        for (int i = 0; i < 3; ++i) {
+            drawFrame();
+            singleThreaded.renderStaticLayers(map.scene);
+            multiThreaded.renderStaticLayers(map.scene);
+        }
+
+        qint64 drawAllocations = countAllocations(drawFrame);
+        qint64 singleAllocations = countAllocations([&]() { singleThreaded.renderStaticLayers(map.scene); });
+        qint64 multiAllocations = countAllocations([&]() { multiThreaded.renderStaticLayers(map.scene); });
+        out << QString("  scale %1  draw %2  frame (1 thread) %3  frame (%4 threads) %5 allocations  (arena peak %6 KB)\n")
+               .arg(scale, 5).arg(drawAllocations, 5).arg(singleAllocations, 5)
+               .arg(multiThreaded.threadCount()).arg(multiAllocations, 5).arg(arena.peakBytes() / 1024);
+        out.flush();
+    }
+}
+
+void benchMemory()
+{
+    SyntheticMap map;
+    buildSyntheticMap(map, 20000, 100000);
+
+    QTemporaryDir directory;
+    QVector<QPolygonF> boundary = { syntheticBoundary() };
+    if (!GeometryTileStore::build(directory.filePath("geometry.store"), map.scene.stateBoundaries, boundary, QString())) return;
+    GeometryTileStore store;
+    store.open(directory.filePath("geometry.store"));
+    MapScene streamed = map.scene;
+    streamed.tileStore = &store;
+
+    // Caches fill as the view zooms in; the datasets stay put
+    MapRenderer renderer(1);
+    const double scales[] = { 0.35, 5.0, 40.0 };
+    for (double scale : scales) {
+        streamed.view.scale = scale;
+        QImage frame = renderer.renderStaticLayers(streamed);
+        renderer.renderStaticLayers(streamed); // Steady state
+        qint64 heapAllocations = countAllocations([&]() { renderer.renderStaticLayers(streamed); });
+        MapRenderer::FrameStats stats = renderer.frameStats();
+
+        MemoryReport report;
+        report.add("stations", MemoryReport::bytesOf(map.scene.stations), map.scene.stations.size());
+        report.add("station labels", MemoryReport::labelBytesOf(map.scene.stations), map.scene.stations.size());
+        report.add("boundary", MemoryReport::bytesOf(map.scene.indiaBoundary), map.scene.indiaBoundary.size());
+        report.add("state features", MemoryReport::bytesOf(map.scene.stateBoundaries), map.scene.stateBoundaries.size());
+        report.add("track cache", map.trackCache.cachedBytes());
+        report.add("tile cache", qint64(store.cachedKilobytes()) * 1024);
+        report.add("frame", frame.sizeInBytes());
+        report.add("frame arenas", stats.arenaCapacity);
+
+        out << "scale " << scale << "\n";
+        for (const QString &line : report.lines()) {
+            out << "  " << line << "\n";
+        }
+        out << QString("  per frame: %1 KB scratch, %2 arena allocations, %3 arena blocks from the heap")
+               .arg(stats.arenaBytes / 1024).arg(stats.arenaAllocations).arg(stats.heapAllocations);
+#ifdef ALLOCATION_COUNTING
+        out << QString(", %1 heap allocations in all").arg(heapAllocations);
+#endif
+        out << "\n";
+        out.flush();
+    }
+}
+
+void benchRiverLines()
+{
+    // A scene holding only the river
+    SyntheticMap map;
+    buildSyntheticMap(map, 0, 200000);
+    map.scene.trackCache = nullptr;
+    map.scene.indiaBoundary.clear();
+    map.scene.stateBoundaries.erase(map.scene.stateBoundaries.begin(), map.scene.stateBoundaries.end() - 1);
+    const LocalPolygon &river = map.scene.stateBoundaries.first().localLine;
+    out << QString("river %1 vertices in %2 chunks\n").arg(river.points.size()).arg(river.strokes.chunks.size());
+
+    QImage target(map.scene.view.size, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&target);
+    painter.setRenderHint(QPainter::Antialiasing);
+    QPen pen(QColor(100, 180, 255), 2);
+    FrameArena arena, buffers; // The layer's, reset every frame, and the inline loops'
+    ArenaVector<QPointF> screen = buffers.vector<QPointF>(), clipped = buffers.vector<QPointF>();
+    ArenaVector<int> runEnds = buffers.vector<int>();
+    QRectF guard = QRectF(target.rect()).adjusted(-256, -256, 256, 256);
+
+    const double scales[] = { 0.35, 5.0, 40.0, 400.0 };
+    for (double scale : scales) {
+        map.scene.view.scale = scale;
+        // Look at a bend of the river
+        map.scene.view.centerLat = MIN_LAT + 10 + 3;
+        ViewTransform view = map.scene.view.transform();
+
+        // Every segment its own call, as the layer once drew lines
+        double segmentMs = timeMs([&]() {
+            painter.setPen(pen);
+            view.mapLocal(river, screen);
+            for (size_t i = 1; i < screen.size(); ++i) {
+                if (guard.contains(screen[i - 1]) || guard.contains(screen[i])) {
+                    painter.drawLine(screen[i - 1], screen[i]);
+                }
+            }
+        });
+        // The line mapped every frame and drawn as clipped polylines
+        double polylineMs = timeMs([&]() {
+            painter.setPen(pen);
+            view.mapLocal(river, screen);
+            clipPolylineToRect(screen.data(), int(screen.size()), guard, clipped, runEnds);
+            int start = 0;
+            for (int end : runEnds) {
+                painter.drawPolyline(clipped.data() + start, end - start);
+                start = end;
+            }
+        });
+        // The layer as it draws now, from the cached paths
+        double pathMs = timeMs([&]() {
+            MapRenderer::drawStaticLayers(painter, map.scene, target.rect(), arena);
+            arena.reset();
+        });
+        out << QString("  scale %1  drawLine %2 ms  drawPolyline %3 ms  cached path %4 ms\n")
+               .arg(scale, 5).arg(segmentMs, 7, 'f', 2).arg(polylineMs, 7, 'f', 2).arg(pathMs, 7, 'f', 2);
+        out.flush();
+    }
+}
+
+void benchStationBatching()
+{
+    // A scene holding only the stations
+    SyntheticMap map;
+    buildSyntheticMap(map, 100000, 0);
+    map.scene.trackCache = nullptr;
+    map.scene.indiaBoundary.clear();
+    map.scene.stateBoundaries.clear();
+
+    QImage target(map.scene.view.size, QImage::Format_ARGB32_Premultiplied);
+    QPainter painter(&target);
+    painter.setRenderHint(QPainter::Antialiasing);
+    QFont labelFont;
+    labelFont.setPointSize(9);
+    labelFont.setBold(true);
+    QFontMetrics fm(labelFont);
+    const QBrush shadowBrush(QColor(0, 0, 0, 50)), markerBrush(QColor(255, 152, 0)), dotBrush(Qt::white);
+    const QBrush labelBrush(QColor(255, 255, 255, 200));
+    const QPen markerPen(QColor(255, 87, 34), 2), labelBorderPen(QColor(100, 100, 100), 1), labelTextPen(QColor(33, 33, 33));
+    FrameArena arena;
+
+    // Above 1.5 the labels are drawn too
+    const double scales[] = { 0.35, 1.2, 5.0 };
+    for (double scale : scales) {
+        map.scene.view.scale = scale;
+        bool showLabels = scale > 1.5;
+        ViewTransform view = map.scene.view.transform();
+        QRectF cullRect = QRectF(target.rect()).adjusted(showLabels ? -400 : -10, -20, 10, 20);
+
+        // Every part of every station with its own pen and brush, as the layer once drew
+        int visible = 0;
+        double immediateMs = timeMs([&]() {
+            visible = 0;
+            painter.setFont(labelFont);
+            for (const auto &station : map.scene.stations) {
+                QPointF screenPos = view.map(map.scene.view.projection.forward(station.lon, station.lat));
+                if (!cullRect.contains(screenPos)) continue;
+                ++visible;
+                painter.setBrush(shadowBrush);
+                painter.setPen(Qt::NoPen);
+                painter.drawEllipse(screenPos + QPointF(1, 1), 8, 8);
+                painter.setPen(markerPen);
+                painter.setBrush(markerBrush);
+                painter.drawEllipse(screenPos, 8, 8);
+                painter.setPen(Qt::NoPen);
+                painter.setBrush(dotBrush);
+                painter.drawEllipse(screenPos, 3, 3);
+                if (showLabels) {
+                    QRect textRect = fm.boundingRect(station.name);
+                    QPointF textPos = screenPos + QPointF(12, -8);
+                    painter.setBrush(labelBrush);
+                    painter.setPen(labelBorderPen);
+                    painter.drawRoundedRect(textRect.translated(textPos.toPoint()).adjusted(-2, -1, 2, 1), 3, 3);
+                    painter.setPen(labelTextPen);
+                    painter.drawText(textPos, station.name);
+                }
+            }
+        });
+        // The layer as it draws now, through a draw list
+        double batchedMs = timeMs([&]() {
+            MapRenderer::drawStaticLayers(painter, map.scene, target.rect(), arena);
+            arena.reset();
+        });
+        int immediateChanges = visible * (showLabels ? 9 : 6);
+        int batchedChanges = 2 * (showLabels ? 5 : 3);
+        out << QString("  scale %1  per station %2 ms (%3 pen/brush changes)  draw list %4 ms (%5)  (%6 stations)\n")
+               .arg(scale, 5).arg(immediateMs, 7, 'f', 2).arg(immediateChanges, 7)
+               .arg(batchedMs, 7, 'f', 2).arg(batchedChanges, 2).arg(visible);
+        out.flush();
+    }
+}
+
+// Minimal Mapbox Vector Tile encoder for the synthetic data
+void putVarint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(char(value | 0x80));
+        value >>= 7;
+    }
+    out.append(char(value));
+}
+
+void putKey(QByteArray &out, int field, int wire)
+{
+    putVarint(out, quint64(field << 3 | wire));
+}
+
+void putMessage(QByteArray &out, int field, const QByteArray &message)
+{
+    putKey(out, field, 2);
+    putVarint(out, quint64(message.size()));
+    out += message;
+}
+
+void putPacked(QByteArray &out, int field, const QVector<quint32> &values)
+{
+    QByteArray packed;
+    for (quint32 value : values) putVarint(packed, value);
+    putMessage(out, field, packed);
+}
+
+// Web Mercator tile coordinates of a lon/lat point at level z
+QPointF geoToTiles(const QPointF &geo, int z)
+{
+    double tiles = std::ldexp(1.0, z);
+    double lat = qDegreesToRadians(geo.y());
+    return QPointF((geo.x() + 180.0) / 360.0 * tiles,
+                   (1 - std::log(std::tan(lat) + 1 / std::cos(lat)) / M_PI) / 2 * tiles);
+}
+
+// One feature in tile (z, tile), with the key indices 0 = name, 1 = type
+// and its values at value, value + 1
+QByteArray encodeFeature(const StateFeature &feature, quint64 id, const QPoint &tile, int z, int extent, quint32 value)
+{
+    bool polygon = !feature.polygons.isEmpty();
+    QVector<QPolygonF> parts = polygon ? feature.polygons : QVector<QPolygonF>{ QPolygonF(feature.lineString) };
+    QVector<quint32> geometry;
+    QPoint cursor;
+    for (const QPolygonF &part : parts) {
+        QVector<QPoint> grid;
+        for (const QPointF &point : part) {
+            QPointF tiles = geoToTiles(point, z);
+            QPoint cell(qRound((tiles.x() - tile.x()) * extent), qRound((tiles.y() - tile.y()) * extent));
+            if (grid.isEmpty() || grid.last() != cell) grid.append(cell);
+        }
+        if (polygon) {
+            // Exterior rings are clockwise on screen; the closing point is implied
+            if (grid.size() > 1 && grid.first() == grid.last()) grid.removeLast();
+            double area = 0;
+            for (int i = 0, j = grid.size() - 1; i < grid.size(); j = i++) {
+                area += double(grid[j].x()) * grid[i].y() - double(grid[i].x()) * grid[j].y();
+            }
+            if (area < 0) std::reverse(grid.begin(), grid.end());
+        }
+        if (grid.size() < (polygon ? 3 : 2)) continue;
+
+        auto zigzag = [](int delta) { return (quint32(delta) << 1) ^ quint32(delta >> 31); };
+        geometry << (1 | 1 << 3) << zigzag(grid[0].x() - cursor.x()) << zigzag(grid[0].y() - cursor.y());
+        geometry << quint32(2 | (grid.size() - 1) << 3);
+        for (int i = 1; i < grid.size(); ++i) {
+            geometry << zigzag(grid[i].x() - grid[i - 1].x()) << zigzag(grid[i].y() - grid[i - 1].y());
+        }
+        cursor = grid.last();
+        if (polygon) geometry << (7 | 1 << 3);
+    }
+
+    QByteArray encoded;
+    putKey(encoded, 1, 0);
+    putVarint(encoded, id);
+    putPacked(encoded, 2, { 0, value, 1, value + 1 });
+    putKey(encoded, 3, 0);
+    putVarint(encoded, polygon ? 3 : 2);
+    putPacked(encoded, 4, geometry);
+    return encoded;
+}
+
+// Polygons go whole into every tile their bounds touch, leaving the cut at
+// the tile edges to the decoder; lines go whole into the tile holding their
+// first point, so each comes back once
+QMap<QPair<int, int>, QByteArray> encodeVectorTiles(const QVector<StateFeature> &features, int z)
+{
+    const int extent = 4096;
+    struct TileLayer {
+        QByteArray features;
+        QStringList values;
+    };
+    QMap<QPair<int, int>, TileLayer> layers;
+
+    for (int f = 0; f < features.size(); ++f) {
+        const StateFeature &feature = features[f];
+        QRect range;
+        if (feature.polygons.isEmpty()) {
+            QPointF first = geoToTiles(feature.lineString.first(), z);
+            range = QRect(int(first.x()), int(first.y()), 1, 1);
+        }
+        for (const QPolygonF &polygon : feature.polygons) {
+            for (const QPointF &point : polygon) {
+                QPointF tiles = geoToTiles(point, z);
+                range |= QRect(int(tiles.x()), int(tiles.y()), 1, 1);
+            }
+        }
+
+        for (int y = range.top(); y <= range.bottom(); ++y) {
+            for (int x = range.left(); x <= range.right(); ++x) {
+                TileLayer &layer = layers[qMakePair(x, y)];
+                layer.values << feature.name << feature.type;
+                quint32 value = quint32(layer.values.size()) - 2;
+                putMessage(layer.features, 2, encodeFeature(feature, quint64(f + 1), QPoint(x, y), z, extent, value));
+            }
+        }
+    }
+
+    QMap<QPair<int, int>, QByteArray> tiles;
+    for (auto it = layers.constBegin(); it != layers.constEnd(); ++it) {
+        QByteArray layer;
+        putKey(layer, 15, 0);
+        putVarint(layer, 2);
+        putMessage(layer, 1, "features");
+        layer += it.value().features;
+        putMessage(layer, 3, "name");
+        putMessage(layer, 3, "type");
+        for (const QString &text : it.value().values) {
+            QByteArray value;
+            putMessage(value, 1, text.toUtf8());
+            putMessage(layer, 4, value);
+        }
+        putKey(layer, 5, 0);
+        putVarint(layer, extent);
+        putMessage(tiles[it.key()], 3, layer);
+    }
+    return tiles;
+}
+
+void benchVectorTiles()
+{
+    // The loaders log every feature
+    QLoggingCategory::setFilterRules("default.debug=false");
+
+    SyntheticMap map;
+    buildSyntheticMap(map, 0, 100000);
+    const QVector<StateFeature> &features = map.scene.stateBoundaries;
+    qint64 points = 0;
+    for (const auto &feature : features) {
+        for (const auto &polygon : feature.polygons) points += polygon.size();
+        points += feature.lineString.size();
+    }
+
+    // The same features as a GeoJSON file and as a level 6 tile set
+    QTemporaryDir directory;
+    QJsonArray geoJsonFeatures;
+    for (const auto &feature : features) {
+        auto ring = [](const QVector<QPointF> &line) {
+            QJsonArray coordinates;
+            for (const QPointF &point : line) coordinates.append(QJsonArray{ point.x(), point.y() });
+            return coordinates;
+        };
+        QJsonObject geometry;
+        if (feature.polygons.isEmpty()) {
+            geometry["type"] = "LineString";
+            geometry["coordinates"] = ring(feature.lineString);
+        } else {
+            geometry["type"] = "Polygon";
+            geometry["coordinates"] = QJsonArray{ ring(feature.polygons.first()) };
+        }
+        geoJsonFeatures.append(QJsonObject{
+            { "type", "Feature" },
+            { "properties", QJsonObject{ { "name", feature.name }, { "type", feature.type } } },
+            { "geometry", geometry } });
+    }
+    QString geoJsonPath = directory.filePath("states.geojson");
+    QFile geoJson(geoJsonPath);
+    geoJson.open(QIODevice::WriteOnly);
+    geoJson.write(QJsonDocument(QJsonObject{ { "type", "FeatureCollection" }, { "features", geoJsonFeatures } }).toJson(QJsonDocument::Compact));
+    geoJson.close();
+
+    const int level = 6;
+    QString tilePath = directory.filePath("tiles");
+    qint64 tileBytes = 0;
+    QMap<QPair<int, int>, QByteArray> tiles = encodeVectorTiles(features, level);
+    for (auto it = tiles.constBegin(); it != tiles.constEnd(); ++it) {
+        QString path = QString("%1/%2/%3/%4.mvt").arg(tilePath).arg(level).arg(it.key().first).arg(it.key().second);
+        QDir().mkpath(QFileInfo(path).path());
+        QFile file(path);
+        file.open(QIODevice::WriteOnly);
+        file.write(it.value());
+        tileBytes += it.value().size();
+    }
+    QString archivePath = directory.filePath("tiles.archive");
+    VectorTileSource::pack(tilePath, archivePath);
+    out << QString("%1 features, %2 points: GeoJSON %3 KB, %4 tiles %5 KB\n")
+           .arg(features.size()).arg(points).arg(QFileInfo(geoJsonPath).size() / 1024)
+           .arg(tiles.size()).arg(tileBytes / 1024);
+
+    // Cold loads: a fresh source every time, so nothing is cached
+    int decoded = 0;
+    double geoJsonMs = timeMs([&]() { decoded = GeoJsonLoader::loadStateBoundaries(geoJsonPath).size(); }, 3);
+    out << QString("  GeoJSON parse        %1 ms  (%2 features)\n").arg(geoJsonMs, 8, 'f', 2).arg(decoded);
+    const QString sources[] = { tilePath, archivePath };
+    const char *names[] = { "tile directory", "tile archive" };
+    for (int i = 0; i < 2; ++i) {
+        double tileMs = timeMs([&]() {
+            VectorTileSource source;
+            source.open(sources[i]);
+            decoded = source.features(level).size();
+        }, 3);
+        out << QString("  %1 decode %2 ms  (%3 features and outlines, %4 threads)\n")
+               .arg(names[i], -14).arg(tileMs, 8, 'f', 2).arg(decoded).arg(QThread::idealThreadCount());
+        out.flush();
+    }
+    QLoggingCategory::setFilterRules(QString());
+}
+
+void benchDevicePixelRatio()
+{
+    SyntheticMap map;
+    buildSyntheticMap(map, 5000, 20000);
+    MapRenderer renderer(QThread::idealThreadCount());
+
+    // The same view for screens of each pixel ratio
+    const double ratios[] = { 1.0, 1.5, 2.0 };
+    for (double ratio : ratios) {
+        map.scene.view.devicePixelRatio = ratio;
+        QImage frame;
+        double ms = timeMs([&]() { frame = renderer.renderStaticLayers(map.scene); });
+        out << QString("  ratio %1  %2 ms  %3x%4 pixels  %5 MB\n")
+               .arg(ratio, 3, 'f', 1).arg(ms, 8, 'f', 2).arg(frame.width()).arg(frame.height())
+               .arg(frame.sizeInBytes() / (1024.0 * 1024.0), 6, 'f', 1);
+        out.flush();
+    }
+
+    // The window moved back and forth between a 1x and a 2x screen, at two
+    // zooms: one frame kept (re-rendered on every move) vs. the frame cache
+    // The zoom steps by the widget's ×1.5 and ÷1.5, so coming back lands on
+    // a scale that differs from the first in the last bits
+    const int moves = 12;
+    QVector<MapView> visits;
+    double scale = 0.35;
+    for (int i = 0; i < moves; ++i) {
+        if (i > 0 && i % 2 == 0) scale = i % 4 ? scale * 1.5 : scale / 1.5;
+        MapView view = map.scene.view;
+        view.devicePixelRatio = i % 2 ? 2.0 : 1.0;
+        view.scale = scale;
+        visits.append(view);
+    }
+    MapScene scene = map.scene;
+    QElapsedTimer timer;
+    timer.start();
+    for (const MapView &view : visits) {
+        scene.view = view;
+        renderer.renderStaticLayers(scene);
+    }
+    double singleMs = timer.nsecsElapsed() / 1e6;
+
+    FrameCache cache(256 * 1024);
+    FrameCache::Frame current;
+    int renders = 0;
+    timer.restart();
+    for (const MapView &view : visits) {
+        FrameCache::Frame cached;
+        if (!cache.take(view, cached)) {
+            scene.view = view;
+            cached = FrameCache::Frame{ renderer.renderStaticLayers(scene), view };
+            ++renders;
+        }
+        if (!current.image.isNull()) cache.insert(current);
+        current = cached;
+    }
+    double cachedMs = timer.nsecsElapsed() / 1e6;
+    out << QString("  %1 screen moves: one frame %2 ms (%1 renders)  frame cache %3 ms (%4 renders, %5 MB kept)\n")
+           .arg(moves).arg(singleMs, 8, 'f', 2).arg(cachedMs, 8, 'f', 2).arg(renders)
+           .arg(cache.kilobytes() / 1024.0, 0, 'f', 1);
+}
+
+const QVector<BenchCase> &benchCases()
+{
+    static const QVector<BenchCase> cases = {
+        { "animation-frame", "Zoom animation step: re-rendering vs. scaling the cached layers", benchAnimationFrame },
+        { "device-pixel-ratio", "Frames rendered per screen pixel ratio, and screen moves with the frame cache", benchDevicePixelRatio },
+        { "frame-allocations", "Heap allocations per steady-state frame (drawing alone and whole frames)", benchFrameAllocations },
+        { "memory", "Bytes per subsystem (datasets, caches, frame) and per-frame scratch use", benchMemory },
+        { "polygon-fill", "Filled boundary: whole-outline drawPolygon vs. visible mesh triangles", benchPolygonFill },
+        { "raster-base", "Static layers drawn as vectors vs. from a pre-rendered tile archive", benchRasterBase },
+        { "render-threads", "Static layer rasterization across worker thread counts", benchRenderThreads },
+        { "reverse-geocode", "Point-in-state and nearest-station query time", benchReverseGeocode },
+        { "river-lines", "Long river stroked per segment, as mapped polylines and from cached paths", benchRiverLines },
+        { "station-batching", "Station layer drawn part by part per station vs. batched by style", benchStationBatching },
+        { "station-order", "Station culling, rendering and lookups in file order vs. Hilbert order", benchStationOrder },
+        { "station-search", "Station search index build and per-keystroke query time", benchStationSearch },
+        { "tile-stream", "Boundary and states from in-memory features vs. streamed store tiles", benchTileStream },
+        { "vector-tiles", "Loading features from GeoJSON vs. decoding a vector tile set", benchVectorTiles },
+    };
+    return cases;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // No window system needed
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+
+    QStringList selected = app.arguments().mid(1);
+    if (selected.contains("--list")) {
+        for (const auto &benchCase : benchCases()) {
+            out << benchCase.name << "\t" << benchCase.description << "\n";
+        }
+        return 0;
+    }
+
+    for (const auto &benchCase : benchCases()) {
+        if (!selected.isEmpty() && !selected.contains(benchCase.name)) continue;
+        out << "== " << benchCase.name << " ==\n";
+        out.flush();
+        benchCase.run();
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "coordinatecodec.h"
+#include <QVarLengthArray>
+#include <cmath>
+
+const double CoordinateCodec::DEGREES_PER_UNIT = 1e-7; // ~1.1 cm at the equator
+const int CoordinateCodec::BLOCK_SIZE = 256;           // Points decoded per batch
+
+namespace {
+
+quint32 zigzag(qint32 value)
+{
+    return (quint32(value) << 1) ^ quint32(value >> 31);
+}
+
+qint32 unzigzag(quint32 value)
+{
+    return qint32(value >> 1) ^ -qint32(value & 1);
+}
+
+} // namespace
+
+qint32 CoordinateCodec::quantize(double degrees)
+{
+    // +-180 degrees is 1.8e9 units, inside the int32 range
+    return qint32(std::lround(qBound(-180.0, degrees, 180.0) / DEGREES_PER_UNIT));
+}
+
+CoordinateCodec::Writer::Writer()
+    : lastX(0)
+    , lastY(0)
+{
+}
+
+void CoordinateCodec::Writer::writeVarint(quint32 value)
+{
+    // Seven bits per byte, low bits first, high bit set on all but the last
+    while (value >= 0x80) {
+        bytes.append(char((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    bytes.append(char(value));
+}
+
+void CoordinateCodec::Writer::writeCount(quint32 value)
+{
+    writeVarint(value);
+}
+
+void CoordinateCodec::Writer::writeInt(qint32 value)
+{
+    writeVarint(zigzag(value));
+}
+
+void CoordinateCodec::Writer::writePoints(const QPolygonF &points)
+{
+    writeVarint(quint32(points.size()));
+    for (const QPointF &point : points) {
+        qint32 x = quantize(point.x()), y = quantize(point.y());
+        // Differences of two in-range values fit in int32 after wrapping
+        writeVarint(zigzag(qint32(quint32(x) - quint32(lastX))));
+        writeVarint(zigzag(qint32(quint32(y) - quint32(lastY))));
+        lastX = x;
+        lastY = y;
+    }
+}
+
+CoordinateCodec::Reader::Reader(const QByteArray &data)
+    : position(reinterpret_cast<const uchar *>(data.constData()))
+    , end(position + data.size())
+    , lastX(0)
+    , lastY(0)
+    , ok(true)
+{
+}
+
+bool CoordinateCodec::Reader::readVarint(quint32 &value)
+{
+    value = 0;
+    for (int shift = 0; ok && shift < 35; shift += 7) {
+        if (position == end) break;
+        uchar byte = *position++;
+        value |= quint32(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    ok = false;
+    return false;
+}
+
+bool CoordinateCodec::Reader::readCount(quint32 &value)
+{
+    return readVarint(value);
+}
+
+bool CoordinateCodec::Reader::readInt(qint32 &value)
+{
+    quint32 raw;
+    if (!readVarint(raw)) return false;
+    value = unzigzag(raw);
+    return true;
+}
+
+bool CoordinateCodec::Reader::readPoints(QPolygonF &points)
+{
+    quint32 count;
+    // Every point takes at least two bytes, which bounds the allocation
+    if (!readVarint(count) || count > quint32(end - position) / 2) {
+        ok = false;
+        return false;
+    }
+    points.resize(int(count));
+
+    // Varints are unpacked a block at a time, then the running sums are
+    // converted in a plain loop over int arrays the compiler can vectorize
+    QVarLengthArray<qint32, 256> xs(BLOCK_SIZE), ys(BLOCK_SIZE);
+    QPointF *out = points.data();
+    for (int first = 0; first < int(count); first += BLOCK_SIZE) {
+        int n = qMin(BLOCK_SIZE, int(count) - first);
+        for (int i = 0; i < n; ++i) {
+            quint32 dx, dy;
+            if (!readVarint(dx) || !readVarint(dy)) {
+                points.clear();
+                return false;
+            }
+            lastX = qint32(quint32(lastX) + quint32(unzigzag(dx)));
+            lastY = qint32(quint32(lastY) + quint32(unzigzag(dy)));
+            xs[i] = lastX;
+            ys[i] = lastY;
+        }
+        for (int i = 0; i < n; ++i) {
+            out[first + i] = QPointF(xs[i] * DEGREES_PER_UNIT, ys[i] * DEGREES_PER_UNIT);
+        }
+    }
+    return true;
+}
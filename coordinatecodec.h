@@ -0,0 +1,66 @@
+#ifndef COORDINATECODEC_H
+#define COORDINATECODEC_H
+
+#include <QByteArray>
+#include <QPolygonF>
+
+// Compact encoding of lon/lat geometry for the on-disk stores.
+//
+// Coordinates are quantized to int32 fixed point at 1e-7 degrees (about
+// 1 cm), then written as zigzag varints of the difference to the previous
+// point. Neighbouring vertices of detailed outlines differ by a few hundred
+// units, so most coordinates take 2-3 bytes instead of 8. The delta chain
+// runs across all point lists of one Writer, so short rings do not restart
+// from absolute values.
+class CoordinateCodec
+{
+public:
+    class Writer
+    {
+    public:
+        Writer();
+
+        void writeCount(quint32 value);
+        void writeInt(qint32 value);
+        void writePoints(const QPolygonF &points);
+
+        QByteArray data() const { return bytes; }
+
+    private:
+        void writeVarint(quint32 value);
+
+        QByteArray bytes;
+        qint32 lastX, lastY;
+    };
+
+    class Reader
+    {
+    public:
+        explicit Reader(const QByteArray &data);
+
+        // Each returns false (and keeps failing) once the data is exhausted
+        // or malformed
+        bool readCount(quint32 &value);
+        bool readInt(qint32 &value);
+        bool readPoints(QPolygonF &points);
+
+        bool isOk() const { return ok; }
+        bool atEnd() const { return position == end; }
+
+    private:
+        bool readVarint(quint32 &value);
+
+        const uchar *position;
+        const uchar *end;
+        qint32 lastX, lastY;
+        bool ok;
+    };
+
+    static qint32 quantize(double degrees);
+    static double dequantize(qint32 units) { return units * DEGREES_PER_UNIT; }
+
+    static const double DEGREES_PER_UNIT;
+    static const int BLOCK_SIZE;
+};
+
+#endif // COORDINATECODEC_H
@@ -0,0 +1,67 @@
+#include "drawlist.h"
+
+DrawList::DrawList(FrameArena &arena)
+    : arena(arena)
+    , styles(arena.vector<Style>())
+    , items(arena.vector<Item>())
+{
+}
+
+int DrawList::addStyle(const QPen &pen, const QBrush &brush)
+{
+    styles.push_back(Style{ pen, brush });
+    return int(styles.size()) - 1;
+}
+
+void DrawList::addEllipse(int style, const QPointF &center, qreal rx, qreal ry)
+{
+    items.push_back(Item{ style, Ellipse, QRectF(center.x() - rx, center.y() - ry, 2 * rx, 2 * ry), 0, nullptr });
+}
+
+void DrawList::addRoundedRect(int style, const QRectF &rect, qreal radius)
+{
+    items.push_back(Item{ style, RoundedRect, rect, radius, nullptr });
+}
+
+void DrawList::addText(int style, const QPointF &position, const QString &text)
+{
+    items.push_back(Item{ style, Text, QRectF(position, QSizeF()), 0, &text });
+}
+
+int DrawList::flush(QPainter &painter)
+{
+    // Stable counting sort by style
+    int styleCount = int(styles.size());
+    ArenaVector<int> starts = arena.vector<int>();
+    starts.assign(styleCount + 1, 0);
+    for (const Item &item : items) ++starts[item.style + 1];
+    for (int style = 0; style < styleCount; ++style) starts[style + 1] += starts[style];
+
+    ArenaVector<const Item *> sorted = arena.vector<const Item *>();
+    sorted.resize(items.size());
+    for (const Item &item : items) sorted[starts[item.style]++] = &item;
+
+    int current = -1;
+    int switches = 0;
+    for (const Item *item : sorted) {
+        if (item->style != current) {
+            current = item->style;
+            painter.setPen(styles[current].pen);
+            painter.setBrush(styles[current].brush);
+            ++switches;
+        }
+        switch (item->kind) {
+        case Ellipse:
+            painter.drawEllipse(item->rect);
+            break;
+        case RoundedRect:
+            painter.drawRoundedRect(item->rect, item->radius, item->radius);
+            break;
+        case Text:
+            painter.drawText(item->rect.topLeft(), *item->text);
+            break;
+        }
+    }
+    items.clear();
+    return switches;
+}
@@ -0,0 +1,58 @@
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#include <QPainter>
+#include <QPen>
+#include <QBrush>
+#include <QRectF>
+#include <QPointF>
+#include <QString>
+#include "framearena.h"
+
+// Primitives recorded for one frame and submitted grouped by style.
+//
+// Drawing element by element switches pen and brush for every part of every
+// element. Here the caller registers its styles first, bottom to top, then
+// records primitives in any order; flush() draws them style by style (and
+// in recording order within a style), so the painter state changes once per
+// style rather than once per primitive. Everything lives in the frame arena;
+// texts are referenced, not copied, and must outlive flush().
+class DrawList
+{
+public:
+    explicit DrawList(FrameArena &arena);
+
+    // Style id for the primitives drawn with pen and brush
+    int addStyle(const QPen &pen, const QBrush &brush = Qt::NoBrush);
+
+    void addEllipse(int style, const QPointF &center, qreal rx, qreal ry);
+    void addRoundedRect(int style, const QRectF &rect, qreal radius);
+    void addText(int style, const QPointF &position, const QString &text);
+
+    bool isEmpty() const { return items.empty(); }
+
+    // Draws and clears the list; returns the number of style switches made
+    int flush(QPainter &painter);
+
+private:
+    enum Kind { Ellipse, RoundedRect, Text };
+
+    struct Style {
+        QPen pen;
+        QBrush brush;
+    };
+
+    struct Item {
+        int style;
+        Kind kind;
+        QRectF rect;         // Ellipse bounds, or the rectangle; text position at topLeft
+        qreal radius;
+        const QString *text;
+    };
+
+    FrameArena &arena;
+    ArenaVector<Style> styles;
+    ArenaVector<Item> items;
+};
+
+#endif // DRAWLIST_H
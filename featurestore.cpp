@@ -0,0 +1,169 @@
+#include "featurestore.h"
+#include <QDataStream>
+#include <QDebug>
+#include <algorithm>
+
+const quint32 FeatureStore::MAGIC = 0x4d444653; // "MDFS"
+const quint32 FeatureStore::VERSION = 1;
+const int FeatureStore::HEADER_SIZE = 64;
+
+// Header: magic, version, page count, index offset, metadata offset and size,
+// zero-padded to HEADER_SIZE. All integers big-endian (QDataStream).
+
+FeatureStore::Writer::Writer(const QString &path)
+    : file(path)
+    , ok(false)
+{
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Could not create feature store" << path;
+        return;
+    }
+
+    // Placeholder header, rewritten by finish()
+    ok = file.write(QByteArray(HEADER_SIZE, '\0')) == HEADER_SIZE;
+}
+
+void FeatureStore::Writer::addPage(quint64 key, const QByteArray &data, quint32 flags)
+{
+    if (!ok) return;
+    Entry entry{ key, quint64(file.pos()), quint32(data.size()), flags };
+    if (file.write(data) != data.size()) {
+        qWarning() << "Could not write feature store page to" << file.fileName();
+        ok = false;
+        return;
+    }
+    entries.append(entry);
+}
+
+bool FeatureStore::Writer::finish(const QByteArray &metadata)
+{
+    if (!ok) return false;
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.key < b.key; });
+
+    QDataStream stream(&file);
+    quint64 indexOffset = quint64(file.pos());
+    for (const Entry &entry : entries) {
+        stream << entry.key << entry.offset << entry.size << entry.flags;
+    }
+    quint64 metadataOffset = quint64(file.pos());
+    stream.writeRawData(metadata.constData(), metadata.size());
+
+    file.seek(0);
+    stream << MAGIC << VERSION << quint32(entries.size()) << indexOffset << metadataOffset << quint32(metadata.size());
+
+    ok = stream.status() == QDataStream::Ok;
+    file.close();
+    return ok;
+}
+
+FeatureStore::FeatureStore()
+    : mapped(nullptr)
+    , fileSize(0)
+    , cache(16 * 1024) // Kilobytes
+{
+}
+
+bool FeatureStore::open(const QString &path, bool memoryMapped)
+{
+    close();
+
+    QMutexLocker locker(&mutex);
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream stream(&file);
+    quint32 magic = 0, version = 0, pages = 0, metadataSize = 0;
+    quint64 indexOffset = 0, metadataOffset = 0;
+    stream >> magic >> version >> pages >> indexOffset >> metadataOffset >> metadataSize;
+    if (stream.status() != QDataStream::Ok || magic != MAGIC || version != VERSION
+        || indexOffset + quint64(pages) * 24 > quint64(file.size())) {
+        qWarning() << "Unsupported feature store" << path;
+        file.close();
+        return false;
+    }
+
+    index.resize(pages);
+    file.seek(qint64(indexOffset));
+    for (IndexEntry &entry : index) {
+        stream >> entry.key >> entry.offset >> entry.size >> entry.flags;
+    }
+    file.seek(qint64(metadataOffset));
+    metadataBlob = file.read(metadataSize);
+
+    if (stream.status() != QDataStream::Ok || metadataBlob.size() != int(metadataSize)) {
+        qWarning() << "Corrupt feature store" << path;
+        index.clear();
+        metadataBlob.clear();
+        file.close();
+        return false;
+    }
+
+    fileSize = file.size();
+    if (memoryMapped) {
+        mapped = file.map(0, fileSize);
+        if (!mapped) qWarning() << "Could not map" << path << "- reading pages instead";
+    }
+    return true;
+}
+
+void FeatureStore::close()
+{
+    QMutexLocker locker(&mutex);
+    if (mapped) {
+        file.unmap(mapped);
+        mapped = nullptr;
+    }
+    file.close();
+    fileSize = 0;
+    index.clear();
+    metadataBlob.clear();
+    cache.clear();
+}
+
+const FeatureStore::IndexEntry *FeatureStore::entry(quint64 key) const
+{
+    auto it = std::lower_bound(index.begin(), index.end(), key,
+                               [](const IndexEntry &entry, quint64 key) { return entry.key < key; });
+    return it != index.end() && it->key == key ? &*it : nullptr;
+}
+
+bool FeatureStore::find(quint64 key, quint32 *flags) const
+{
+    const IndexEntry *found = entry(key);
+    if (found && flags) *flags = found->flags;
+    return found != nullptr;
+}
+
+QByteArray FeatureStore::page(quint64 key) const
+{
+    QMutexLocker locker(&mutex);
+    if (mapped) {
+        const IndexEntry *found = entry(key);
+        if (!found || found->offset + found->size > quint64(fileSize)) return QByteArray();
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(mapped + found->offset), int(found->size));
+    }
+    if (QByteArray *cached = cache.object(key)) return *cached;
+
+    const IndexEntry *found = entry(key);
+    if (!found || !file.seek(qint64(found->offset))) return QByteArray();
+    QByteArray data = file.read(found->size);
+    if (data.size() != int(found->size)) {
+        qWarning() << "Short read from feature store" << file.fileName();
+        return QByteArray();
+    }
+    cache.insert(key, new QByteArray(data), qMax(1, data.size() / 1024));
+    return data;
+}
+
+void FeatureStore::setCacheLimit(int kilobytes)
+{
+    QMutexLocker locker(&mutex);
+    cache.setMaxCost(kilobytes);
+}
+
+int FeatureStore::cachedKilobytes() const
+{
+    QMutexLocker locker(&mutex);
+    return cache.totalCost();
+}
@@ -0,0 +1,89 @@
+#ifndef FEATURESTORE_H
+#define FEATURESTORE_H
+
+#include <QVector>
+#include <QCache>
+#include <QByteArray>
+#include <QString>
+#include <QFile>
+#include <QMutex>
+
+// Single-file paged store of spatially keyed pages.
+//
+// The file holds a fixed header, the pages, a page index sorted by key and a
+// metadata blob. Writers emit pages in quadtree order with children visited
+// along a Hilbert curve, so every subtree is contiguous on disk and tiles
+// that are near on the map are near in the file. Pages are read through an
+// LRU cache with a byte budget, so a store of any size is served from a
+// bounded amount of memory; only the index (24 bytes a page) stays resident.
+// A store opened memory-mapped serves pages straight from the mapping
+// instead, leaving the caching to the operating system.
+class FeatureStore
+{
+public:
+    // Appends pages, then writes the index and metadata on finish()
+    class Writer
+    {
+    public:
+        explicit Writer(const QString &path);
+
+        bool isOk() const { return ok; }
+        void addPage(quint64 key, const QByteArray &data, quint32 flags = 0);
+        bool finish(const QByteArray &metadata);
+
+    private:
+        struct Entry {
+            quint64 key;
+            quint64 offset;
+            quint32 size;
+            quint32 flags;
+        };
+
+        QFile file;
+        QVector<Entry> entries;
+        bool ok;
+    };
+
+    FeatureStore();
+
+    bool open(const QString &path, bool memoryMapped = false);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+
+    QByteArray metadata() const { return metadataBlob; }
+    int pageCount() const { return index.size(); }
+
+    // Flags stored with a page; false if there is no such page
+    bool find(quint64 key, quint32 *flags = nullptr) const;
+
+    // Page contents through the cache, or empty. Thread-safe. When mapped,
+    // the array points into the mapping and is only valid until close().
+    QByteArray page(quint64 key) const;
+
+    void setCacheLimit(int kilobytes);
+    int cachedKilobytes() const;
+
+private:
+    struct IndexEntry {
+        quint64 key;
+        quint64 offset;
+        quint32 size;
+        quint32 flags;
+    };
+
+    const IndexEntry *entry(quint64 key) const;
+
+    mutable QFile file;
+    uchar *mapped; // Whole file, or null when pages are read
+    qint64 fileSize;
+    QVector<IndexEntry> index; // Sorted by key
+    QByteArray metadataBlob;
+    mutable QCache<quint64, QByteArray> cache; // Cost in kilobytes
+    mutable QMutex mutex;
+
+    static const quint32 MAGIC;
+    static const quint32 VERSION;
+    static const int HEADER_SIZE;
+};
+
+#endif // FEATURESTORE_H
@@ -0,0 +1,91 @@
+#include "framearena.h"
+#include <QtGlobal>
+#include <cstdint>
+
+const size_t FrameArena::DEFAULT_BLOCK_SIZE = 256 * 1024;
+
+FrameArena::FrameArena(size_t blockSize)
+    : current(-1)
+    , offset(0)
+    , spilled(0)
+    , blockSize(qMax(blockSize, size_t(4096)))
+    , peak(0)
+    , allocationCount(0)
+    , blockCount(0)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    releaseBlocks();
+}
+
+void *FrameArena::allocate(size_t size, size_t alignment)
+{
+    ++allocationCount;
+    for (;;) {
+        if (current >= 0) {
+            const Block &block = blocks[current];
+            std::uintptr_t base = reinterpret_cast<std::uintptr_t>(block.data);
+            std::uintptr_t start = (base + offset + alignment - 1) & ~std::uintptr_t(alignment - 1);
+            if (start + size <= base + block.size) {
+                offset = start + size - base;
+                return reinterpret_cast<void *>(start);
+            }
+            spilled += offset;
+        }
+
+        // Full (or none yet): move on to the next kept block, or a new one
+        offset = 0;
+        if (current + 1 < blocks.size() && blocks[current + 1].size >= size + alignment) {
+            ++current;
+        } else {
+            addBlock(size + alignment);
+        }
+    }
+}
+
+void FrameArena::addBlock(size_t minimumSize)
+{
+    Block block;
+    block.size = qMax(blockSize, minimumSize);
+    block.data = static_cast<char *>(::operator new(block.size));
+    blocks.insert(current + 1, block);
+    ++current;
+    ++blockCount;
+}
+
+void FrameArena::reset()
+{
+    peak = qMax(peak, bytesUsed());
+
+    // Spilling frames are merged into one block big enough for all of them
+    if (blocks.size() > 1) {
+        size_t total = capacity();
+        releaseBlocks();
+        blockSize = qMax(blockSize, total);
+    }
+    current = blocks.isEmpty() ? -1 : 0;
+    offset = 0;
+    spilled = 0;
+    allocationCount = 0;
+    blockCount = 0;
+}
+
+size_t FrameArena::capacity() const
+{
+    size_t total = 0;
+    for (const Block &block : blocks) {
+        total += block.size;
+    }
+    return total;
+}
+
+void FrameArena::releaseBlocks()
+{
+    for (const Block &block : blocks) {
+        ::operator delete(block.data);
+    }
+    blocks.clear();
+    current = -1;
+}
@@ -0,0 +1,98 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <QVector>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+template <typename T> class ArenaAllocator;
+template <typename T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Bump allocator for memory that only lives for one frame.
+//
+// Allocation moves a pointer through a block; nothing is freed on its own,
+// everything is released at once by reset() at the start of the next frame.
+// The blocks are kept, and a frame that overflowed into extra blocks has
+// them merged into one, so after a frame or two of warm-up a steady frame
+// takes all its scratch memory from one block and never touches the heap.
+// One arena per thread: it is not thread-safe.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+    ~FrameArena();
+
+    // Memory valid until reset()
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Constructs an object in the arena; its destructor is the caller's job
+    template <typename T, typename... Args>
+    T *create(Args &&...args)
+    {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Empty vector drawing from this arena
+    template <typename T>
+    ArenaVector<T> vector() { return ArenaVector<T>(ArenaAllocator<T>(this)); }
+
+    void reset();
+
+    // This frame so far
+    size_t bytesUsed() const { return spilled + offset; }
+    int allocations() const { return allocationCount; }
+    int heapBlocks() const { return blockCount; } // Blocks that came from the heap
+
+    size_t peakBytes() const { return peak; } // Most used by any frame so far
+    size_t capacity() const;
+
+    static const size_t DEFAULT_BLOCK_SIZE;
+
+private:
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    struct Block {
+        char *data;
+        size_t size;
+    };
+
+    void addBlock(size_t minimumSize);
+    void releaseBlocks();
+
+    QVector<Block> blocks;
+    int current;    // Block being filled, or -1 before the first allocation
+    size_t offset;  // Bytes used in the current block
+    size_t spilled; // Bytes used in the blocks before it
+    size_t blockSize;
+    size_t peak;
+    int allocationCount;
+    int blockCount;
+};
+
+// Standard allocator over a FrameArena; deallocation is a no-op, so
+// containers using it must not outlive the arena's next reset()
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(FrameArena *arena) : arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+    T *allocate(size_t count) { return static_cast<T *>(arena->allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T *, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena != other.arena; }
+
+    FrameArena *arena;
+};
+
+#endif // FRAMEARENA_H
@@ -0,0 +1,57 @@
+#include "framecache.h"
+#include <QtMath>
+#include <cmath>
+
+const double FrameCache::SCALE_TOLERANCE = 1e-9; // Relative
+
+FrameCache::FrameCache(int budgetKilobytes)
+    : cache(budgetKilobytes)
+{
+}
+
+void FrameCache::insert(const Frame &frame)
+{
+    if (frame.image.isNull()) return;
+    // Frames larger than the whole budget are dropped by the cache
+    cache.insert(key(frame.view, 0), new Frame(frame), qMax(1, int(frame.image.sizeInBytes() / 1024)));
+}
+
+bool FrameCache::take(const MapView &view, Frame &frame)
+{
+    // Zooming out and back in again rarely lands on the same double, and
+    // may cross into the next band
+    quint64 frameKey = 0;
+    const Frame *cached = nullptr;
+    for (int step = -1; step <= 1 && !cached; ++step) {
+        frameKey = key(view, step);
+        cached = cache.object(frameKey);
+        if (cached && (qAbs(cached->view.scale - view.scale) > SCALE_TOLERANCE * view.scale
+                       || cached->view.devicePixelRatio != view.devicePixelRatio
+                       || cached->view.projection != view.projection)) {
+            cached = nullptr;
+        }
+    }
+    if (!cached) return false;
+
+    // Same zoom, so the frame maps onto the view by a translation
+    QTransform toView = view.transformFrom(cached->view);
+    QPoint offset(qRound(toView.dx()), qRound(toView.dy()));
+    bool aligned = qAbs(toView.dx() - offset.x()) < 0.01 && qAbs(toView.dy() - offset.y()) < 0.01;
+    if (!aligned || !QRect(offset, cached->view.size).contains(QRect(QPoint(), view.size))) return false;
+
+    frame = *cached;
+    cache.remove(frameKey);
+    return true;
+}
+
+int FrameCache::zoomBand(double scale)
+{
+    return qFloor(std::log2(scale) * 8);
+}
+
+quint64 FrameCache::key(const MapView &view, int bandStep)
+{
+    // Band (offset to stay positive) in the high half, ratio in thousandths
+    // in the low half
+    return (quint64(zoomBand(view.scale) + bandStep + 0x8000) << 32) | quint32(qRound(view.devicePixelRatio * 1000));
+}
@@ -0,0 +1,49 @@
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <QImage>
+#include <QCache>
+#include "maprenderer.h"
+
+// Rendered frames of the static layers, kept for going back to them.
+//
+// Frames are keyed by zoom band and device pixel ratio: returning to a zoom,
+// or moving the window back to a screen it was on, shows the frame rendered
+// there before instead of waiting for a new one. A 1x and a 2x frame never
+// replace each other, and a frame is only handed out for the ratio it was
+// rendered at, so it is never shown stretched. The least recently used
+// frames go once the budget is exceeded. Not thread-safe; the widget owns it.
+class FrameCache
+{
+public:
+    struct Frame {
+        QImage image; // Device pixels, with the view's device pixel ratio set
+        MapView view;
+    };
+
+    explicit FrameCache(int budgetKilobytes);
+
+    // Keeps a frame, replacing the one of the same zoom band and ratio
+    void insert(const Frame &frame);
+
+    // Removes a frame that shows view as is: same projection and ratio, a
+    // scale equal but for rounding, covering the view at an offset of whole
+    // pixels. False if there is none.
+    bool take(const MapView &view, Frame &frame);
+
+    void clear() { cache.clear(); }
+    int count() const { return cache.count(); }
+    int kilobytes() const { return cache.totalCost(); }
+
+    // Zoom in eighths of an octave
+    static int zoomBand(double scale);
+
+private:
+    static quint64 key(const MapView &view, int bandStep);
+
+    static const double SCALE_TOLERANCE;
+
+    QCache<quint64, Frame> cache; // Cost in kilobytes
+};
+
+#endif // FRAMECACHE_H
@@ -0,0 +1,175 @@
+#include "geojsonloader.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDebug>
+
+namespace {
+
+QJsonObject readDocument(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Could not open" << path;
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+QPolygonF readRing(const QJsonArray &coordinates)
+{
+    QPolygonF ring;
+    for (const auto &coord : coordinates) {
+        QJsonArray point = coord.toArray();
+        if (point.size() >= 2) {
+            double lon = point[0].toDouble();
+            double lat = point[1].toDouble();
+            ring << QPointF(lon, lat);
+        }
+    }
+    return ring;
+}
+
+void appendStations(const QJsonArray &features, bool withCodes, QVector<Station> &stations)
+{
+    for (const auto &feature : features) {
+        QJsonObject featureObj = feature.toObject();
+        QJsonObject properties = featureObj["properties"].toObject();
+        QJsonObject geometry = featureObj["geometry"].toObject();
+        if (geometry["type"].toString() != "Point") continue;
+
+        QJsonArray coordinates = geometry["coordinates"].toArray();
+        if (coordinates.size() < 2) continue;
+
+        Station station;
+        station.id = stations.size();
+        station.name = properties["name"].toString();
+        QString code = properties["code"].toString();
+        if (withCodes && !code.isEmpty()) {
+            station.name += " (" + code + ")";
+        }
+        station.lon = coordinates[0].toDouble();
+        station.lat = coordinates[1].toDouble();
+        stations.append(station);
+    }
+}
+
+} // namespace
+
+QVector<Station> GeoJsonLoader::loadStations(const QString &path)
+{
+    QVector<Station> stations;
+    QJsonObject root = readDocument(path);
+
+    if (root.contains("zones")) {
+        // Zone-based format; names carry the station code
+        QJsonObject zones = root["zones"].toObject();
+        for (auto zoneIt = zones.begin(); zoneIt != zones.end(); ++zoneIt) {
+            appendStations(zoneIt.value().toObject().value("features").toArray(), true, stations);
+        }
+    } else if (root.contains("features")) {
+        // Old plain GeoJSON format
+        appendStations(root.value("features").toArray(), false, stations);
+    }
+    return stations;
+}
+
+QVector<QPolygonF> GeoJsonLoader::loadBoundary(const QString &path)
+{
+    QVector<QPolygonF> boundary;
+    for (const auto &feature : readDocument(path).value("features").toArray()) {
+        QJsonObject geometry = feature.toObject()["geometry"].toObject();
+        if (geometry["type"].toString() != "Polygon") continue;
+
+        QJsonArray coordinates = geometry["coordinates"].toArray();
+        if (!coordinates.isEmpty()) {
+            boundary.append(readRing(coordinates[0].toArray()));
+        }
+    }
+    return boundary;
+}
+
+QVector<StateFeature> GeoJsonLoader::loadStateBoundaries(const QString &path)
+{
+    QVector<StateFeature> features;
+    for (const auto &feature : readDocument(path).value("features").toArray()) {
+        QJsonObject featureObj = feature.toObject();
+        QJsonObject properties = featureObj["properties"].toObject();
+        QJsonObject geometry = featureObj["geometry"].toObject();
+
+        StateFeature stateFeature;
+        stateFeature.name = properties["name"].toString();
+        stateFeature.type = properties["type"].toString();
+        stateFeature.minZoom = properties["min_zoom"].toDouble(0.0); // Default 0 = always show
+
+        QString geomType = geometry["type"].toString();
+        QJsonArray coordinates = geometry["coordinates"].toArray();
+        if (geomType == "Polygon") {
+            if (!coordinates.isEmpty()) {
+                stateFeature.polygons.append(readRing(coordinates[0].toArray()));
+            }
+        } else if (geomType == "MultiPolygon") {
+            for (const auto &polygonCoords : coordinates) {
+                QJsonArray rings = polygonCoords.toArray();
+                if (!rings.isEmpty()) {
+                    stateFeature.polygons.append(readRing(rings[0].toArray()));
+                }
+            }
+        } else if (geomType == "LineString") {
+            // Rivers
+            stateFeature.lineString = readRing(coordinates);
+        }
+
+        if (!stateFeature.polygons.isEmpty() || !stateFeature.lineString.isEmpty()) {
+            features.append(stateFeature);
+            qDebug() << "Loaded feature:" << stateFeature.name << "Type:" << stateFeature.type
+                     << "Polygons:" << stateFeature.polygons.size()
+                     << "LinePoints:" << stateFeature.lineString.size();
+        }
+    }
+    return features;
+}
+
+QVector<StateFeature> GeoJsonLoader::loadRailwayLines(const QString &path)
+{
+    QVector<StateFeature> lines;
+    if (!QFileInfo::exists(path)) return lines;
+
+    for (const auto &feature : readDocument(path).value("features").toArray()) {
+        QJsonObject featureObj = feature.toObject();
+        QJsonObject properties = featureObj["properties"].toObject();
+        QJsonObject geometry = featureObj["geometry"].toObject();
+
+        // A MultiLineString becomes one feature per line
+        QJsonArray parts;
+        if (geometry["type"].toString() == "LineString") {
+            parts.append(geometry["coordinates"].toArray());
+        } else if (geometry["type"].toString() == "MultiLineString") {
+            parts = geometry["coordinates"].toArray();
+        }
+
+        for (const auto &part : parts) {
+            StateFeature line;
+            line.name = properties["name"].toString();
+            line.type = "railway";
+            line.minZoom = properties["min_zoom"].toDouble(0.0);
+            line.lineString = readRing(part.toArray());
+            if (line.lineString.size() > 1) lines.append(line);
+        }
+    }
+    return lines;
+}
+
+QString GeoJsonLoader::sourceStamp(const QStringList &paths)
+{
+    // File names only, so the same data in another directory matches
+    QString stamp;
+    for (const QString &path : paths) {
+        QFileInfo info(path);
+        stamp += QString("%1:%2:%3;").arg(info.fileName()).arg(info.size()).arg(info.lastModified().toMSecsSinceEpoch());
+    }
+    return stamp;
+}
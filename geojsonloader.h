@@ -0,0 +1,34 @@
+#ifndef GEOJSONLOADER_H
+#define GEOJSONLOADER_H
+
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include <QPolygonF>
+#include "maprenderer.h"
+
+// Parses the map's GeoJSON data files. Shared by MapWidget and the
+// command-line renderer, so both draw exactly the same data. Missing or
+// unreadable files give empty results.
+class GeoJsonLoader
+{
+public:
+    // Points from the zone-based or plain GeoJSON station file, in file
+    // order; each station's id is its position in the file
+    static QVector<Station> loadStations(const QString &path);
+
+    // Outer rings of the boundary polygons
+    static QVector<QPolygonF> loadBoundary(const QString &path);
+
+    // State polygons and river lines with their name, type and min_zoom
+    static QVector<StateFeature> loadStateBoundaries(const QString &path);
+
+    // Railway shape lines (LineString/MultiLineString), one feature per line
+    static QVector<StateFeature> loadRailwayLines(const QString &path);
+
+    // Identifies the contents of the source files (name, size and mtime),
+    // so a geometry store built from them can be recognised as current
+    static QString sourceStamp(const QStringList &paths);
+};
+
+#endif // GEOJSONLOADER_H
@@ -0,0 +1,526 @@
+#include "geometrytilestore.h"
+#include "spatialorder.h"
+#include "coordinatecodec.h"
+#include <QDataStream>
+#include <QDebug>
+#include <cmath>
+#include <climits>
+#include <algorithm>
+
+const int GeometryTileStore::MAX_LEVEL = 14;         // Tolerance ~0.2 m for an India-sized root
+const int GeometryTileStore::TILE_SCREEN_SIZE = 512; // Largest on-screen tile size before going a level deeper
+
+static const int TILE_EXTENT = 1024;   // Simplification grid per tile side (half a pixel at most)
+static const int LEAF_VERTICES = 2048; // Tiles this small keep full detail and are not split
+static const quint32 FORMAT_VERSION = 2;  // Tile encoding and metadata layout
+static const quint32 LEAF_PAGE = 1;       // Page flag: full detail, serves every deeper level
+
+namespace {
+
+// Level in bits 40+, y in bits 20-39, x in bits 0-19
+quint64 tileKey(int level, int x, int y)
+{
+    return (quint64(level) << 40) | (quint64(y) << 20) | quint64(x);
+}
+
+QRectF tileRect(const QRectF &root, int level, int x, int y)
+{
+    double size = root.width() / (1 << level);
+    return QRectF(root.left() + x * size, root.top() + y * size, size, size);
+}
+
+QPolygonF closedRing(const QPolygonF &ring)
+{
+    QPolygonF closed = ring;
+    closed << ring.first();
+    return closed;
+}
+
+// A feature's geometry in a tile before projection, lon/lat
+struct RawPart {
+    int feature;
+    QVector<QPolygonF> fills;
+    QVector<QPolygonF> lines;
+};
+
+int vertexCount(const QVector<RawPart> &parts)
+{
+    int count = 0;
+    for (const RawPart &part : parts) {
+        for (const auto &fill : part.fills) count += fill.size();
+        for (const auto &line : part.lines) count += line.size();
+    }
+    return count;
+}
+
+// Douglas-Peucker over points[first..last]; the endpoints must already be kept
+void markChain(const QPolygonF &points, int first, int last, double tolerance2, QVector<bool> &keep)
+{
+    QVector<QPair<int, int>> stack;
+    stack.append(qMakePair(first, last));
+    while (!stack.isEmpty()) {
+        QPair<int, int> chain = stack.takeLast();
+        const QPointF &a = points[chain.first], &b = points[chain.second];
+        QPointF d = b - a;
+        double length2 = d.x() * d.x() + d.y() * d.y();
+
+        double farthest = 0;
+        int index = -1;
+        for (int i = chain.first + 1; i < chain.second; ++i) {
+            QPointF v = points[i] - a;
+            double t = length2 > 0 ? qBound(0.0, (v.x() * d.x() + v.y() * d.y()) / length2, 1.0) : 0.0;
+            QPointF e = v - d * t;
+            double distance2 = e.x() * e.x() + e.y() * e.y();
+            if (distance2 > farthest) {
+                farthest = distance2;
+                index = i;
+            }
+        }
+        if (index >= 0 && farthest > tolerance2) {
+            keep[index] = true;
+            stack.append(qMakePair(chain.first, index));
+            stack.append(qMakePair(index, chain.second));
+        }
+    }
+}
+
+QPolygonF simplifyLine(const QPolygonF &line, double tolerance)
+{
+    if (line.size() <= 2) return line;
+    QVector<bool> keep(line.size(), false);
+    keep.first() = keep.last() = true;
+    markChain(line, 0, line.size() - 1, tolerance * tolerance, keep);
+
+    QPolygonF simplified;
+    for (int i = 0; i < line.size(); ++i) {
+        if (keep[i]) simplified << line[i];
+    }
+    return simplified;
+}
+
+bool onRectBorder(const QPointF &p, const QRectF &rect)
+{
+    return p.x() == rect.left() || p.x() == rect.right() || p.y() == rect.top() || p.y() == rect.bottom();
+}
+
+// Vertices on the tile border (where the ring was clipped) are kept, so the
+// simplified fill still meets its neighbours exactly
+QPolygonF simplifyRing(const QPolygonF &ring, double tolerance, const QRectF &rect)
+{
+    int n = ring.size();
+    if (n <= 4) return ring;
+
+    QVector<int> anchors;
+    for (int i = 0; i < n; ++i) {
+        if (onRectBorder(ring[i], rect)) anchors.append(i);
+    }
+    if (anchors.isEmpty()) {
+        // Split a free ring at its first vertex and the vertex farthest from it
+        int farthest = 0;
+        double best = -1;
+        for (int i = 1; i < n; ++i) {
+            QPointF d = ring[i] - ring[0];
+            double distance2 = d.x() * d.x() + d.y() * d.y();
+            if (distance2 > best) {
+                best = distance2;
+                farthest = i;
+            }
+        }
+        anchors << 0 << farthest;
+    }
+
+    // Unroll the ring from the first anchor; the last point repeats the first
+    int start = anchors.first();
+    QPolygonF loop(n + 1);
+    for (int k = 0; k <= n; ++k) loop[k] = ring[(start + k) % n];
+
+    QVector<bool> keep(n + 1, false);
+    for (int anchor : anchors) keep[(anchor - start + n) % n] = true;
+    keep[n] = true;
+
+    double tolerance2 = tolerance * tolerance;
+    int previous = 0;
+    for (int k = 1; k <= n; ++k) {
+        if (!keep[k]) continue;
+        markChain(loop, previous, k, tolerance2, keep);
+        previous = k;
+    }
+
+    QPolygonF simplified;
+    for (int k = 0; k < n; ++k) {
+        if (keep[k]) simplified << loop[k];
+    }
+    return simplified.size() >= 3 ? simplified : QPolygonF();
+}
+
+QVector<RawPart> simplifyParts(const QVector<RawPart> &parts, double tolerance, const QRectF &rect)
+{
+    QVector<RawPart> simplified;
+    for (const RawPart &part : parts) {
+        RawPart out{ part.feature, {}, {} };
+        for (const auto &fill : part.fills) {
+            QPolygonF ring = simplifyRing(fill, tolerance, rect);
+            if (!ring.isEmpty()) out.fills.append(ring);
+        }
+        for (const auto &line : part.lines) {
+            out.lines.append(simplifyLine(line, tolerance));
+        }
+        if (!out.fills.isEmpty() || !out.lines.isEmpty()) simplified.append(out);
+    }
+    return simplified;
+}
+
+QVector<RawPart> clipParts(const QVector<RawPart> &parts, const QRectF &rect)
+{
+    QVector<RawPart> clipped;
+    for (const RawPart &part : parts) {
+        RawPart out{ part.feature, {}, {} };
+        for (const auto &fill : part.fills) {
+            QRectF bounds = fill.boundingRect();
+            if (!bounds.intersects(rect)) continue;
+            QPolygonF ring = rect.contains(bounds) ? fill : clipPolygonToRect(fill, rect);
+            if (ring.size() >= 3) out.fills.append(ring);
+        }
+        for (const auto &line : part.lines) {
+            QRectF bounds = line.boundingRect();
+            if (!bounds.intersects(rect)) continue;
+            if (rect.contains(bounds)) {
+                out.lines.append(line);
+            } else {
+                out.lines += clipPolylineToRect(line, rect);
+            }
+        }
+        if (!out.fills.isEmpty() || !out.lines.isEmpty()) clipped.append(out);
+    }
+    return clipped;
+}
+
+// Quantized, delta-coded coordinates: a page is a quarter to an eighth of
+// the size of the same geometry as doubles, on disk and in the page cache.
+// Decoded tiles hold doubles again.
+QByteArray encodeTile(const QVector<RawPart> &parts)
+{
+    CoordinateCodec::Writer writer;
+    writer.writeCount(quint32(parts.size()));
+    for (const RawPart &part : parts) {
+        writer.writeInt(part.feature);
+        writer.writeCount(quint32(part.fills.size()));
+        for (const auto &fill : part.fills) writer.writePoints(fill);
+        writer.writeCount(quint32(part.lines.size()));
+        for (const auto &line : part.lines) writer.writePoints(line);
+    }
+    return writer.data();
+}
+
+bool decodeTile(const QByteArray &data, QVector<RawPart> &parts)
+{
+    CoordinateCodec::Reader reader(data);
+    quint32 count = 0;
+    reader.readCount(count);
+    parts.clear();
+    for (quint32 i = 0; i < count && reader.isOk(); ++i) {
+        RawPart part;
+        quint32 fills = 0, lines = 0;
+        reader.readInt(part.feature);
+        reader.readCount(fills);
+        for (quint32 f = 0; f < fills && reader.isOk(); ++f) {
+            QPolygonF fill;
+            if (reader.readPoints(fill)) part.fills.append(fill);
+        }
+        reader.readCount(lines);
+        for (quint32 l = 0; l < lines && reader.isOk(); ++l) {
+            QPolygonF line;
+            if (reader.readPoints(line)) part.lines.append(line);
+        }
+        parts.append(part);
+    }
+    return !data.isEmpty() && reader.isOk() && reader.atEnd();
+}
+
+// Writes a tile and, unless it keeps full detail, its four children. The
+// children are visited along the Hilbert curve, so pages of neighbouring
+// tiles end up next to each other in the store.
+class PyramidWriter
+{
+public:
+    PyramidWriter(FeatureStore::Writer &pages, const QRectF &root) : pages(pages), root(root), tileCount(0) {}
+
+    void write(int level, int x, int y, const QVector<RawPart> &parts)
+    {
+        int vertices = vertexCount(parts);
+        if (!pages.isOk() || vertices == 0) return;
+
+        QRectF rect = tileRect(root, level, x, y);
+        bool leaf = level == GeometryTileStore::MAX_LEVEL || vertices <= LEAF_VERTICES;
+        double tolerance = rect.width() / TILE_EXTENT;
+        QVector<RawPart> stored = leaf ? parts : simplifyParts(parts, tolerance, rect);
+        pages.addPage(tileKey(level, x, y), encodeTile(stored), leaf ? LEAF_PAGE : 0);
+        ++tileCount;
+        if (leaf) return;
+
+        QVector<QPair<quint64, int>> children;
+        for (int child = 0; child < 4; ++child) {
+            int cx = 2 * x + (child & 1), cy = 2 * y + (child >> 1);
+            children.append(qMakePair(SpatialOrder::hilbertIndex(level + 1, cx, cy), child));
+        }
+        std::sort(children.begin(), children.end());
+        for (const auto &child : children) {
+            int cx = 2 * x + (child.second & 1), cy = 2 * y + (child.second >> 1);
+            write(level + 1, cx, cy, clipParts(parts, tileRect(root, level + 1, cx, cy)));
+        }
+    }
+
+    FeatureStore::Writer &pages;
+    QRectF root;
+    int tileCount;
+};
+
+} // namespace
+
+GeometryTileStore::GeometryTileStore()
+    : cache(64 * 1024) // Kilobytes
+{
+}
+
+bool GeometryTileStore::build(const QString &path, const QVector<StateFeature> &features,
+                              const QVector<QPolygonF> &boundary, const QString &sourceStamp)
+{
+    // Fills for the area, closed outlines and open lines for the strokes
+    QVector<RawPart> parts;
+    RawPart boundaryPart{ -1, {}, {} };
+    for (const auto &ring : boundary) {
+        if (ring.size() < 3) continue;
+        boundaryPart.fills.append(ring);
+        boundaryPart.lines.append(closedRing(ring));
+    }
+    if (!boundaryPart.fills.isEmpty()) parts.append(boundaryPart);
+
+    for (int f = 0; f < features.size(); ++f) {
+        RawPart part{ f, {}, {} };
+        for (const auto &ring : features[f].polygons) {
+            if (ring.size() < 3) continue;
+            part.fills.append(ring);
+            if (features[f].outlined) part.lines.append(closedRing(ring));
+        }
+        if (features[f].lineString.size() > 1) part.lines.append(QPolygonF(features[f].lineString));
+        if (!part.fills.isEmpty() || !part.lines.isEmpty()) parts.append(part);
+    }
+
+    // Square root tile around everything, with a little room at the edges
+    QRectF bounds;
+    for (const RawPart &part : parts) {
+        for (const auto &line : part.lines) bounds = bounds.united(line.boundingRect());
+    }
+    double side = qMax(qMax(bounds.width(), bounds.height()) * 1.02, 1e-6);
+    QRectF root(bounds.center() - QPointF(side / 2, side / 2), QSizeF(side, side));
+
+    FeatureStore::Writer pages(path);
+    PyramidWriter writer(pages, root);
+    writer.write(0, 0, 0, parts);
+
+    QByteArray metadata;
+    QDataStream stream(&metadata, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << FORMAT_VERSION << sourceStamp << root;
+    stream << qint32(features.size());
+    for (const auto &feature : features) {
+        stream << feature.name << feature.type << feature.minZoom;
+    }
+    if (!pages.finish(metadata)) {
+        qWarning() << "Could not write geometry store" << path;
+        return false;
+    }
+
+    qDebug() << "Geometry store:" << writer.tileCount << "tiles in" << path;
+    return true;
+}
+
+bool GeometryTileStore::open(const QString &path)
+{
+    close();
+
+    QMutexLocker locker(&mutex);
+    if (!pages.open(path)) return false;
+
+    QDataStream stream(pages.metadata());
+    stream.setVersion(QDataStream::Qt_5_12);
+    quint32 version = 0;
+    qint32 featureCount = 0;
+    stream >> version >> stamp >> root >> featureCount;
+    for (int i = 0; i < featureCount && stream.status() == QDataStream::Ok; ++i) {
+        StateFeature feature;
+        stream >> feature.name >> feature.type >> feature.minZoom;
+        featureInfo.append(feature);
+    }
+    if (version != FORMAT_VERSION || stream.status() != QDataStream::Ok) {
+        qWarning() << "Unsupported geometry store" << path;
+        pages.close();
+        stamp.clear();
+        featureInfo.clear();
+        return false;
+    }
+    return true;
+}
+
+void GeometryTileStore::close()
+{
+    QMutexLocker locker(&mutex);
+    pages.close();
+    stamp.clear();
+    featureInfo.clear();
+    cache.clear();
+}
+
+void GeometryTileStore::setCacheLimit(int kilobytes)
+{
+    QMutexLocker locker(&mutex);
+    cache.setMaxCost(kilobytes);
+}
+
+int GeometryTileStore::cachedKilobytes() const
+{
+    QMutexLocker locker(&mutex);
+    return cache.totalCost() + pages.cachedKilobytes();
+}
+
+GeometryTileStore::Overview GeometryTileStore::overview() const
+{
+    Overview result;
+    result.features = featureInfo;
+    if (!isOpen()) return result;
+
+    // The root tile is the whole dataset at the coarsest tolerance
+    QVector<RawPart> parts;
+    if (!decodeTile(pages.page(tileKey(0, 0, 0)), parts)) return result;
+    for (const RawPart &part : parts) {
+        if (part.feature < 0) {
+            result.boundary += part.fills;
+        } else if (part.feature < result.features.size()) {
+            StateFeature &feature = result.features[part.feature];
+            feature.polygons = part.fills;
+            if (part.fills.isEmpty()) {
+                for (const auto &line : part.lines) feature.lineString += line;
+            }
+        }
+    }
+    return result;
+}
+
+int GeometryTileStore::levelFor(double pixelsPerUnit) const
+{
+    double rootPixels = root.width() * pixelsPerUnit;
+    if (rootPixels <= TILE_SCREEN_SIZE) return 0;
+    return qBound(0, int(std::ceil(std::log2(rootPixels / TILE_SCREEN_SIZE))), MAX_LEVEL);
+}
+
+bool GeometryTileStore::findStoredTile(int level, int x, int y, quint64 &key) const
+{
+    // The deepest stored ancestor serves the tile if it is a leaf; a stored
+    // ancestor that was split but has no such child means the tile is empty
+    for (int l = level; l >= 0; --l) {
+        int shift = level - l;
+        quint64 candidate = tileKey(l, x >> shift, y >> shift);
+        quint32 flags = 0;
+        if (!pages.find(candidate, &flags)) continue;
+        if (l < level && !(flags & LEAF_PAGE)) return false;
+        key = candidate;
+        return true;
+    }
+    return false;
+}
+
+GeometryTileStore::TilePointer GeometryTileStore::loadTile(quint64 key, const MapProjection &projection) const
+{
+    quint64 cacheKey = key | (quint64(projection.type()) << 56);
+    {
+        QMutexLocker locker(&mutex);
+        if (TilePointer *cached = cache.object(cacheKey)) return *cached;
+    }
+
+    // Decoded, projected and triangulated outside the lock, so render bands
+    // load cold tiles in parallel. A page evicted from the decoded cache may
+    // still be in the page cache.
+    QVector<RawPart> parts;
+    if (!decodeTile(pages.page(key), parts)) {
+        qWarning() << "Could not read geometry tile" << key;
+        return TilePointer();
+    }
+
+    // Projected and triangulated once per load, like the in-memory features
+    QSharedPointer<Tile> tile(new Tile);
+    qint64 bytes = sizeof(Tile);
+    for (const RawPart &raw : parts) {
+        Part part;
+        part.feature = raw.feature;
+        for (const auto &fill : raw.fills) {
+            part.fills.append(LocalPolygon::fromGeo(fill, projection, true));
+            tile->bounds = tile->bounds.united(part.fills.last().bounds);
+            bytes += fill.size() * sizeof(QPointF) + part.fills.last().mesh.triangleCount() * 3 * sizeof(int);
+        }
+        for (const auto &line : raw.lines) {
+            part.lines.append(LocalPolygon::fromGeo(line, projection));
+            tile->bounds = tile->bounds.united(part.lines.last().bounds);
+            bytes += line.size() * sizeof(QPointF);
+        }
+        tile->parts.append(part);
+    }
+    tile->bytes = int(qMin<qint64>(bytes, INT_MAX));
+
+    QMutexLocker locker(&mutex);
+    TilePointer result = tile;
+    cache.insert(cacheKey, new TilePointer(result), qMax(1, tile->bytes / 1024));
+    return result;
+}
+
+void GeometryTileStore::tilesFor(const QRectF &geoRect, int level, const MapProjection &projection,
+                                 ArenaVector<TilePointer> &tiles) const
+{
+    // The page index is fixed while the store is open; only the tile cache
+    // takes the lock
+    if (!pages.isOpen() || !geoRect.intersects(root)) return;
+
+    int n = 1 << level;
+    double size = root.width() / n;
+    int x0 = qBound(0, int(std::floor((geoRect.left() - root.left()) / size)), n - 1);
+    int x1 = qBound(0, int(std::floor((geoRect.right() - root.left()) / size)), n - 1);
+    int y0 = qBound(0, int(std::floor((geoRect.top() - root.top()) / size)), n - 1);
+    int y1 = qBound(0, int(std::floor((geoRect.bottom() - root.top()) / size)), n - 1);
+
+    // A leaf serving a deeper level covers several positions; a view holds
+    // a few dozen tiles, so a linear search finds repeats
+    ArenaVector<quint64> seen{ ArenaAllocator<quint64>(tiles.get_allocator()) };
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            quint64 key;
+            if (!findStoredTile(level, x, y, key) || std::find(seen.begin(), seen.end(), key) != seen.end()) continue;
+            seen.push_back(key);
+            TilePointer tile = loadTile(key, projection);
+            if (tile) tiles.push_back(tile);
+        }
+    }
+}
+
+int GeometryTileStore::featureAt(double lon, double lat, const MapProjection &projection) const
+{
+    if (!pages.isOpen() || !root.contains(lon, lat)) return -1;
+
+    int n = 1 << MAX_LEVEL;
+    double size = root.width() / n;
+    int x = qBound(0, int((lon - root.left()) / size), n - 1);
+    int y = qBound(0, int((lat - root.top()) / size), n - 1);
+    quint64 key;
+    if (!findStoredTile(MAX_LEVEL, x, y, key)) return -1;
+    TilePointer tile = loadTile(key, projection);
+    if (!tile) return -1;
+
+    QPointF point = projection.forward(lon, lat);
+    for (const Part &part : tile->parts) {
+        if (part.feature < 0) continue;
+        for (const auto &fill : part.fills) {
+            if (fill.bounds.contains(point) && fill.points.containsPoint(point - fill.origin, Qt::OddEvenFill)) {
+                return part.feature;
+            }
+        }
+    }
+    return -1;
+}
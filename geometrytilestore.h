@@ -0,0 +1,95 @@
+#ifndef GEOMETRYTILESTORE_H
+#define GEOMETRYTILESTORE_H
+
+#include <QVector>
+#include <QCache>
+#include <QString>
+#include <QRectF>
+#include <QPolygonF>
+#include <QSharedPointer>
+#include <QMutex>
+#include "maprenderer.h"
+#include "featurestore.h"
+
+// Spatially partitioned on-disk copy of the boundary and state geometry.
+//
+// The data is cut into a quadtree of square lon/lat tiles, stored as one
+// FeatureStore page each. Every level halves the tile size and the
+// simplification tolerance, so a view loads only the tiles it covers, at the
+// detail its zoom can show: a deep zoom into one region reads that region's
+// detailed geometry and nothing else. A tile whose full-detail geometry is
+// small is stored as a leaf and serves every deeper level. Loaded tiles are
+// projected once and kept in a cache with a fixed memory budget, so memory
+// does not grow with the installed data.
+class GeometryTileStore
+{
+public:
+    // One feature's geometry inside a tile, projected and origin-rebased
+    struct Part {
+        int feature;               // Index into the features the store was built from, -1 = boundary
+        QVector<LocalPolygon> fills; // Polygons clipped to the tile; they tile exactly with neighbours
+        QVector<LocalPolygon> lines; // Outlines and rivers clipped to the tile, as open runs
+    };
+
+    struct Tile {
+        QRectF bounds; // Projected units
+        QVector<Part> parts;
+        int bytes = 0;
+    };
+    typedef QSharedPointer<const Tile> TilePointer;
+
+    // Names and types of the stored features; geometry is the root-level
+    // (whole-country) simplification
+    struct Overview {
+        QVector<StateFeature> features;
+        QVector<QPolygonF> boundary;
+    };
+
+    GeometryTileStore();
+
+    // Writes the pyramid for the given features and boundary (lon/lat) to
+    // the store file at path, replacing it. sourceStamp identifies the
+    // source data so a stale store can be detected on open.
+    static bool build(const QString &path, const QVector<StateFeature> &features,
+                      const QVector<QPolygonF> &boundary, const QString &sourceStamp);
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return pages.isOpen(); }
+    QString sourceStamp() const { return stamp; }
+    Overview overview() const;
+
+    // Budget for projected tiles; raw pages have their own in the FeatureStore
+    void setCacheLimit(int kilobytes);
+    int cachedKilobytes() const; // Projected tiles and raw pages
+
+    // Level whose tiles appear at most TILE_SCREEN_SIZE pixels wide
+    int levelFor(double pixelsPerUnit) const;
+
+    // Appends the tiles covering geoRect (lon/lat) at the given level to
+    // tiles. Where the level is deeper than the stored data, the covering
+    // leaf is returned instead. Safe to call from several render threads at
+    // once, but not while the store is being opened or closed.
+    void tilesFor(const QRectF &geoRect, int level, const MapProjection &projection,
+                  ArenaVector<TilePointer> &tiles) const;
+
+    // Feature whose fill contains the point at full detail, or -1
+    int featureAt(double lon, double lat, const MapProjection &projection) const;
+
+    static const int MAX_LEVEL;
+    static const int TILE_SCREEN_SIZE;
+
+private:
+    bool findStoredTile(int level, int x, int y, quint64 &key) const;
+    TilePointer loadTile(quint64 key, const MapProjection &projection) const;
+
+    FeatureStore pages; // Tile key -> encoded lon/lat geometry
+    QString stamp;
+    QRectF root; // Square lon/lat extent of level 0
+    QVector<StateFeature> featureInfo;
+
+    mutable QCache<quint64, TilePointer> cache; // Keyed by tile and projection, cost in kilobytes
+    mutable QMutex mutex; // Guards the cache; tiles are decoded outside it
+};
+
+#endif // GEOMETRYTILESTORE_H
@@ -0,0 +1,241 @@
+#include "localgeometry.h"
+
+const int LinePath::CHUNK_POINTS = 512;
+
+LocalPolygon LocalPolygon::fromGeo(const QPolygonF &geo, const MapProjection &projection, bool triangulate)
+{
+    LocalPolygon local;
+    local.points = QPolygonF(geo.size());
+    projection.forward(geo.constData(), local.points.data(), geo.size());
+
+    local.bounds = local.points.boundingRect();
+    local.origin = local.bounds.center();
+    for (QPointF &point : local.points) {
+        point -= local.origin;
+    }
+    if (triangulate) {
+        local.mesh = PolygonMesh(local.points);
+    }
+    return local;
+}
+
+LinePath LinePath::fromLocal(const LocalPolygon &line)
+{
+    LinePath paths;
+    int size = line.points.size();
+    if (size < 2) return paths;
+
+    const QPointF *points = line.points.constData();
+    paths.path.moveTo(points[0]);
+    for (int i = 1; i < size; ++i) {
+        paths.path.lineTo(points[i]);
+    }
+
+    for (int first = 0; first + 1 < size; first += CHUNK_POINTS - 1) {
+        Chunk chunk;
+        chunk.first = first;
+        chunk.count = qMin(CHUNK_POINTS, size - first);
+        chunk.path.moveTo(points[first]);
+        for (int i = first + 1; i < first + chunk.count; ++i) {
+            chunk.path.lineTo(points[i]);
+        }
+        chunk.bounds = chunk.path.controlPointRect().translated(line.origin);
+        paths.chunks.append(chunk);
+    }
+    return paths;
+}
+
+QPointF ViewTransform::unmap(const QPointF &screen) const
+{
+    return QPointF((screen.x() - screenCenter.x()) / pixelsPerUnit + center.x(),
+                   center.y() - (screen.y() - screenCenter.y()) / pixelsPerUnit);
+}
+
+QRectF ViewTransform::mapRect(const QRectF &projected) const
+{
+    return QRectF(map(projected.topLeft()), map(projected.bottomRight())).normalized();
+}
+
+QRectF ViewTransform::unmapRect(const QRectF &screen) const
+{
+    return QRectF(unmap(screen.topLeft()), unmap(screen.bottomRight())).normalized();
+}
+
+void ViewTransform::mapLocal(const LocalPolygon &polygon, ArenaVector<QPointF> &screen) const
+{
+    mapLocal(polygon, 0, polygon.points.size(), screen);
+}
+
+void ViewTransform::mapLocal(const LocalPolygon &polygon, int first, int count, ArenaVector<QPointF> &screen) const
+{
+    QPointF offset = map(polygon.origin);
+    double ppu = pixelsPerUnit;
+
+    screen.resize(count);
+    const QPointF *in = polygon.points.constData() + first;
+    QPointF *out = screen.data();
+    for (int i = 0; i < count; ++i) {
+        out[i] = QPointF(in[i].x() * ppu + offset.x(), offset.y() - in[i].y() * ppu);
+    }
+}
+
+QTransform ViewTransform::localTransform(const LocalPolygon &polygon) const
+{
+    QPointF offset = map(polygon.origin);
+    return QTransform(pixelsPerUnit, 0, 0, -pixelsPerUnit, offset.x(), offset.y());
+}
+
+namespace {
+
+enum RectEdge { LeftEdge, RightEdge, TopEdge, BottomEdge };
+
+bool insideEdge(const QPointF &p, const QRectF &rect, RectEdge edge)
+{
+    switch (edge) {
+    case LeftEdge: return p.x() >= rect.left();
+    case RightEdge: return p.x() <= rect.right();
+    case TopEdge: return p.y() >= rect.top();
+    case BottomEdge: return p.y() <= rect.bottom();
+    }
+    return true;
+}
+
+QPointF intersectEdge(const QPointF &a, const QPointF &b, const QRectF &rect, RectEdge edge)
+{
+    double t;
+    switch (edge) {
+    case LeftEdge:
+    case RightEdge: {
+        double x = edge == LeftEdge ? rect.left() : rect.right();
+        t = (x - a.x()) / (b.x() - a.x());
+        return QPointF(x, a.y() + t * (b.y() - a.y()));
+    }
+    case TopEdge:
+    case BottomEdge: {
+        double y = edge == TopEdge ? rect.top() : rect.bottom();
+        t = (y - a.y()) / (b.y() - a.y());
+        return QPointF(a.x() + t * (b.x() - a.x()), y);
+    }
+    }
+    return a;
+}
+
+// Sutherland-Hodgman; output holds the polygon on entry and the clipped
+// polygon on return, scratch is reused between the edges
+template <typename Points>
+void clipPolygonInPlace(Points &output, Points &scratch, const QRectF &rect)
+{
+    const RectEdge edges[] = { LeftEdge, RightEdge, TopEdge, BottomEdge };
+
+    for (RectEdge edge : edges) {
+        if (output.empty()) break;
+        scratch.swap(output);
+        output.clear();
+
+        QPointF previous = scratch.back();
+        bool previousInside = insideEdge(previous, rect, edge);
+        for (const QPointF &current : scratch) {
+            bool currentInside = insideEdge(current, rect, edge);
+            if (currentInside != previousInside) {
+                output.push_back(intersectEdge(previous, current, rect, edge));
+            }
+            if (currentInside) {
+                output.push_back(current);
+            }
+            previous = current;
+            previousInside = currentInside;
+        }
+    }
+}
+
+// Liang-Barsky per segment; runs are appended to output one after another
+// and each run's end index to runEnds
+template <typename Points, typename Ends>
+void clipPolylineRuns(const QPointF *polyline, int count, const QRectF &rect, Points &output, Ends &runEnds)
+{
+    int runStart = int(output.size());
+    auto endRun = [&]() {
+        if (int(output.size()) - runStart > 1) {
+            runEnds.push_back(int(output.size()));
+        } else {
+            output.resize(runStart);
+        }
+        runStart = int(output.size());
+    };
+
+    for (int i = 0; i + 1 < count; ++i) {
+        QPointF a = polyline[i], b = polyline[i + 1];
+        QPointF d = b - a;
+
+        // Liang-Barsky against the four edges
+        double t0 = 0.0, t1 = 1.0;
+        const double p[4] = { -d.x(), d.x(), -d.y(), d.y() };
+        const double q[4] = { a.x() - rect.left(), rect.right() - a.x(), a.y() - rect.top(), rect.bottom() - a.y() };
+        bool visible = true;
+        for (int k = 0; k < 4 && visible; ++k) {
+            if (p[k] == 0.0) {
+                visible = q[k] >= 0.0;
+            } else if (p[k] < 0.0) {
+                t0 = qMax(t0, q[k] / p[k]);
+            } else {
+                t1 = qMin(t1, q[k] / p[k]);
+            }
+            if (t0 > t1) visible = false;
+        }
+
+        if (!visible) {
+            endRun();
+            continue;
+        }
+
+        // A clipped start means the line re-entered the rect
+        if (t0 > 0.0 || int(output.size()) == runStart) {
+            endRun();
+            output.push_back(a + d * t0);
+        }
+        output.push_back(a + d * t1);
+
+        if (t1 < 1.0) endRun();
+    }
+
+    endRun();
+}
+
+} // namespace
+
+QPolygonF clipPolygonToRect(const QPolygonF &polygon, const QRectF &rect)
+{
+    QPolygonF output = polygon, scratch;
+    clipPolygonInPlace(output, scratch, rect);
+    return output;
+}
+
+QVector<QPolygonF> clipPolylineToRect(const QPolygonF &polyline, const QRectF &rect)
+{
+    QPolygonF points;
+    QVector<int> runEnds;
+    clipPolylineRuns(polyline.constData(), polyline.size(), rect, points, runEnds);
+
+    QVector<QPolygonF> runs;
+    int start = 0;
+    for (int end : runEnds) {
+        runs.append(QPolygonF(points.mid(start, end - start)));
+        start = end;
+    }
+    return runs;
+}
+
+void clipPolygonToRect(const QPointF *points, int count, const QRectF &rect,
+                       ArenaVector<QPointF> &output, ArenaVector<QPointF> &scratch)
+{
+    output.assign(points, points + count);
+    clipPolygonInPlace(output, scratch, rect);
+}
+
+void clipPolylineToRect(const QPointF *points, int count, const QRectF &rect,
+                        ArenaVector<QPointF> &output, ArenaVector<int> &runEnds)
+{
+    output.clear();
+    runEnds.clear();
+    clipPolylineRuns(points, count, rect, output, runEnds);
+}
@@ -0,0 +1,89 @@
+#ifndef LOCALGEOMETRY_H
+#define LOCALGEOMETRY_H
+
+#include <QPointF>
+#include <QRectF>
+#include <QPolygonF>
+#include <QTransform>
+#include <QVector>
+#include <QPainterPath>
+#include "mapprojection.h"
+#include "polygonmesh.h"
+#include "framearena.h"
+
+// Projected geometry rebased on a local origin (the centre of its bounds).
+// Screen positions are formed as (origin - camera) * scale + local * scale,
+// so large absolute coordinates are never multiplied by a deep-zoom scale.
+struct LocalPolygon;
+
+// A line as painter paths in its polygon's local units, built once instead
+// of mapping and stroking it segment by segment every frame. The whole line
+// is one path, and it is also cut into runs of CHUNK_POINTS points (sharing
+// their end points) with their bounds, so a deep zoom only strokes the runs
+// in view.
+struct LinePath {
+    struct Chunk {
+        QRectF bounds; // Projected units, absolute
+        QPainterPath path;
+        int first;     // Index of the run's first point in the line
+        int count;
+    };
+
+    QPainterPath path;
+    QVector<Chunk> chunks;
+
+    bool isEmpty() const { return chunks.isEmpty(); }
+    static LinePath fromLocal(const LocalPolygon &line);
+
+    static const int CHUNK_POINTS;
+};
+
+struct LocalPolygon {
+    QPointF origin;   // Projected units
+    QRectF bounds;    // Projected units, absolute
+    QPolygonF points; // Projected units relative to origin
+    PolygonMesh mesh; // Triangles over points; empty for lines
+    LinePath strokes; // Cached paths of in-memory lines; empty otherwise
+
+    static LocalPolygon fromGeo(const QPolygonF &geo, const MapProjection &projection, bool triangulate = false);
+};
+
+// Camera-relative mapping from projected units to screen pixels
+struct ViewTransform {
+    QPointF center;       // Projected view centre
+    QPointF screenCenter; // Screen position of the view centre
+    double pixelsPerUnit = 1.0;
+
+    QPointF map(const QPointF &projected) const
+    {
+        return QPointF((projected.x() - center.x()) * pixelsPerUnit + screenCenter.x(),
+                       (center.y() - projected.y()) * pixelsPerUnit + screenCenter.y());
+    }
+    QPointF unmap(const QPointF &screen) const;
+    QRectF mapRect(const QRectF &projected) const;
+    QRectF unmapRect(const QRectF &screen) const;
+
+    // Maps a local polygon, or count of its points from first; the origin
+    // offset is taken before scaling
+    void mapLocal(const LocalPolygon &polygon, ArenaVector<QPointF> &screen) const;
+    void mapLocal(const LocalPolygon &polygon, int first, int count, ArenaVector<QPointF> &screen) const;
+
+    // Painter transform drawing the polygon's local units in place
+    QTransform localTransform(const LocalPolygon &polygon) const;
+};
+
+// Guard-band clipping, so the rasterizer only sees screen-local coordinates.
+// Polygons stay closed (Sutherland-Hodgman); polylines split into runs.
+QPolygonF clipPolygonToRect(const QPolygonF &polygon, const QRectF &rect);
+QVector<QPolygonF> clipPolylineToRect(const QPolygonF &polyline, const QRectF &rect);
+
+// The same for frame-time use, into arena buffers that keep their capacity
+// from call to call. Polygon clipping alternates between output and
+// scratch; polyline runs follow each other in output, and runEnds holds the
+// index one past the end of each run.
+void clipPolygonToRect(const QPointF *points, int count, const QRectF &rect,
+                       ArenaVector<QPointF> &output, ArenaVector<QPointF> &scratch);
+void clipPolylineToRect(const QPointF *points, int count, const QRectF &rect,
+                        ArenaVector<QPointF> &output, ArenaVector<int> &runEnds);
+
+#endif // LOCALGEOMETRY_H
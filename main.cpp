@@ -1,10 +1,84 @@
 #include "mainwindow.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+#include <csignal>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// SIGUSR1 asks for a memory report. The handler may only make
+// async-signal-safe calls, so it writes a byte that wakes the event loop.
+int reportSignalSockets[2];
+
+void reportSignalHandler(int)
+{
+    char byte = 1;
+    ssize_t written = ::write(reportSignalSockets[0], &byte, 1);
+    Q_UNUSED(written);
+}
+
+} // namespace
+#endif
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption projectionOption("projection",
+        "Map projection: equirectangular (default), mercator or lcc.", "name", "equirectangular");
+    parser.addOption(projectionOption);
+    QCommandLineOption choroplethOption("choropleth", "Shade states by the number of stations they contain.");
+    parser.addOption(choroplethOption);
+    QCommandLineOption rasterOption("raster-tiles",
+        "Draw the base layers from a tile archive written by maprender --archive.", "file");
+    parser.addOption(rasterOption);
+    QCommandLineOption vectorTilesOption("vector-tiles",
+        "Read states, rivers and railways from a vector tile set (directory of z/x/y.mvt or packed archive).", "path");
+    parser.addOption(vectorTilesOption);
+    QCommandLineOption vectorTileLevelOption("vector-tile-level",
+        "Level of the vector tile set to read (default: its coarsest).", "level", "-1");
+    parser.addOption(vectorTileLevelOption);
+    parser.process(a);
+    
     MainWindow w;
+    
+    bool ok = false;
+    MapProjection::Type projection = MapProjection::typeFromName(parser.value(projectionOption), &ok);
+    if (!ok) {
+        qWarning() << "Unknown projection" << parser.value(projectionOption) << "- using equirectangular";
+    }
+    w.map()->setProjection(projection);
+    if (parser.isSet(vectorTilesOption)) {
+        w.map()->loadVectorTiles(parser.value(vectorTilesOption), parser.value(vectorTileLevelOption).toInt());
+    }
+    if (parser.isSet(choroplethOption)) {
+        w.map()->colorStatesByStationDensity();
+    }
+    if (parser.isSet(rasterOption)) {
+        w.map()->setRasterBaseLayer(parser.value(rasterOption));
+    }
+    
+#ifdef Q_OS_UNIX
+    // kill -USR1 <pid> logs the memory report
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, reportSignalSockets) == 0) {
+        QSocketNotifier *notifier = new QSocketNotifier(reportSignalSockets[1], QSocketNotifier::Read, &a);
+        QObject::connect(notifier, &QSocketNotifier::activated, [&w]() {
+            char byte;
+            ssize_t received = ::read(reportSignalSockets[1], &byte, 1);
+            Q_UNUSED(received);
+            w.map()->dumpMemoryReport();
+        });
+        std::signal(SIGUSR1, reportSignalHandler);
+    }
+#endif
+    
     w.show();
     return a.exec();
 }
@@ -11,6 +11,8 @@ class MainWindow : public QMainWindow
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
+    
+    MapWidget *map() const { return mapWidget; }
 
 private:
     MapWidget *mapWidget;
@@ -0,0 +1,142 @@
+#include "mapprojection.h"
+#include <QtMath>
+#include <cmath>
+#include <algorithm>
+
+static const double EARTH_RADIUS = 6378137.0;         // WGS84 semi-major axis, metres
+static const double DEG = M_PI / 180.0;               // One projected unit in sphere radians
+static const double MERCATOR_MAX_LAT = 85.0511287798; // Square Web Mercator world
+
+// India NSF LCC (EPSG:7755) parameters
+static const double LCC_LAT1 = 12.472944;
+static const double LCC_LAT2 = 35.172806;
+static const double LCC_LAT0 = 24.0;
+static const double LCC_LON0 = 80.0;
+
+MapProjection::MapProjection(Type type)
+    : projectionType(type)
+    , lccN(0.0)
+    , lccF(0.0)
+    , lccRho0(0.0)
+    , lccLambda0(LCC_LON0 * DEG)
+{
+    if (projectionType == LambertConformalConic) {
+        // Spherical two-standard-parallel Lambert; computed once, not per point
+        double phi1 = LCC_LAT1 * DEG, phi2 = LCC_LAT2 * DEG, phi0 = LCC_LAT0 * DEG;
+        lccN = std::log(std::cos(phi1) / std::cos(phi2))
+             / std::log(std::tan(M_PI / 4 + phi2 / 2) / std::tan(M_PI / 4 + phi1 / 2));
+        lccF = std::cos(phi1) * std::pow(std::tan(M_PI / 4 + phi1 / 2), lccN) / lccN;
+        lccRho0 = lccF / std::pow(std::tan(M_PI / 4 + phi0 / 2), lccN);
+    }
+}
+
+QString MapProjection::name() const
+{
+    switch (projectionType) {
+    case WebMercator: return "Web Mercator";
+    case LambertConformalConic: return "Lambert Conformal Conic (India)";
+    case Equirectangular: break;
+    }
+    return "Equirectangular";
+}
+
+MapProjection::Type MapProjection::typeFromName(const QString &name, bool *ok)
+{
+    QString key = name.trimmed().toLower();
+    if (ok) *ok = true;
+    if (key == "mercator" || key == "webmercator") return WebMercator;
+    if (key == "lcc" || key == "lambert") return LambertConformalConic;
+    if (ok && key != "equirectangular") *ok = false;
+    return Equirectangular;
+}
+
+QPointF MapProjection::forward(double lon, double lat) const
+{
+    QPointF point(lon, lat);
+    forward(&point, &point, 1);
+    return point;
+}
+
+QPointF MapProjection::inverse(const QPointF &projected) const
+{
+    QPointF point = projected;
+    inverse(&point, &point, 1);
+    return point;
+}
+
+void MapProjection::forward(const QPointF *geo, QPointF *projected, int count) const
+{
+    // Dispatch once per batch so each loop is a straight-line kernel
+    switch (projectionType) {
+    case Equirectangular:
+        if (geo != projected) {
+            std::copy(geo, geo + count, projected);
+        }
+        break;
+
+    case WebMercator:
+        for (int i = 0; i < count; ++i) {
+            double lat = qBound(-MERCATOR_MAX_LAT, geo[i].y(), MERCATOR_MAX_LAT);
+            double y = std::log(std::tan(M_PI / 4 + lat * DEG / 2)) / DEG;
+            projected[i] = QPointF(geo[i].x(), y);
+        }
+        break;
+
+    case LambertConformalConic:
+        for (int i = 0; i < count; ++i) {
+            double rho = lccF / std::pow(std::tan(M_PI / 4 + geo[i].y() * DEG / 2), lccN);
+            double theta = lccN * (geo[i].x() * DEG - lccLambda0);
+            projected[i] = QPointF(rho * std::sin(theta) / DEG, (lccRho0 - rho * std::cos(theta)) / DEG);
+        }
+        break;
+    }
+}
+
+void MapProjection::inverse(const QPointF *projected, QPointF *geo, int count) const
+{
+    switch (projectionType) {
+    case Equirectangular:
+        if (projected != geo) {
+            std::copy(projected, projected + count, geo);
+        }
+        break;
+
+    case WebMercator:
+        for (int i = 0; i < count; ++i) {
+            double lat = (2 * std::atan(std::exp(projected[i].y() * DEG)) - M_PI / 2) / DEG;
+            geo[i] = QPointF(projected[i].x(), lat);
+        }
+        break;
+
+    case LambertConformalConic:
+        for (int i = 0; i < count; ++i) {
+            double x = projected[i].x() * DEG;
+            double dy = lccRho0 - projected[i].y() * DEG;
+            double rho = std::sqrt(x * x + dy * dy);
+            double theta = std::atan2(x, dy);
+            double lat = 2 * std::atan(std::pow(lccF / rho, 1.0 / lccN)) - M_PI / 2;
+            geo[i] = QPointF((lccLambda0 + theta / lccN) / DEG, lat / DEG);
+        }
+        break;
+    }
+}
+
+double MapProjection::metresPerUnit(double lat) const
+{
+    double phi = qBound(-MERCATOR_MAX_LAT, lat, MERCATOR_MAX_LAT) * DEG;
+    double metresPerDegree = EARTH_RADIUS * DEG;
+
+    switch (projectionType) {
+    case LambertConformalConic: {
+        // Inverse of the point scale factor k = n * rho / cos(phi)
+        double rho = lccF / std::pow(std::tan(M_PI / 4 + phi / 2), lccN);
+        return metresPerDegree * std::cos(phi) / (lccN * rho);
+    }
+    case Equirectangular:
+    case WebMercator:
+        break;
+    }
+
+    // East-west ground distance of one degree of longitude
+    return metresPerDegree * std::cos(phi);
+}
@@ -0,0 +1,52 @@
+#ifndef MAPPROJECTION_H
+#define MAPPROJECTION_H
+
+#include <QPointF>
+#include <QString>
+
+// Map projections. Projected units are scaled so that one unit is about one
+// degree near the projection's true scale, which keeps the widget's zoom
+// values (scale * 100 pixels per unit) and the per-feature min_zoom
+// thresholds meaningful whichever projection is active. Geographic points
+// are QPointF(lon, lat) in degrees; projected points are (east, north).
+class MapProjection
+{
+public:
+    enum Type {
+        Equirectangular,
+        WebMercator,
+        LambertConformalConic // India (EPSG:7755 parameters on a sphere)
+    };
+
+    explicit MapProjection(Type type = Equirectangular);
+
+    Type type() const { return projectionType; }
+    QString name() const;
+
+    // "equirectangular", "mercator" or "lcc"
+    static Type typeFromName(const QString &name, bool *ok = nullptr);
+
+    QPointF forward(double lon, double lat) const;
+    QPointF inverse(const QPointF &projected) const;
+
+    // Batch transforms; in and out may be the same array
+    void forward(const QPointF *geo, QPointF *projected, int count) const;
+    void inverse(const QPointF *projected, QPointF *geo, int count) const;
+
+    // Ground metres covered by one projected unit at the given latitude
+    double metresPerUnit(double lat) const;
+
+    bool operator==(const MapProjection &other) const { return projectionType == other.projectionType; }
+    bool operator!=(const MapProjection &other) const { return projectionType != other.projectionType; }
+
+private:
+    Type projectionType;
+
+    // Precomputed Lambert constants (radians / projected units)
+    double lccN;
+    double lccF;
+    double lccRho0;
+    double lccLambda0;
+};
+
+#endif // MAPPROJECTION_H
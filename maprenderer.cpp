@@ -0,0 +1,673 @@
+#include "maprenderer.h"
+#include "geometrytilestore.h"
+#include "rastertilearchive.h"
+#include "mapstyle.h"
+#include "drawlist.h"
+#include <QRunnable>
+#include <QFontMetrics>
+
+const int MapRenderer::BANDS_PER_THREAD = 2; // Spare bands even out uneven band costs
+const double GUARD_BAND = 256.0; // Pixels kept around the clip rect; wider than any stroke
+const double MESH_MAX_VISIBLE_FRACTION = 0.25; // Below this share of a polygon in view, fill from its mesh
+
+void StateFeature::reproject(const MapProjection &projection)
+{
+    localPolygons.clear();
+    for (const auto &polygon : polygons) {
+        localPolygons.append(LocalPolygon::fromGeo(polygon, projection, true));
+    }
+    localLine = LocalPolygon::fromGeo(QPolygonF(lineString), projection);
+    localLine.strokes = LinePath::fromLocal(localLine);
+}
+
+ViewTransform MapView::transform() const
+{
+    // North up, (centerLon, centerLat) at the widget centre plus pan offset
+    ViewTransform view;
+    view.center = projection.forward(centerLon, centerLat);
+    view.screenCenter = QPointF(size.width() / 2.0 + panOffset.x(), size.height() / 2.0 + panOffset.y());
+    view.pixelsPerUnit = pixelsPerUnit();
+    return view;
+}
+
+QTransform MapView::transformFrom(const MapView &other) const
+{
+    ViewTransform from = other.transform(), to = transform();
+    double zoom = to.pixelsPerUnit / from.pixelsPerUnit;
+    QPointF origin = to.map(from.unmap(QPointF(0, 0)));
+    return QTransform(zoom, 0, 0, zoom, origin.x(), origin.y());
+}
+
+QPointF MapView::geoToScreen(double lat, double lon) const
+{
+    return transform().map(projection.forward(lon, lat));
+}
+
+void MapView::geoToScreen(const QPointF *geo, QPointF *screen, int count) const
+{
+    projection.forward(geo, screen, count);
+
+    ViewTransform view = transform();
+    for (int i = 0; i < count; ++i) {
+        screen[i] = view.map(screen[i]);
+    }
+}
+
+void MapView::screenToGeo(const QPointF &screen, double &lat, double &lon) const
+{
+    QPointF geo = projection.inverse(transform().unmap(screen));
+    lon = geo.x();
+    lat = geo.y();
+}
+
+QRectF MapView::geoBounds(const QRectF &screen) const
+{
+    const int STEPS = 8;
+    const int COUNT = 4 * (STEPS + 1);
+    ViewTransform view = transform();
+    QPointF edge[COUNT]; // Called per band and frame; no heap
+    for (int i = 0; i <= STEPS; ++i) {
+        double t = double(i) / STEPS;
+        edge[4 * i] = QPointF(screen.left() + t * screen.width(), screen.top());
+        edge[4 * i + 1] = QPointF(screen.left() + t * screen.width(), screen.bottom());
+        edge[4 * i + 2] = QPointF(screen.left(), screen.top() + t * screen.height());
+        edge[4 * i + 3] = QPointF(screen.right(), screen.top() + t * screen.height());
+    }
+    for (QPointF &point : edge) {
+        point = view.unmap(point);
+    }
+    projection.inverse(edge, edge, COUNT);
+
+    double left = edge[0].x(), right = left, top = edge[0].y(), bottom = top;
+    for (const QPointF &point : edge) {
+        left = qMin(left, point.x());
+        right = qMax(right, point.x());
+        top = qMin(top, point.y());
+        bottom = qMax(bottom, point.y());
+    }
+    QRectF bounds(QPointF(left, top), QPointF(right, bottom));
+    return bounds.adjusted(-0.01 * bounds.width(), -0.01 * bounds.height(), 0.01 * bounds.width(), 0.01 * bounds.height());
+}
+
+double MapView::metresPerPixel() const
+{
+    return projection.metresPerUnit(centerLat) / pixelsPerUnit();
+}
+
+namespace {
+
+// Pens and brushes of the station layer; the geometry layers take theirs
+// from the MapStyle. Copies share one instance, so setting them on the
+// painter does not allocate as building them per draw would.
+struct LayerStyles {
+    QBrush markerShadowBrush{ QColor(0, 0, 0, 50) };
+    QPen markerPen{ QColor(255, 87, 34), 2 };           // Deep orange border
+    QBrush markerBrush{ QColor(255, 152, 0) };          // Orange fill
+    QBrush markerDotBrush{ Qt::white };
+    QBrush labelBrush{ QColor(255, 255, 255, 200) };
+    QPen labelBorderPen{ QColor(100, 100, 100), 1 };
+    QPen labelTextPen{ QColor(33, 33, 33) };
+    QFont labelFont;
+
+    LayerStyles()
+    {
+        labelFont.setPointSize(9);
+        labelFont.setBold(true);
+    }
+};
+
+const LayerStyles &layerStyles()
+{
+    static const LayerStyles styles;
+    return styles;
+}
+
+// Screen-space scratch of one band, reused by every polygon and line it
+// draws; the storage comes from the band's frame arena
+struct ScreenBuffers {
+    explicit ScreenBuffers(FrameArena &arena)
+        : points(arena.vector<QPointF>())
+        , clipped(arena.vector<QPointF>())
+        , scratch(arena.vector<QPointF>())
+        , runEnds(arena.vector<int>())
+    {
+    }
+
+    ArenaVector<QPointF> points;  // Mapped polygon or line
+    ArenaVector<QPointF> clipped; // Clipped polygon, or polyline runs
+    ArenaVector<QPointF> scratch;
+    ArenaVector<int> runEnds;
+};
+
+// Maps a rebased polygon to the screen, clipping it to the guard band when it
+// reaches beyond it so the rasterizer never sees far-off coordinates.
+// Returns null when the polygon is entirely outside.
+const ArenaVector<QPointF> *mapToGuardBand(const ViewTransform &view, const LocalPolygon &polygon,
+                                           const QRectF &guard, ScreenBuffers &buffers)
+{
+    QRectF bounds = view.mapRect(polygon.bounds);
+    if (!bounds.intersects(guard)) return nullptr;
+
+    view.mapLocal(polygon, buffers.points);
+    const ArenaVector<QPointF> *screen = &buffers.points;
+    if (!guard.contains(bounds)) {
+        clipPolygonToRect(buffers.points.data(), int(buffers.points.size()), guard, buffers.clipped, buffers.scratch);
+        screen = &buffers.clipped;
+    }
+    return screen->size() > 2 ? screen : nullptr;
+}
+
+// Draws a screen polyline, split into runs where it leaves the guard band
+void drawClippedPolyline(QPainter &painter, const ArenaVector<QPointF> &line, const QRectF &guard,
+                         ScreenBuffers &buffers)
+{
+    clipPolylineToRect(line.data(), int(line.size()), guard, buffers.clipped, buffers.runEnds);
+    int start = 0;
+    for (int end : buffers.runEnds) {
+        painter.drawPolyline(buffers.clipped.data() + start, end - start);
+        start = end;
+    }
+}
+
+// Draws a line from its cached paths with the current pen, which must be
+// cosmetic (the paths are in projected units). A line in the guard band is
+// one drawPath call; one reaching past it has only its chunks in view
+// drawn, and those crossing the guard band are mapped and clipped there.
+void drawLinePath(QPainter &painter, const ViewTransform &view, const LocalPolygon &line,
+                  const QRectF &guard, ScreenBuffers &buffers)
+{
+    const LinePath &strokes = line.strokes;
+    QRectF bounds = view.mapRect(line.bounds);
+    if (strokes.isEmpty() || !bounds.intersects(guard)) return;
+
+    QTransform base = painter.transform();
+    QTransform local = view.localTransform(line) * base;
+    if (guard.contains(bounds)) {
+        painter.setTransform(local);
+        painter.drawPath(strokes.path);
+        painter.setTransform(base);
+        return;
+    }
+
+    for (const LinePath::Chunk &chunk : strokes.chunks) {
+        QRectF chunkBounds = view.mapRect(chunk.bounds);
+        if (!chunkBounds.intersects(guard)) continue;
+        if (guard.contains(chunkBounds)) {
+            painter.setTransform(local);
+            painter.drawPath(chunk.path);
+        } else {
+            painter.setTransform(base);
+            view.mapLocal(line, chunk.first, chunk.count, buffers.points);
+            drawClippedPolyline(painter, buffers.points, guard, buffers);
+        }
+    }
+    painter.setTransform(base);
+}
+
+// Draws a polygon with the current pen and brush. When only a small part of
+// a filled polygon is in view, the fill comes from the visible triangles of
+// its mesh and the outline is clipped as a polyline, so the full outline is
+// never clipped and re-scanned; otherwise one drawPolygon call is cheapest.
+void drawRegion(QPainter &painter, const ViewTransform &view, const LocalPolygon &polygon,
+                const QRectF &clip, const QRectF &guard, ScreenBuffers &buffers)
+{
+    QRectF bounds = view.mapRect(polygon.bounds);
+    if (!bounds.intersects(guard)) return;
+
+    QRectF visible = bounds.intersected(clip);
+    bool mostlyOffscreen = visible.width() * visible.height()
+        < MESH_MAX_VISIBLE_FRACTION * bounds.width() * bounds.height();
+    if (polygon.mesh.isEmpty() || painter.brush().style() == Qt::NoBrush || !mostlyOffscreen) {
+        if (const ArenaVector<QPointF> *screen = mapToGuardBand(view, polygon, guard, buffers)) {
+            painter.drawPolygon(screen->data(), int(screen->size()));
+        }
+        return;
+    }
+
+    // Aliased triangles tile exactly; antialiased ones would blend twice
+    // along shared edges. The antialiased outline covers the border.
+    QPen pen = painter.pen();
+    bool antialiased = painter.testRenderHint(QPainter::Antialiasing);
+    painter.setPen(Qt::NoPen);
+    painter.setRenderHint(QPainter::Antialiasing, false);
+    polygon.mesh.fill(painter, polygon.points, view.map(polygon.origin), view.pixelsPerUnit, clip);
+    painter.setRenderHint(QPainter::Antialiasing, antialiased);
+    painter.setPen(pen);
+
+    view.mapLocal(polygon, buffers.points);
+    buffers.points.push_back(buffers.points.front());
+    drawClippedPolyline(painter, buffers.points, guard, buffers);
+}
+
+// Paints one horizontal band of the frame into its own QImage, which wraps
+// the band's scanlines inside the shared frame buffer. Scratch geometry
+// comes from the band's arena.
+class BandRenderTask : public QRunnable
+{
+public:
+    BandRenderTask(const MapScene &scene, uchar *bits, int bytesPerLine, QImage::Format format, const QRect &band,
+                   FrameArena &arena)
+        : scene(scene), bits(bits), bytesPerLine(bytesPerLine), format(format), band(band), arena(arena)
+    {
+    }
+
+    void run() override
+    {
+        QImage target(bits, band.width(), band.height(), bytesPerLine, format);
+        target.fill(Qt::white);
+
+        // The band is in device pixels, the layers are drawn in view pixels
+        double ratio = scene.view.devicePixelRatio;
+        QRect clip = QRectF(QPointF(band.topLeft()) / ratio, QSizeF(band.size()) / ratio).toAlignedRect();
+        QPainter painter(&target);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.translate(0, -band.top());
+        painter.scale(ratio, ratio);
+        MapRenderer::drawStaticLayers(painter, scene, clip, arena);
+    }
+
+private:
+    const MapScene &scene;
+    uchar *bits;
+    int bytesPerLine;
+    QImage::Format format;
+    QRect band;
+    FrameArena &arena;
+};
+
+const MapStyle &sceneStyle(const MapScene &scene)
+{
+    return scene.style ? *scene.style : MapStyle::defaultStyle();
+}
+
+bool zoomShows(const MapScene &scene, double minZoom)
+{
+    return minZoom <= 0 || scene.view.scale >= minZoom;
+}
+
+// Paints at the scene's zoom. Their pens are cosmetic, so widths count
+// device pixels: on a high-DPI frame they are widened to keep their size.
+MapStyle::Paints scenePaints(const MapScene &scene)
+{
+    MapStyle::Paints paints = sceneStyle(scene).paintsAt(scene.view.scale);
+    double ratio = scene.view.devicePixelRatio;
+    if (ratio != 1) {
+        for (MapStyle::Paint &paint : paints) paint.pen.setWidthF(paint.pen.widthF() * ratio);
+    }
+    return paints;
+}
+
+// Whether the feature has a rule, and both allow the current zoom
+bool featureShown(const MapScene &scene, const StateFeature &feature, const MapStyle::Paints &paints)
+{
+    if (feature.style < 0 || feature.style >= paints.size()) return false;
+    return zoomShows(scene, qMax(feature.minZoom, paints[feature.style].minZoom));
+}
+
+template <typename T>
+struct Styled {
+    int style;
+    T item;
+};
+
+// Stable counting sort by style id: styles come out in rule order (bottom
+// to top) and items keep their order within a style
+template <typename T>
+void sortByStyle(ArenaVector<Styled<T>> &items, int styleCount, FrameArena &arena)
+{
+    ArenaVector<int> starts = arena.vector<int>();
+    starts.assign(styleCount + 1, 0);
+    for (const auto &entry : items) ++starts[entry.style + 1];
+    for (int style = 0; style < styleCount; ++style) starts[style + 1] += starts[style];
+
+    ArenaVector<Styled<T>> sorted = arena.vector<Styled<T>>();
+    sorted.resize(items.size());
+    for (const auto &entry : items) sorted[starts[entry.style]++] = entry;
+    items.swap(sorted);
+}
+
+} // namespace
+
+MapRenderer::MapRenderer(int threadCount)
+    : threads(1)
+    , taskArena(4096)
+{
+    setThreadCount(threadCount);
+}
+
+MapRenderer::~MapRenderer()
+{
+    pool.waitForDone();
+    qDeleteAll(bandArenas);
+}
+
+void MapRenderer::setThreadCount(int count)
+{
+    threads = qMax(1, count);
+    pool.setMaxThreadCount(threads);
+}
+
+QImage MapRenderer::renderStaticLayers(const MapScene &scene)
+{
+    QImage frame(scene.view.size * scene.view.devicePixelRatio, QImage::Format_ARGB32_Premultiplied);
+    if (frame.isNull()) return frame;
+    frame.setDevicePixelRatio(scene.view.devicePixelRatio);
+
+    int bandCount = threads > 1 ? qMin(threads * BANDS_PER_THREAD, frame.height()) : 1;
+    int bandHeight = (frame.height() + bandCount - 1) / bandCount;
+
+    // Last frame's scratch is released all at once
+    while (bandArenas.size() < bandCount) {
+        bandArenas.append(new FrameArena);
+    }
+    for (FrameArena *arena : bandArenas) {
+        arena->reset();
+    }
+    taskArena.reset();
+
+    if (bandCount == 1) {
+        BandRenderTask(scene, frame.bits(), frame.bytesPerLine(), frame.format(), frame.rect(), *bandArenas[0]).run();
+        return frame;
+    }
+
+    // The tasks themselves live in the frame arena too; the pool must not delete them
+    ArenaVector<BandRenderTask *> tasks = taskArena.vector<BandRenderTask *>();
+    for (int top = 0, index = 0; top < frame.height(); top += bandHeight, ++index) {
+        QRect band(0, top, frame.width(), qMin(bandHeight, frame.height() - top));
+        BandRenderTask *task = taskArena.create<BandRenderTask>(scene, frame.scanLine(top), frame.bytesPerLine(),
+                                                                frame.format(), band, *bandArenas[index]);
+        task->setAutoDelete(false);
+        tasks.push_back(task);
+        pool.start(task);
+    }
+    pool.waitForDone();
+    for (BandRenderTask *task : tasks) {
+        task->~BandRenderTask();
+    }
+
+    return frame;
+}
+
+MapRenderer::FrameStats MapRenderer::frameStats() const
+{
+    FrameStats stats;
+    for (const FrameArena *arena : bandArenas) {
+        stats.arenaBytes += qint64(arena->bytesUsed());
+        stats.arenaCapacity += qint64(arena->capacity());
+        stats.arenaAllocations += arena->allocations();
+        stats.heapAllocations += arena->heapBlocks();
+    }
+    stats.arenaBytes += qint64(taskArena.bytesUsed());
+    stats.arenaCapacity += qint64(taskArena.capacity());
+    stats.arenaAllocations += taskArena.allocations();
+    stats.heapAllocations += taskArena.heapBlocks();
+    return stats;
+}
+
+void MapRenderer::drawStaticLayers(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena)
+{
+    // Pre-rendered tiles carry no choropleth, and only suit their projection
+    const RasterTileArchive *raster = scene.rasterTiles;
+    if (raster && raster->isOpen() && raster->projection() == scene.view.projection.type() && scene.stateFills.isEmpty()) {
+        // Areas the archive does not cover are drawn as vectors
+        QRegion missing = drawRasterTiles(painter, scene, clip);
+        for (const QRect &rect : missing) {
+            painter.save();
+            painter.setClipRect(rect);
+            drawVectorLayers(painter, scene, rect, arena);
+            painter.restore();
+        }
+        return;
+    }
+    drawVectorLayers(painter, scene, clip, arena);
+}
+
+QRegion MapRenderer::drawRasterTiles(QPainter &painter, const MapScene &scene, const QRect &clip)
+{
+    const RasterTileArchive *raster = scene.rasterTiles;
+    ViewTransform view = scene.view.transform();
+    // Chosen by device pixels, so a high-DPI screen gets the sharper level
+    int level = raster->levelFor(view.pixelsPerUnit * scene.view.devicePixelRatio);
+    if (level < 0) return QRegion(clip);
+
+    QRegion missing(clip);
+    QRect range = RasterTileArchive::tileRange(view.unmapRect(clip), level);
+    painter.save();
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    for (int y = range.top(); y <= range.bottom(); ++y) {
+        for (int x = range.left(); x <= range.right(); ++x) {
+            // Edges rounded to whole pixels, so neighbouring tiles meet without seams
+            QRectF mapped = view.mapRect(RasterTileArchive::tileRect(level, x, y));
+            QRect target(QPoint(qRound(mapped.left()), qRound(mapped.top())),
+                         QPoint(qRound(mapped.right()) - 1, qRound(mapped.bottom()) - 1));
+            if (!target.intersects(clip)) continue;
+
+            QImage image = raster->tile(level, x, y);
+            if (image.isNull()) continue;
+            painter.drawImage(target, image);
+            missing -= target;
+        }
+    }
+    painter.restore();
+    return missing;
+}
+
+void MapRenderer::drawVectorLayers(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena)
+{
+    if (scene.tileStore && scene.tileStore->isOpen()) {
+        // Boundary and states from the tiles this band can see
+        drawStreamedGeometry(painter, scene, clip, arena);
+    } else {
+        // Draw India boundary
+        drawIndiaBoundary(painter, scene, clip, arena);
+
+        // Draw state boundaries
+        drawStateBoundaries(painter, scene, clip, arena);
+    }
+
+    // Draw railway tracks connecting stations
+    drawRailwayTrack(painter, scene, clip, arena);
+
+    // Draw stations
+    drawStations(painter, scene, clip, arena);
+}
+
+void MapRenderer::drawIndiaBoundary(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena)
+{
+    const MapStyle &style = sceneStyle(scene);
+    int id = style.boundaryStyle();
+    const MapStyle::Paints paints = scenePaints(scene);
+    if (id < 0 || !zoomShows(scene, paints[id].minZoom)) return;
+    painter.setPen(paints[id].pen);
+    painter.setBrush(paints[id].brush);
+
+    ViewTransform view = scene.view.transform();
+    QRectF guard = QRectF(clip).adjusted(-GUARD_BAND, -GUARD_BAND, GUARD_BAND, GUARD_BAND);
+    ScreenBuffers buffers(arena);
+    for (const auto &polygon : scene.indiaBoundary) {
+        drawRegion(painter, view, polygon, clip, guard, buffers);
+    }
+}
+
+void MapRenderer::drawStateBoundaries(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena)
+{
+    const MapStyle::Paints paints = scenePaints(scene);
+    ViewTransform view = scene.view.transform();
+    QRectF guard = QRectF(clip).adjusted(-GUARD_BAND, -GUARD_BAND, GUARD_BAND, GUARD_BAND);
+    ScreenBuffers buffers(arena);
+
+    // Grouped by style, the pen changes once per rule rather than per feature
+    ArenaVector<Styled<int>> features = arena.vector<Styled<int>>();
+    for (int f = 0; f < scene.stateBoundaries.size(); ++f) {
+        const StateFeature &feature = scene.stateBoundaries[f];
+        if (featureShown(scene, feature, paints)) features.push_back({ feature.style, f });
+    }
+    sortByStyle(features, paints.size(), arena);
+
+    int current = -1;
+    for (const auto &entry : features) {
+        const StateFeature &feature = scene.stateBoundaries[entry.item];
+        const MapStyle::Paint &paint = paints[entry.style];
+        if (entry.style != current) {
+            painter.setPen(paint.pen);
+            current = entry.style;
+        }
+
+        // Polygons, filled with the choropleth colour where there is one
+        if (!feature.localPolygons.isEmpty()) {
+            int f = entry.item;
+            if (f < scene.stateFills.size() && scene.stateFills[f].isValid()) {
+                painter.setBrush(scene.stateFills[f]);
+            } else {
+                painter.setBrush(paint.brush);
+            }
+            if (feature.outlined) {
+                for (const auto &polygon : feature.localPolygons) {
+                    drawRegion(painter, view, polygon, clip, guard, buffers);
+                }
+            } else if (painter.brush().style() != Qt::NoBrush) {
+                // Pieces cut at tile edges: aliased, so neighbours meet
+                // without a blended seam; their outlines are lines of their own
+                bool antialiased = painter.testRenderHint(QPainter::Antialiasing);
+                painter.setPen(Qt::NoPen);
+                painter.setRenderHint(QPainter::Antialiasing, false);
+                for (const auto &polygon : feature.localPolygons) {
+                    drawRegion(painter, view, polygon, clip, guard, buffers);
+                }
+                painter.setRenderHint(QPainter::Antialiasing, antialiased);
+                painter.setPen(paint.pen);
+            }
+        }
+
+        // LineString (river or railway path)
+        if (!feature.localLine.strokes.isEmpty()) {
+            painter.setBrush(Qt::NoBrush);
+            drawLinePath(painter, view, feature.localLine, guard, buffers);
+        }
+    }
+}
+
+void MapRenderer::drawStreamedGeometry(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena)
+{
+    const MapStyle &style = sceneStyle(scene);
+    const MapStyle::Paints paints = scenePaints(scene);
+    ViewTransform view = scene.view.transform();
+    QRectF guard = QRectF(clip).adjusted(-GUARD_BAND, -GUARD_BAND, GUARD_BAND, GUARD_BAND);
+    GeometryTileStore *store = scene.tileStore;
+    QRectF reach = QRectF(clip).adjusted(-2, -2, 2, 2); // Strokes from tiles just outside still show
+    ArenaVector<GeometryTileStore::TilePointer> tiles = arena.vector<GeometryTileStore::TilePointer>();
+    // Detail for device pixels, as for the raster tiles
+    int level = store->levelFor(view.pixelsPerUnit * scene.view.devicePixelRatio);
+    store->tilesFor(scene.view.geoBounds(reach), level, scene.view.projection, tiles);
+
+    // Parts of every tile in view, grouped by the style of their feature
+    // (or of the boundary)
+    int boundaryStyle = style.boundaryStyle();
+    bool boundaryShown = boundaryStyle >= 0 && zoomShows(scene, paints[boundaryStyle].minZoom);
+    ArenaVector<Styled<const GeometryTileStore::Part *>> parts = arena.vector<Styled<const GeometryTileStore::Part *>>();
+    for (const auto &tile : tiles) {
+        for (const auto &part : tile->parts) {
+            if (part.feature < 0) {
+                if (boundaryShown) parts.push_back({ boundaryStyle, &part });
+            } else if (part.feature < scene.stateBoundaries.size()) {
+                const StateFeature &feature = scene.stateBoundaries[part.feature];
+                if (featureShown(scene, feature, paints)) parts.push_back({ feature.style, &part });
+            }
+        }
+    }
+    sortByStyle(parts, paints.size(), arena);
+
+    // Within each style fills go under outlines. Fills are clipped to their
+    // tiles and meet exactly at tile edges, so they are drawn aliased
+    // (antialiasing would show the seams); the antialiased outlines cover
+    // their borders.
+    ScreenBuffers buffers(arena);
+    for (size_t begin = 0, end = 0; begin < parts.size(); begin = end) {
+        int id = parts[begin].style;
+        while (end < parts.size() && parts[end].style == id) ++end;
+        const MapStyle::Paint &paint = paints[id];
+
+        painter.setPen(Qt::NoPen);
+        painter.setRenderHint(QPainter::Antialiasing, false);
+        for (size_t i = begin; i < end; ++i) {
+            const GeometryTileStore::Part &part = *parts[i].item;
+            if (part.fills.isEmpty()) continue;
+            if (part.feature >= 0 && part.feature < scene.stateFills.size() && scene.stateFills[part.feature].isValid()) {
+                painter.setBrush(scene.stateFills[part.feature]);
+            } else if (paint.brush.style() != Qt::NoBrush) {
+                painter.setBrush(paint.brush);
+            } else {
+                continue;
+            }
+            for (const auto &fill : part.fills) {
+                drawRegion(painter, view, fill, clip, guard, buffers);
+            }
+        }
+        painter.setRenderHint(QPainter::Antialiasing, true);
+
+        painter.setPen(paint.pen);
+        painter.setBrush(Qt::NoBrush);
+        for (size_t i = begin; i < end; ++i) {
+            for (const auto &line : parts[i].item->lines) {
+                QRectF bounds = view.mapRect(line.bounds);
+                if (line.points.size() < 2 || !bounds.intersects(guard)) continue;
+                view.mapLocal(line, buffers.points);
+                if (guard.contains(bounds)) {
+                    painter.drawPolyline(buffers.points.data(), int(buffers.points.size()));
+                } else {
+                    drawClippedPolyline(painter, buffers.points, guard, buffers);
+                }
+            }
+        }
+    }
+}
+
+void MapRenderer::drawRailwayTrack(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena)
+{
+    if (!scene.trackCache) return;
+
+    // Sleepers, ballast and rails come from cached per-layer paths
+    scene.trackCache->draw(painter, scene.view.transform(), clip, arena);
+}
+
+void MapRenderer::drawStations(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena)
+{
+    // Draw stations with modern styling
+    const LayerStyles &styles = layerStyles();
+    bool showLabels = scene.view.scale > 1.5;
+    if (showLabels) {
+        painter.setFont(styles.labelFont);
+    }
+    QFontMetrics fm(styles.labelFont);
+
+    // Every part of every station is recorded, then drawn part by part:
+    // shadows, markers, dots, label backgrounds and label texts, bottom to top
+    DrawList list(arena);
+    int shadowStyle = list.addStyle(Qt::NoPen, styles.markerShadowBrush);
+    int markerStyle = list.addStyle(styles.markerPen, styles.markerBrush);
+    int dotStyle = list.addStyle(Qt::NoPen, styles.markerDotBrush);
+    int labelStyle = list.addStyle(styles.labelBorderPen, styles.labelBrush);
+    int textStyle = list.addStyle(styles.labelTextPen);
+
+    // Labels hang off to the right of the marker
+    QRectF cullRect = QRectF(clip).adjusted(showLabels ? -400 : -10, -20, 10, 20);
+
+    ViewTransform view = scene.view.transform();
+    for (const auto &station : scene.stations) {
+        QPointF screenPos = view.map(scene.view.projection.forward(station.lon, station.lat));
+        if (!cullRect.contains(screenPos)) continue;
+
+        list.addEllipse(shadowStyle, screenPos + QPointF(1, 1), 8, 8);
+        list.addEllipse(markerStyle, screenPos, 8, 8);
+        list.addEllipse(dotStyle, screenPos, 3, 3);
+
+        // Station name with background (only if zoom level is high enough)
+        if (showLabels) {
+            QRect textRect = fm.boundingRect(station.name);
+            QPointF textPos = screenPos + QPointF(12, -8);
+            list.addRoundedRect(labelStyle, textRect.translated(textPos.toPoint()).adjusted(-2, -1, 2, 1), 3);
+            list.addText(textStyle, textPos, station.name);
+        }
+    }
+    list.flush(painter);
+}
@@ -0,0 +1,153 @@
+#ifndef MAPRENDERER_H
+#define MAPRENDERER_H
+
+#include <QVector>
+#include <QString>
+#include <QPointF>
+#include <QPolygonF>
+#include <QSize>
+#include <QRect>
+#include <QImage>
+#include <QRegion>
+#include <QPainter>
+#include <QThread>
+#include <QThreadPool>
+#include <QTransform>
+#include <QColor>
+#include "trackgeometrycache.h"
+#include "mapprojection.h"
+#include "localgeometry.h"
+
+class GeometryTileStore;
+class RasterTileArchive;
+class MapStyle;
+
+struct Station {
+    int id; // Position in the source file; stable when stations are reordered
+    QString name;
+    double lat;
+    double lon;
+    QPointF screenPos;
+};
+
+struct StateFeature {
+    QString name;
+    QString type; // "state_border", "river" or "railway"
+    double minZoom; // Minimum zoom level to display (0 = always show)
+    int style = -1; // Rule id from MapStyle::compile(); -1 = not drawn
+    QVector<QPolygonF> polygons; // For Polygon/MultiPolygon
+    QVector<QPointF> lineString; // For LineString (rivers, railways)
+    bool outlined = true; // False when line features of their own draw the outline (tile-clipped polygons)
+    
+    // Projected, origin-rebased copies used for rendering
+    QVector<LocalPolygon> localPolygons;
+    LocalPolygon localLine;
+    void reproject(const MapProjection &projection);
+};
+
+// View parameters; two equal views produce identical static layers
+struct MapView {
+    double centerLat = 23.0;
+    double centerLon = 78.0;
+    double scale = 1.0;
+    QPointF panOffset;
+    QSize size;
+    MapProjection projection;
+    // Device pixels per pixel of size: frames are rendered at size × ratio
+    // for the screen the widget is on, and drawn back at size
+    double devicePixelRatio = 1.0;
+
+    QPointF geoToScreen(double lat, double lon) const;
+    void screenToGeo(const QPointF &screen, double &lat, double &lon) const;
+
+    // Batch form; geo points are (lon, lat), in and out may alias
+    void geoToScreen(const QPointF *geo, QPointF *screen, int count) const;
+
+    // Lon/lat bounding box of a screen rectangle; its edges are sampled
+    // because projected meridians and parallels can curve
+    QRectF geoBounds(const QRectF &screen) const;
+
+    // Camera-relative projected units -> screen pixels
+    ViewTransform transform() const;
+    
+    // Screen-space mapping of an image rendered for other onto this view
+    // (same projection assumed)
+    QTransform transformFrom(const MapView &other) const;
+    double pixelsPerUnit() const { return scale * 100; }
+
+    // Ground distance of one pixel at the view centre
+    double metresPerPixel() const;
+
+    bool operator==(const MapView &other) const
+    {
+        return centerLat == other.centerLat && centerLon == other.centerLon && scale == other.scale
+            && panOffset == other.panOffset && size == other.size && projection == other.projection
+            && devicePixelRatio == other.devicePixelRatio;
+    }
+    bool operator!=(const MapView &other) const { return !(*this == other); }
+};
+
+// Everything the static layers need for one frame. The vectors are
+// implicitly shared with MapWidget, so taking a snapshot is cheap and the
+// renderer can read it from worker threads while the GUI thread waits.
+struct MapScene {
+    QVector<Station> stations;
+    QVector<LocalPolygon> indiaBoundary; // Projected with view.projection
+    QVector<StateFeature> stateBoundaries;
+    QVector<QColor> stateFills; // Optional choropleth fill per stateBoundaries entry
+    TrackGeometryCache *trackCache = nullptr;
+    GeometryTileStore *tileStore = nullptr; // When open, boundary and states are streamed from it
+    const RasterTileArchive *rasterTiles = nullptr; // When open, pre-rendered tiles replace the vector layers
+    const MapStyle *style = nullptr; // The one stateBoundaries were compiled with; null = the default
+    MapView view;
+};
+
+// Rasterizes the static map layers (boundary, states, tracks, stations).
+// The frame is cut into horizontal bands that are painted concurrently by a
+// worker pool straight into disjoint scanlines of one image.
+class MapRenderer
+{
+public:
+    explicit MapRenderer(int threadCount = QThread::idealThreadCount());
+    ~MapRenderer();
+
+    void setThreadCount(int count);
+    int threadCount() const { return threads; }
+
+    // Headless: no widget or window system required. The image has
+    // scene.view.size × devicePixelRatio pixels and that ratio set.
+    QImage renderStaticLayers(const MapScene &scene);
+
+    // Scratch use of the last renderStaticLayers() call, over all bands
+    struct FrameStats {
+        qint64 arenaBytes = 0;    // Taken from the frame arenas
+        qint64 arenaCapacity = 0; // Held by them between frames
+        int arenaAllocations = 0;
+        int heapAllocations = 0; // Arena blocks that had to come from the heap
+    };
+    FrameStats frameStats() const;
+
+    // Draws the static layers, skipping anything outside clip. Scratch
+    // geometry is taken from arena, which the caller resets between frames.
+    // The painter takes view pixels; cosmetic widths are scaled by the
+    // view's device pixel ratio, which the painter is expected to apply.
+    static void drawStaticLayers(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena);
+
+private:
+    static void drawVectorLayers(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena);
+    static QRegion drawRasterTiles(QPainter &painter, const MapScene &scene, const QRect &clip);
+    static void drawIndiaBoundary(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena);
+    static void drawStateBoundaries(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena);
+    static void drawStreamedGeometry(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena);
+    static void drawRailwayTrack(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena);
+    static void drawStations(QPainter &painter, const MapScene &scene, const QRect &clip, FrameArena &arena);
+
+    int threads;
+    QThreadPool pool;
+    QVector<FrameArena *> bandArenas; // Per band, reset every frame
+    FrameArena taskArena;             // This frame's band tasks
+
+    static const int BANDS_PER_THREAD;
+};
+
+#endif // MAPRENDERER_H
@@ -0,0 +1,216 @@
+#include "mapstyle.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QFile>
+#include <QMutexLocker>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+// The layers as they have always looked
+const char *const MapStyle::DEFAULT_SHEET = R"({
+    "rules": [
+        { "layer": "boundary", "stroke": "#2e7d32", "width": 2, "fill": "#78a5d6a7" },
+        { "layer": "features", "type": "state_border", "stroke": "#2196f3", "width": 2 },
+        { "layer": "features", "type": "river", "stroke": "#64b4ff", "width": 2 },
+        { "layer": "features", "type": "railway", "stroke": "#757575", "width": 1.5 },
+        { "layer": "features", "stroke": "#2196f3", "width": 2 }
+    ]
+})";
+
+namespace {
+
+bool readColor(const QJsonValue &value, QColor &color)
+{
+    color = QColor(value.toString());
+    return color.isValid();
+}
+
+bool readNumber(const QJsonValue &value, double &number)
+{
+    number = value.toDouble();
+    return value.isDouble() && number >= 0;
+}
+
+// A constant or {"stops": [[zoom, value], ...]}, sorted by zoom
+template <typename T, typename Read>
+bool readStops(const QJsonValue &value, Read read, QVector<QPair<double, T>> &stops)
+{
+    stops.clear();
+    if (!value.isObject()) {
+        T constant;
+        if (!read(value, constant)) return false;
+        stops.append(qMakePair(0.0, constant));
+        return true;
+    }
+
+    for (const auto &stop : value.toObject().value("stops").toArray()) {
+        QJsonArray pair = stop.toArray();
+        T stopValue;
+        if (pair.size() != 2 || !pair[0].isDouble() || !read(pair[1], stopValue)) return false;
+        stops.append(qMakePair(pair[0].toDouble(), stopValue));
+    }
+    std::stable_sort(stops.begin(), stops.end(), [](const QPair<double, T> &a, const QPair<double, T> &b) {
+        return a.first < b.first;
+    });
+    return !stops.isEmpty();
+}
+
+double mix(double a, double b, double t)
+{
+    return a + (b - a) * t;
+}
+
+QColor mix(const QColor &a, const QColor &b, double t)
+{
+    return QColor::fromRgbF(mix(a.redF(), b.redF(), t), mix(a.greenF(), b.greenF(), t),
+                            mix(a.blueF(), b.blueF(), t), mix(a.alphaF(), b.alphaF(), t));
+}
+
+template <typename T>
+T valueAt(const QVector<QPair<double, T>> &stops, double zoom)
+{
+    if (zoom <= stops.first().first) return stops.first().second;
+    for (int i = 1; i < stops.size(); ++i) {
+        if (zoom < stops[i].first) {
+            double t = (zoom - stops[i - 1].first) / (stops[i].first - stops[i - 1].first);
+            return mix(stops[i - 1].second, stops[i].second, t);
+        }
+    }
+    return stops.last().second;
+}
+
+} // namespace
+
+MapStyle::MapStyle()
+    : boundary(-1)
+    , zoomDependent(false)
+    , cachedZoom(std::numeric_limits<double>::quiet_NaN())
+{
+    QString error;
+    if (!parse(DEFAULT_SHEET, &error)) {
+        qWarning() << "Built-in map style:" << error;
+    }
+}
+
+bool MapStyle::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open map style" << path;
+        return false;
+    }
+    QString error;
+    if (!parse(file.readAll(), &error)) {
+        qWarning() << "Map style" << path << "not used:" << error;
+        return false;
+    }
+    qDebug() << "Map style" << path << "with" << rules.size() << "rules";
+    return true;
+}
+
+bool MapStyle::parse(const QByteArray &json, QString *error)
+{
+    auto fail = [&](const QString &message) {
+        if (error) *error = message;
+        return false;
+    };
+
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(json, &parseError);
+    if (document.isNull()) return fail(parseError.errorString());
+
+    QVector<Rule> parsed;
+    for (const auto &value : document.object().value("rules").toArray()) {
+        const QJsonObject object = value.toObject();
+        int index = parsed.size();
+
+        Rule rule;
+        QString layer = object["layer"].toString();
+        if (layer == "boundary") {
+            rule.layer = BoundaryLayer;
+        } else if (layer == "features") {
+            rule.layer = FeatureLayer;
+        } else {
+            return fail(QString("rule %1: unknown layer \"%2\"").arg(index).arg(layer));
+        }
+        rule.type = object["type"].toString();
+        if (!readStops(object["stroke"], readColor, rule.stroke)) {
+            return fail(QString("rule %1: stroke must be a colour or colour stops").arg(index));
+        }
+        if (!readStops(object.contains("width") ? object["width"] : QJsonValue(1.0), readNumber, rule.width)) {
+            return fail(QString("rule %1: width must be a number or number stops").arg(index));
+        }
+        if (object.contains("fill") && !readColor(object["fill"], rule.fill)) {
+            return fail(QString("rule %1: fill must be a colour").arg(index));
+        }
+        rule.minZoom = object["minZoom"].toDouble(0.0);
+        parsed.append(rule);
+    }
+    if (parsed.isEmpty()) return fail("no rules");
+
+    rules = parsed;
+    boundary = styleFor(BoundaryLayer, QString());
+    zoomDependent = false;
+    for (const Rule &rule : rules) {
+        zoomDependent = zoomDependent || rule.stroke.size() > 1 || rule.width.size() > 1;
+    }
+
+    // Constant sheets resolve here, once
+    constantPaints.clear();
+    if (!zoomDependent) {
+        for (const Rule &rule : rules) constantPaints.append(paintAt(rule, 0));
+    }
+    QMutexLocker locker(&mutex);
+    cachedZoom = std::numeric_limits<double>::quiet_NaN();
+    cachedPaints.clear();
+    return true;
+}
+
+int MapStyle::styleFor(Layer layer, const QString &type) const
+{
+    for (int i = 0; i < rules.size(); ++i) {
+        const Rule &rule = rules[i];
+        if (rule.layer == layer && (rule.type.isEmpty() || rule.type == type)) return i;
+    }
+    return -1;
+}
+
+void MapStyle::compile(QVector<StateFeature> &features) const
+{
+    for (auto &feature : features) {
+        feature.style = styleFor(FeatureLayer, feature.type);
+    }
+}
+
+MapStyle::Paints MapStyle::paintsAt(double zoom) const
+{
+    if (!zoomDependent) return constantPaints;
+
+    QMutexLocker locker(&mutex);
+    if (zoom != cachedZoom) {
+        Paints paints;
+        paints.reserve(rules.size());
+        for (const Rule &rule : rules) paints.append(paintAt(rule, zoom));
+        cachedPaints = paints;
+        cachedZoom = zoom;
+    }
+    return cachedPaints;
+}
+
+MapStyle::Paint MapStyle::paintAt(const Rule &rule, double zoom) const
+{
+    Paint paint;
+    paint.pen = QPen(valueAt(rule.stroke, zoom), valueAt(rule.width, zoom));
+    paint.pen.setCosmetic(true);
+    paint.brush = rule.fill.isValid() ? QBrush(rule.fill) : QBrush(Qt::NoBrush);
+    paint.minZoom = rule.minZoom;
+    return paint;
+}
+
+const MapStyle &MapStyle::defaultStyle()
+{
+    static const MapStyle style;
+    return style;
+}
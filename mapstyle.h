@@ -0,0 +1,88 @@
+#ifndef MAPSTYLE_H
+#define MAPSTYLE_H
+
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+#include <QColor>
+#include <QPen>
+#include <QBrush>
+#include <QPair>
+#include <QMutex>
+#include "maprenderer.h"
+
+// Pens, brushes and zoom ranges of the vector layers, from a style sheet.
+//
+// The sheet is JSON: a list of rules, each naming a layer ("boundary" or
+// "features"), optionally a feature type, and its stroke colour, width,
+// fill colour and minimum zoom. Stroke and width are a constant or
+// {"stops": [[zoom, value], ...]}, interpolated linearly between stops and
+// held beyond the ends; zoom is the view scale. A feature takes the first
+// rule of its layer that matches its type (a rule without a type matches
+// any), and rules draw in sheet order, so they are listed bottom to top.
+//
+// compile() turns each feature's type into the id of its rule once, at load
+// time; rendering looks paints up by id and never compares strings.
+class MapStyle
+{
+public:
+    enum Layer { BoundaryLayer, FeatureLayer };
+
+    // What a rule draws with at one zoom. Pens are cosmetic: line paths are
+    // stroked in projected units, and widths stay in pixels.
+    struct Paint {
+        QPen pen;
+        QBrush brush;   // Qt::NoBrush when the rule has no fill
+        double minZoom; // 0 = always shown
+    };
+    typedef QVector<Paint> Paints; // Indexed by style id
+
+    MapStyle(); // The built-in sheet
+
+    // Replaces the rules; on error the current ones are kept
+    bool load(const QString &path);
+    bool parse(const QByteArray &json, QString *error = nullptr);
+
+    int count() const { return rules.size(); }
+
+    // Id of the rule drawing a feature of type in layer, or -1 (not drawn)
+    int styleFor(Layer layer, const QString &type) const;
+    int boundaryStyle() const { return boundary; }
+
+    // Sets every feature's style id. Ids index this style's rules, so
+    // features are compiled again whenever the sheet changes.
+    void compile(QVector<StateFeature> &features) const;
+
+    // Paints at a zoom, one per style id. Thread-safe; zoom-dependent
+    // rules are resolved once per zoom, constant ones once per sheet.
+    Paints paintsAt(double zoom) const;
+
+    static const MapStyle &defaultStyle();
+    static const char *const DEFAULT_SHEET;
+
+private:
+    MapStyle(const MapStyle &) = delete;
+    MapStyle &operator=(const MapStyle &) = delete;
+
+    struct Rule {
+        Layer layer;
+        QString type; // Empty matches any type
+        QVector<QPair<double, QColor>> stroke; // Zoom stops
+        QVector<QPair<double, double>> width;
+        QColor fill; // Invalid: no fill
+        double minZoom;
+    };
+
+    Paint paintAt(const Rule &rule, double zoom) const;
+
+    QVector<Rule> rules;
+    int boundary; // Rule drawing the boundary layer, or -1
+    bool zoomDependent;
+    Paints constantPaints; // All paints when no rule has more than one stop
+
+    mutable QMutex mutex; // Guards the zoom-dependent cache
+    mutable double cachedZoom;
+    mutable Paints cachedPaints;
+};
+
+#endif // MAPSTYLE_H
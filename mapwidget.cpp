@@ -1,18 +1,32 @@
 #include "mapwidget.h"
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
-#include <QFile>
+#include "spatialorder.h"
+#include "geojsonloader.h"
 #include <QDebug>
+#include <QFileInfo>
 #include <QPainterPath>
 #include <QFontMetrics>
 #include <cmath>
+#include <algorithm>
 
 const double MapWidget::MIN_SCALE = 0.5;
 const double MapWidget::MAX_SCALE = 2600.0; // Allow zooming to ~10 meter level (150x zoom)
+const int MapWidget::PREFETCH_MARGIN = 384;        // Pixels rendered beyond each widget edge
+const int MapWidget::FRAME_CACHE_KILOBYTES = 128 * 1024; // A few frames at 1x and 2x
+const int MapWidget::PREFETCH_LOOKAHEAD_MS = 250;  // How far ahead the pan predictor looks
+const int MapWidget::KINETIC_DURATION_MS = 700;
+const double MapWidget::MIN_FLICK_SPEED = 0.3;     // Pixels per ms at release to start coasting
+
+static const char GEOMETRY_STORE_PATH[] = "geometry.store";
+static const char MAP_STYLE_PATH[] = "mapstyle.json"; // Optional; the built-in style otherwise
 
 MapWidget::MapWidget(QWidget *parent)
     : QWidget(parent)
+    , staticLayersDirty(true)
+    , staticLayersRequest(0)
+    , layersGeneration(0)
+    , frameCache(FRAME_CACHE_KILOBYTES)
+    , requestedGeneration(-1)
+    , memoryOverlayVisible(false)
     , centerLat(23.0)
     , centerLon(78.0)
     , scale(1.0)
@@ -26,8 +40,11 @@ MapWidget::MapWidget(QWidget *parent)
     , trainMoving(false)
     , trainPosition(0.0)
     , cameraFollowTrain(true)
-    , zoomAnimation(nullptr)
-    , panAnimation(nullptr)
+    , animationTimer(nullptr)
+    , animationDuration(0)
+    , animationFromScale(1.0)
+    , animationToScale(1.0)
+    , animationAnchored(false)
 {
     setMouseTracking(true);
     setFocusPolicy(Qt::StrongFocus);
@@ -37,246 +54,308 @@ MapWidget::MapWidget(QWidget *parent)
     setStyleSheet("MapWidget { background-color: white; border: none; margin: 0px; padding: 0px; }");
     
     // Initialize zoom control rectangles
-    zoomInRect = QRect(0, 0, 30, 30);
-    zoomOutRect = QRect(0, 35, 30, 30);
+    layoutControls();
     
     // Initialize train timer
     trainTimer = new QTimer(this);
     connect(trainTimer, &QTimer::timeout, this, &MapWidget::updateTrainPosition);
     
+    // Finished frames are shown by the next paint
+    connect(&renderThread, &RenderThread::frameReady, this, [this]() { update(); });
+    
+    // Camera animation ticks; the same timer serves every zoom and coast
+    animationTimer = new QTimer(this);
+    animationTimer->setInterval(16);
+    connect(animationTimer, &QTimer::timeout, this, &MapWidget::updateAnimation);
+    
     // Create drawer widget and UI components BEFORE loading stations
     setupDrawerUI();
     
-    // Now load data
+    if (QFileInfo::exists(MAP_STYLE_PATH)) {
+        mapStyle.load(MAP_STYLE_PATH);
+    }
+    
+    // Now load data. Boundary, states and railway lines come from the
+    // feature store when it matches the GeoJSON; otherwise the GeoJSON is
+    // parsed and tiled once.
     loadStations();
-    loadIndiaBoundary();
-    loadStateBoundaries();
+    if (!openGeometryStore()) {
+        loadIndiaBoundary();
+        loadStateBoundaries();
+        loadRailwayLines();
+        buildGeometryStore();
+    }
 }
 
 void MapWidget::loadStations(const QString &filename)
 {
-    stations.clear();
-    
-    // Try to load from specified JSON file
-    QFile file(filename);
-    if (!file.open(QIODevice::ReadOnly)) {
-        qWarning() << "Could not open" << filename << "file";
-        return;
+    stations = GeoJsonLoader::loadStations(filename);
+    stationSlots.clear();
+    if (stations.isEmpty()) {
+        qWarning() << "No stations loaded from" << filename;
     }
+    qDebug() << "Loaded" << stations.size() << "stations from" << filename;
     
-    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-    file.close();
-    
-    QJsonObject root = doc.object();
+    orderStationsSpatially();
+    reprojectGeometry();
+    geocoder.setStations(stations);
+    invalidateStaticLayers();
     
-    // Check if it's zone-based format
-    if (root.contains("zones")) {
-        QJsonObject zones = root["zones"].toObject();
-        
-        // Iterate through each zone
-        for (auto zoneIt = zones.begin(); zoneIt != zones.end(); ++zoneIt) {
-            QJsonObject zoneObj = zoneIt.value().toObject();
-            
-            if (zoneObj.contains("features")) {
-                QJsonArray features = zoneObj["features"].toArray();
-                
-                for (const auto &feature : features) {
-                    QJsonObject featureObj = feature.toObject();
-                    QJsonObject properties = featureObj["properties"].toObject();
-                    QJsonObject geometry = featureObj["geometry"].toObject();
-                    
-                    if (geometry["type"].toString() == "Point") {
-                        QJsonArray coordinates = geometry["coordinates"].toArray();
-                        
-                        if (coordinates.size() >= 2) {
-                            Station station;
-                            station.name = properties["name"].toString();
-                            QString code = properties["code"].toString();
-                            if (!code.isEmpty()) {
-                                station.name += " (" + code + ")";
-                            }
-                            station.lon = coordinates[0].toDouble();
-                            station.lat = coordinates[1].toDouble();
-                            stations.append(station);
-                        }
-                    }
-                }
-            }
-        }
-    }
-    // Fallback to old GeoJSON format
-    else if (root.contains("features")) {
-        QJsonArray features = root["features"].toArray();
-        
-        for (const auto &feature : features) {
-            QJsonObject featureObj = feature.toObject();
-            QJsonObject properties = featureObj["properties"].toObject();
-            QJsonObject geometry = featureObj["geometry"].toObject();
-            
-            if (geometry["type"].toString() == "Point") {
-                QJsonArray coordinates = geometry["coordinates"].toArray();
-                
-                if (coordinates.size() >= 2) {
-                    Station station;
-                    station.name = properties["name"].toString();
-                    station.lon = coordinates[0].toDouble();
-                    station.lat = coordinates[1].toDouble();
-                    stations.append(station);
-                }
-            }
-        }
-    }
-    
-    qDebug() << "Loaded" << stations.size() << "stations from" << filename;
     updateStationPositions();
     updateStationComboBoxes();
 }
 
-void MapWidget::loadIndiaBoundary()
+void MapWidget::orderStationsSpatially()
 {
-    // Try to load from file
-    QFile file("india_boundary_detailed.geojson");
-    if (file.open(QIODevice::ReadOnly)) {
-        QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-        QJsonObject root = doc.object();
-        
-        if (root.contains("features")) {
-            QJsonArray features = root["features"].toArray();
-            for (const auto &feature : features) {
-                QJsonObject featureObj = feature.toObject();
-                QJsonObject geometry = featureObj["geometry"].toObject();
-                
-                if (geometry["type"].toString() == "Polygon") {
-                    QJsonArray coordinates = geometry["coordinates"].toArray();
-                    if (!coordinates.isEmpty()) {
-                        QJsonArray ring = coordinates[0].toArray();
-                        QPolygonF polygon;
-                        
-                        for (const auto &coord : ring) {
-                            QJsonArray point = coord.toArray();
-                            if (point.size() >= 2) {
-                                double lon = point[0].toDouble();
-                                double lat = point[1].toDouble();
-                                polygon << QPointF(lon, lat);
-                            }
-                        }
-                        indiaBoundary.append(polygon);
-                    }
-                }
-            }
-        }
+    // Culling, hit-testing and projection loops run over the stations in
+    // storage order; along a Hilbert curve the stations in one viewport sit
+    // together in memory. Ids keep the file order for the track and the
+    // trip planner.
+    QVector<QPointF> points;
+    points.reserve(stations.size());
+    for (const auto &station : stations) {
+        points.append(QPointF(station.lon, station.lat));
     }
     
+    QVector<Station> ordered;
+    ordered.reserve(stations.size());
+    stationSlots.resize(stations.size());
+    for (int index : SpatialOrder::hilbertOrder(points)) {
+        stationSlots[stations[index].id] = ordered.size();
+        ordered.append(stations[index]);
+    }
+    stations = ordered;
+}
+
+void MapWidget::loadIndiaBoundary()
+{
+    indiaBoundary += GeoJsonLoader::loadBoundary("india_boundary_detailed.geojson");
+    
+    reprojectGeometry();
+    invalidateStaticLayers();
     fitMapToView();
 }
 
 void MapWidget::loadStateBoundaries()
 {
-    stateBoundaries.clear();
-    
     // Load state boundaries from states.geojson
-    QFile file("states.geojson");
-    if (!file.open(QIODevice::ReadOnly)) {
-        qDebug() << "Could not open states.geojson";
+    stateBoundaries = GeoJsonLoader::loadStateBoundaries("states.geojson");
+    qDebug() << "Total features loaded:" << stateBoundaries.size();
+    
+    reprojectGeometry();
+    geocoder.setFeatures(stateBoundaries);
+    invalidateStaticLayers();
+}
+
+void MapWidget::loadRailwayLines()
+{
+    // Optional: full shape points of the railway lines. They can be far
+    // larger than the other layers; once tiled into the feature store only
+    // the pages a view needs are read.
+    QVector<StateFeature> lines = GeoJsonLoader::loadRailwayLines("railways.geojson");
+    if (lines.isEmpty()) {
+        qDebug() << "No railways.geojson, railway lines not shown";
         return;
     }
     
-    QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
-    file.close();
+    int points = 0;
+    for (const auto &line : lines) points += line.lineString.size();
+    qDebug() << "Loaded" << lines.size() << "railway lines with" << points << "shape points";
     
-    QJsonObject root = doc.object();
+    stateBoundaries += lines;
+    reprojectGeometry();
+    invalidateStaticLayers();
+}
+
+QString MapWidget::geometrySourceStamp() const
+{
+    return GeoJsonLoader::sourceStamp({ "india_boundary_detailed.geojson", "states.geojson", "railways.geojson" });
+}
+
+bool MapWidget::openGeometryStore()
+{
+    // Snapshots being rendered read the store
+    renderThread.waitForIdle();
+    if (!geometryStore.open(GEOMETRY_STORE_PATH) || geometryStore.sourceStamp() != geometrySourceStamp()) {
+        geometryStore.close();
+        return false;
+    }
     
-    if (root.contains("features")) {
-        QJsonArray features = root["features"].toArray();
-        
-        for (const auto &feature : features) {
-            QJsonObject featureObj = feature.toObject();
-            QJsonObject properties = featureObj["properties"].toObject();
-            QJsonObject geometry = featureObj["geometry"].toObject();
-            
-            StateFeature stateFeature;
-            stateFeature.name = properties["name"].toString();
-            stateFeature.type = properties["type"].toString();
-            stateFeature.minZoom = properties["min_zoom"].toDouble(0.0); // Default 0 = always show
-            
-            qDebug() << "Loading feature:" << stateFeature.name << "Type:" << stateFeature.type << "MinZoom:" << stateFeature.minZoom;
-            
-            QString geomType = geometry["type"].toString();
-            
-            if (geomType == "Polygon") {
-                QJsonArray coordinates = geometry["coordinates"].toArray();
-                if (!coordinates.isEmpty()) {
-                    QJsonArray ring = coordinates[0].toArray();
-                    QPolygonF polygon;
-                    
-                    for (const auto &coord : ring) {
-                        QJsonArray point = coord.toArray();
-                        if (point.size() >= 2) {
-                            double lon = point[0].toDouble();
-                            double lat = point[1].toDouble();
-                            polygon << QPointF(lon, lat);
-                        }
-                    }
-                    stateFeature.polygons.append(polygon);
-                }
-            }
-            else if (geomType == "MultiPolygon") {
-                QJsonArray coordinates = geometry["coordinates"].toArray();
-                for (const auto &polygonCoords : coordinates) {
-                    QJsonArray rings = polygonCoords.toArray();
-                    if (!rings.isEmpty()) {
-                        QJsonArray ring = rings[0].toArray();
-                        QPolygonF polygon;
-                        
-                        for (const auto &coord : ring) {
-                            QJsonArray point = coord.toArray();
-                            if (point.size() >= 2) {
-                                double lon = point[0].toDouble();
-                                double lat = point[1].toDouble();
-                                polygon << QPointF(lon, lat);
-                            }
-                        }
-                        stateFeature.polygons.append(polygon);
-                    }
-                }
-            }
-            else if (geomType == "LineString") {
-                // Handle rivers (LineString geometry)
-                QJsonArray coordinates = geometry["coordinates"].toArray();
-                for (const auto &coord : coordinates) {
-                    QJsonArray point = coord.toArray();
-                    if (point.size() >= 2) {
-                        double lon = point[0].toDouble();
-                        double lat = point[1].toDouble();
-                        stateFeature.lineString << QPointF(lon, lat);
-                    }
-                }
-            }
-            
-            if (!stateFeature.polygons.isEmpty() || !stateFeature.lineString.isEmpty()) {
-                stateBoundaries.append(stateFeature);
-                qDebug() << "Loaded feature:" << stateFeature.name 
-                         << "Polygons:" << stateFeature.polygons.size() 
-                         << "LinePoints:" << stateFeature.lineString.size();
-            }
-        }
+    // Only the coarsest level stays in memory (for fitting, lookups and the
+    // choropleth); the renderer reads detailed tiles as the view needs them
+    GeometryTileStore::Overview overview = geometryStore.overview();
+    indiaBoundary = overview.boundary;
+    stateBoundaries = overview.features;
+    qDebug() << "Streaming" << stateBoundaries.size() << "features from" << GEOMETRY_STORE_PATH;
+    
+    reprojectGeometry();
+    geocoder.setFeatures(stateBoundaries);
+    invalidateStaticLayers();
+    fitMapToView();
+    return true;
+}
+
+void MapWidget::buildGeometryStore()
+{
+    // If the store cannot be written, the loaded geometry is drawn from memory
+    if (GeometryTileStore::build(GEOMETRY_STORE_PATH, stateBoundaries, indiaBoundary, geometrySourceStamp())) {
+        openGeometryStore();
     }
+}
+
+QPointF MapWidget::geoToScreen(double lat, double lon) const
+{
+    return currentView().geoToScreen(lat, lon);
+}
+
+void MapWidget::screenToGeo(const QPointF &screen, double &lat, double &lon) const
+{
+    currentView().screenToGeo(screen, lat, lon);
+}
+
+QString MapWidget::stateNameAt(const QPoint &pos) const
+{
+    double lat, lon;
+    screenToGeo(pos, lat, lon);
     
-    qDebug() << "Total features loaded:" << stateBoundaries.size();
+    // The store answers from full-detail tiles; in memory there is only the overview
+    int feature = geometryStore.isOpen() ? geometryStore.featureAt(lon, lat, projection) : geocoder.featureAt(lat, lon);
+    return feature >= 0 ? stateBoundaries[feature].name : QString();
 }
 
-QPointF MapWidget::geoToScreen(double lat, double lon)
+QVector<ReverseGeocoder::NearbyStation> MapWidget::nearestStations(const QPoint &pos, int count) const
 {
-    // Simple equirectangular projection
-    double x = (lon - centerLon) * scale * 100 + width() / 2.0 + panOffset.x();
-    double y = (centerLat - lat) * scale * 100 + height() / 2.0 + panOffset.y();
-    return QPointF(x, y);
+    double lat, lon;
+    screenToGeo(pos, lat, lon);
+    return geocoder.nearestStations(lat, lon, count);
 }
 
-void MapWidget::screenToGeo(const QPointF &screen, double &lat, double &lon)
+void MapWidget::setStateFillColors(const QVector<QColor> &colors)
 {
-    lon = centerLon + (screen.x() - width() / 2.0 - panOffset.x()) / (scale * 100);
-    lat = centerLat - (screen.y() - height() / 2.0 - panOffset.y()) / (scale * 100);
+    stateFills = colors;
+    invalidateStaticLayers();
+    update();
+}
+
+void MapWidget::colorStatesByStationDensity()
+{
+    // Stations per state, shaded from pale yellow (few) to red (most)
+    QVector<int> counts(stateBoundaries.size(), 0);
+    for (const auto &station : stations) {
+        int feature = geocoder.featureAt(station.lat, station.lon);
+        if (feature >= 0) ++counts[feature];
+    }
+    int maxCount = counts.isEmpty() ? 0 : *std::max_element(counts.begin(), counts.end());
+    
+    QVector<QColor> colors(stateBoundaries.size());
+    for (int i = 0; i < stateBoundaries.size(); ++i) {
+        if (stateBoundaries[i].polygons.isEmpty()) continue;
+        double t = maxCount > 0 ? std::sqrt(double(counts[i]) / maxCount) : 0.0;
+        colors[i] = QColor::fromHsvF((60 - 60 * t) / 360.0, 0.25 + 0.65 * t, 1.0, 0.55);
+    }
+    qDebug() << "Station density: up to" << maxCount << "stations per state";
+    setStateFillColors(colors);
+}
+
+bool MapWidget::setRasterBaseLayer(const QString &path)
+{
+    // Renders in flight read the archive; let them finish before remapping it
+    renderThread.waitForIdle();
+    if (!rasterTiles.open(path)) {
+        qWarning() << "Could not open raster tiles" << path;
+        return false;
+    }
+    if (rasterTiles.projection() != projection.type()) {
+        qWarning() << "Raster tiles are in another projection; drawing vectors until it matches";
+    }
+    invalidateStaticLayers();
+    update();
+    return true;
+}
+
+bool MapWidget::loadVectorTiles(const QString &path, int level)
+{
+    // Snapshots being rendered read the features and the geometry store
+    renderThread.waitForIdle();
+    if (!vectorTiles.open(path)) {
+        qWarning() << "Could not open vector tiles" << path;
+        return false;
+    }
+    // Every tile of the level is decoded into memory, so by default the
+    // coarsest: the fewest tiles, at the least detail
+    QVector<StateFeature> features = vectorTiles.features(level < 0 ? vectorTiles.minLevel() : level);
+    if (features.isEmpty()) {
+        qWarning() << "No features in vector tiles" << path;
+        return false;
+    }
+    
+    // The store was tiled from the GeoJSON features; the tile set replaces
+    // them, drawn from memory, with the full boundary back in place of the
+    // store's overview
+    if (geometryStore.isOpen()) {
+        geometryStore.close();
+        indiaBoundary = GeoJsonLoader::loadBoundary("india_boundary_detailed.geojson");
+    }
+    stateBoundaries = features;
+    stateFills.clear();
+    reprojectGeometry();
+    geocoder.setFeatures(stateBoundaries);
+    invalidateStaticLayers();
+    update();
+    return true;
+}
+
+bool MapWidget::setMapStyle(const QString &path)
+{
+    // Snapshots being rendered read the style and the ids compiled from it
+    renderThread.waitForIdle();
+    if (!mapStyle.load(path)) return false;
+    
+    mapStyle.compile(stateBoundaries);
+    invalidateStaticLayers();
+    update();
+    return true;
+}
+
+void MapWidget::setProjection(MapProjection::Type type)
+{
+    if (projection.type() == type) return;
+    
+    projection = MapProjection(type);
+    qDebug() << "Projection:" << projection.name();
+    
+    reprojectGeometry();
+    fitMapToView();
+    update();
+}
+
+void MapWidget::reprojectGeometry()
+{
+    // Snapshots being rendered read the track cache and the style ids
+    renderThread.waitForIdle();
+    
+    // Railway track runs through the stations in file (id) order, in projected units
+    QVector<QPointF> trackNodes;
+    trackNodes.reserve(stations.size());
+    for (int slot : stationSlots) {
+        trackNodes.append(QPointF(stations[slot].lon, stations[slot].lat));
+    }
+    projection.forward(trackNodes.constData(), trackNodes.data(), trackNodes.size());
+    trackCache.setNodes(trackNodes);
+    
+    // Polygons are projected and triangulated once here and kept relative to
+    // their own centre, so painting never re-projects or scales absolute
+    // coordinates
+    indiaBoundaryLocal.clear();
+    for (const auto &polygon : indiaBoundary) {
+        indiaBoundaryLocal.append(LocalPolygon::fromGeo(polygon, projection, true));
+    }
+    for (auto &feature : stateBoundaries) {
+        feature.reproject(projection);
+    }
+    
+    // Feature types are matched to style rules here, not while painting
+    mapStyle.compile(stateBoundaries);
 }
 
 QPointF MapWidget::worldToScreen(const QPointF &worldPos)
@@ -286,10 +365,42 @@ QPointF MapWidget::worldToScreen(const QPointF &worldPos)
     return worldPos;
 }
 
+MapScene MapWidget::sceneSnapshot()
+{
+    // Shallow copies: the vectors are implicitly shared, not duplicated
+    MapScene scene;
+    scene.stations = stations;
+    scene.indiaBoundary = indiaBoundaryLocal;
+    scene.stateBoundaries = stateBoundaries;
+    scene.stateFills = stateFills;
+    scene.trackCache = &trackCache;
+    scene.tileStore = &geometryStore;
+    scene.rasterTiles = &rasterTiles;
+    scene.style = &mapStyle;
+    scene.view = currentView();
+    return scene;
+}
+
+MapView MapWidget::currentView() const
+{
+    MapView view;
+    view.centerLat = centerLat;
+    view.centerLon = centerLon;
+    view.scale = scale;
+    view.panOffset = panOffset;
+    view.size = size();
+    view.projection = projection;
+    view.devicePixelRatio = devicePixelRatioF();
+    return view;
+}
+
 void MapWidget::updateStationPositions()
 {
+    // Project with the view transform computed once, not per station
+    MapView view = currentView();
+    ViewTransform toScreen = view.transform();
     for (auto &station : stations) {
-        station.screenPos = geoToScreen(station.lat, station.lon);
+        station.screenPos = toScreen.map(projection.forward(station.lon, station.lat));
     }
 }
 
@@ -297,28 +408,25 @@ void MapWidget::fitMapToView()
 {
     if (indiaBoundary.isEmpty()) return;
     
-    // Find bounds of India boundary
-    double minLat = 90, maxLat = -90, minLon = 180, maxLon = -180;
+    // A fitted view replaces any zoom in progress
+    animationTimer->stop();
     
+    // Find projected bounds of India boundary
+    QRectF bounds;
     for (const auto &polygon : indiaBoundary) {
-        for (const auto &point : polygon) {
-            minLat = qMin(minLat, point.y());
-            maxLat = qMax(maxLat, point.y());
-            minLon = qMin(minLon, point.x());
-            maxLon = qMax(maxLon, point.x());
-        }
+        QPolygonF projected(polygon.size());
+        projection.forward(polygon.constData(), projected.data(), polygon.size());
+        bounds = bounds.united(projected.boundingRect());
     }
     
     // Set center and scale
-    centerLat = (minLat + maxLat) / 2.0;
-    centerLon = (minLon + maxLon) / 2.0;
-    
-    double latRange = maxLat - minLat;
-    double lonRange = maxLon - minLon;
+    QPointF center = projection.inverse(bounds.center());
+    centerLat = center.y();
+    centerLon = center.x();
     
     if (width() > 0 && height() > 0) {
-        double scaleX = width() / (lonRange * 120);
-        double scaleY = height() / (latRange * 120);
+        double scaleX = width() / (bounds.width() * 120);
+        double scaleY = height() / (bounds.height() * 120);
         scale = qMin(scaleX, scaleY) * 0.9; // Add some padding
         scale = qBound(MIN_SCALE, scale, MAX_SCALE);
     }
@@ -330,25 +438,71 @@ void MapWidget::fitMapToView()
 void MapWidget::paintEvent(QPaintEvent *event)
 {
     QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
-    
-    // Clear background with clean white
-    painter.fillRect(rect(), Qt::white); // Clean white background
     
-    // Draw India boundary
-    drawIndiaBoundary(painter);
+    // Only the dirty region is repainted; everything outside it is culled
+    const QRegion &dirty = event->region();
+    painter.setClipRegion(dirty);
+    
+    // Boundary, states, tracks and stations are rasterized on the render
+    // thread, and only again once the view or the data has changed. Painting
+    // never waits for it: until the frame for this view arrives, the last
+    // one is moved and scaled into place.
+    adoptRenderedFrame();
+    MapView view = currentView();
+    
+    // Back at a zoom, or on a screen, the map was shown at before: the frame
+    // kept from then is exact, where the one on screen would be scaled
+    if (staticLayers.isNull() || staticLayersDirty || view.scale != staticLayersView.scale
+        || view.devicePixelRatio != staticLayersView.devicePixelRatio) {
+        if (restoreCachedFrame(view)) view = currentView();
+    }
     
-    // Draw state boundaries
-    drawStateBoundaries(painter);
+    bool reusable = !staticLayers.isNull() && view.projection == staticLayersView.projection;
+    QTransform cacheToScreen = reusable ? view.transformFrom(staticLayersView) : QTransform();
+    QPoint cacheOffset(qRound(cacheToScreen.dx()), qRound(cacheToScreen.dy()));
+    
+    bool moving = isPanning || isAnimating();
+    bool aligned = qAbs(cacheToScreen.dx() - cacheOffset.x()) < 0.01 && qAbs(cacheToScreen.dy() - cacheOffset.y()) < 0.01;
+    
+    // The frame is in device pixels; a frame rendered for another screen's
+    // pixel ratio is only a stand-in
+    double ratio = staticLayersView.devicePixelRatio;
+    if (reusable && !staticLayersDirty && view.scale == staticLayersView.scale && view.devicePixelRatio == ratio
+        && (moving || aligned) && QRect(cacheOffset, staticLayersView.size).contains(rect())) {
+        // Same zoom and the frame (which may include a prefetch margin)
+        // covers the widget: panning is a copy from the cached layers
+        for (const QRect &dirtyRect : dirty) {
+            QRectF source(QPointF(dirtyRect.translated(-cacheOffset).topLeft()) * ratio, QSizeF(dirtyRect.size()) * ratio);
+            painter.drawImage(QRectF(dirtyRect), staticLayers, source);
+        }
+    } else {
+        // Stand-in until the frame arrives: the last one moved and scaled
+        // into place, or blank before the first
+        painter.fillRect(rect(), Qt::white);
+        if (reusable) {
+            painter.setTransform(cacheToScreen);
+            painter.drawImage(0, 0, staticLayers);
+            painter.resetTransform();
+        }
+        
+        // Mid-zoom, skip rendering a view that is gone 16 ms later. While
+        // the camera moves, render with a margin so the next frames can be
+        // copied from this one.
+        if (!reusable || !isAnimating() || view.scale == targetScale()) {
+            requestFrame(moving ? cacheView(QPointF()) : view);
+        }
+    }
     
-    // Draw stations and railway line
-    drawStations(painter);
+    painter.setRenderHint(QPainter::Antialiasing);
     
     // Draw zoom controls
-    drawZoomControls(painter);
+    if (dirty.intersects(controlsRect())) {
+        drawZoomControls(painter);
+    }
     
     // Draw moving train if active
-    if (trainMoving && !trainPath.isEmpty() && trainPosition >= 0.0 && trainPosition <= 1.0) {
+    if (trainMoving && !trainPath.isEmpty() && trainPosition >= 0.0 && trainPosition <= 1.0
+        && dirty.intersects(trainSpriteRect())) {
         // trainPath now contains geographic coordinates (lon, lat)
         // Convert currentTrainPos (set in updateTrainPosition) to screen coordinates
         if (!currentTrainPos.isNull()) {
@@ -392,32 +546,14 @@ void MapWidget::paintEvent(QPaintEvent *event)
         }
     }
     
-    // Draw clicked station popup (full name)
-    if (clickedStationIndex >= 0 && clickedStationIndex < stations.size()) {
-        const Station &station = stations[clickedStationIndex];
-        
+    // Draw clicked station popup (full name); hidden while the camera moves
+    // because station screen positions are only refreshed when it settles
+    QRect popupRect;
+    QPolygonF triangle;
+    if (!isAnimating() && stationPopupGeometry(clickedStationIndex, popupRect, triangle)
+        && dirty.intersects(stationPopupRect(clickedStationIndex))) {
         // Set up font
-        QFont popupFont = painter.font();
-        popupFont.setPointSize(10);
-        popupFont.setBold(true);
-        painter.setFont(popupFont);
-        
-        // Calculate popup size
-        QFontMetrics fm(popupFont);
-        QString fullName = station.name;
-        QRect textRect = fm.boundingRect(fullName);
-        
-        // Position popup above the station
-        QPoint popupPos = station.screenPos.toPoint() + QPoint(-textRect.width() / 2, -25);
-        
-        // Ensure popup stays within window bounds
-        if (popupPos.x() < 5) popupPos.setX(5);
-        if (popupPos.x() + textRect.width() + 10 > width() - 5) 
-            popupPos.setX(width() - textRect.width() - 15);
-        if (popupPos.y() < 5) popupPos.setY(station.screenPos.y() + 25);
-        
-        // Draw popup background with shadow
-        QRect popupRect = textRect.translated(popupPos).adjusted(-8, -4, 8, 4);
+        painter.setFont(popupFont());
         
         // Shadow
         painter.setPen(Qt::NoPen);
@@ -431,217 +567,197 @@ void MapWidget::paintEvent(QPaintEvent *event)
         
         // Draw text
         painter.setPen(QColor(33, 33, 33));
-        painter.drawText(popupRect, Qt::AlignCenter, fullName);
+        painter.drawText(popupRect, Qt::AlignCenter, stations[clickedStationIndex].name);
         
         // Draw small triangle pointing to station
-        QPolygonF triangle;
-        int triangleX = station.screenPos.x();
-        int triangleY = (popupPos.y() < station.screenPos.y()) ? 
-                        popupRect.bottom() : popupRect.top();
-        
-        if (popupPos.y() < station.screenPos.y()) {
-            // Triangle points down
-            triangle << QPointF(triangleX, triangleY + 8)
-                    << QPointF(triangleX - 5, triangleY)
-                    << QPointF(triangleX + 5, triangleY);
-        } else {
-            // Triangle points up
-            triangle << QPointF(triangleX, triangleY - 8)
-                    << QPointF(triangleX - 5, triangleY)
-                    << QPointF(triangleX + 5, triangleY);
-        }
-        
         painter.setPen(QPen(QColor(33, 33, 33), 2));
         painter.setBrush(QColor(255, 235, 59));
         painter.drawPolygon(triangle);
     }
     
     // Draw zoom meter in bottom-left corner
-    drawZoomMeter(painter);
+    if (dirty.intersects(zoomMeterRect().adjusted(0, 0, 2, 2))) {
+        drawZoomMeter(painter);
+    }
+    
+    if (memoryOverlayVisible) {
+        drawMemoryOverlay(painter);
+    }
 }
 
-void MapWidget::drawIndiaBoundary(QPainter &painter)
+MemoryReport MapWidget::memoryReport() const
 {
-    painter.setPen(QPen(QColor(46, 125, 50), 2)); // Modern green border
-    painter.setBrush(QColor(165, 214, 167, 120)); // Light green with better transparency
-    
-    for (const auto &polygon : indiaBoundary) {
-        QPolygonF screenPolygon;
-        for (const auto &point : polygon) {
-            screenPolygon << geoToScreen(point.y(), point.x());
-        }
-        painter.drawPolygon(screenPolygon);
+    MemoryReport report;
+    report.add("stations", MemoryReport::bytesOf(stations) + qint64(stationSlots.capacity()) * sizeof(int), stations.size());
+    report.add("station labels", MemoryReport::labelBytesOf(stations), stations.size());
+    report.add("boundary", MemoryReport::bytesOf(indiaBoundary) + MemoryReport::bytesOf(indiaBoundaryLocal), indiaBoundary.size());
+    report.add("state features", MemoryReport::bytesOf(stateBoundaries), stateBoundaries.size());
+    report.add("track cache", trackCache.cachedBytes());
+    report.add("tile cache", qint64(geometryStore.cachedKilobytes()) * 1024);
+    if (rasterTiles.isOpen()) {
+        report.add("raster tiles", qint64(rasterTiles.cachedKilobytes()) * 1024);
+    }
+    if (vectorTiles.isOpen()) {
+        report.add("vector tiles", qint64(vectorTiles.cachedKilobytes()) * 1024);
     }
+    report.add("frame", staticLayers.sizeInBytes());
+    report.add("frame cache", qint64(frameCache.kilobytes()) * 1024);
+    report.add("frame arenas", lastFrameStats.arenaCapacity);
+    return report;
 }
 
-void MapWidget::drawStateBoundaries(QPainter &painter)
+QStringList MapWidget::frameStatsLines() const
 {
-    for (const auto &feature : stateBoundaries) {
-        // Check if feature should be displayed at current zoom level
-        if (feature.minZoom > 0 && scale < feature.minZoom) {
-            continue; // Skip if zoom level is below minimum
-        }
-        
-        // Set color based on feature type
-        if (feature.type == "river") {
-            // Rivers in light blue
-            painter.setPen(QPen(QColor(100, 180, 255), 2));
-            painter.setBrush(Qt::NoBrush);
-            
-            // Draw LineString (river path)
-            if (feature.lineString.size() > 1) {
-                QVector<QPointF> screenPath;
-                for (const auto &point : feature.lineString) {
-                    screenPath << geoToScreen(point.y(), point.x());
-                }
-                
-                // Draw as connected line
-                for (int i = 0; i < screenPath.size() - 1; ++i) {
-                    painter.drawLine(screenPath[i], screenPath[i + 1]);
-                }
-            }
-        }
-        else { // state_border or default
-            // State boundaries in blue
-            painter.setPen(QPen(QColor(33, 150, 243), 2));
-            painter.setBrush(Qt::NoBrush);
-            
-            // Draw polygons
-            for (const auto &polygon : feature.polygons) {
-                QPolygonF screenPolygon;
-                for (const auto &point : polygon) {
-                    screenPolygon << geoToScreen(point.y(), point.x());
-                }
-                painter.drawPolygon(screenPolygon);
-            }
-        }
+    return {
+        QString("last frame: %1 KB scratch in %2 arena allocations, %3 from the heap")
+            .arg(lastFrameStats.arenaBytes / 1024).arg(lastFrameStats.arenaAllocations)
+            .arg(lastFrameStats.heapAllocations)
+    };
+}
+
+void MapWidget::dumpMemoryReport() const
+{
+    for (const QString &line : memoryReport().lines() + frameStatsLines()) {
+        qDebug().noquote() << line;
     }
 }
 
-void MapWidget::drawRailwayTrack(QPainter &painter, const QPointF &start, const QPointF &end)
+void MapWidget::setMemoryOverlayVisible(bool visible)
 {
-    // Calculate track parameters
-    QLineF trackLine(start, end);
-    double length = trackLine.length();
-    double angle = trackLine.angle();
-    
-    // Don't draw if too short
-    if (length < 2) return;
+    memoryOverlayVisible = visible;
+    update();
+}
+
+void MapWidget::keyPressEvent(QKeyEvent *event)
+{
+    if (event->key() == Qt::Key_F12) {
+        setMemoryOverlayVisible(!memoryOverlayVisible);
+        return;
+    }
+    QWidget::keyPressEvent(event);
+}
+
+void MapWidget::drawMemoryOverlay(QPainter &painter)
+{
+    QStringList lines = memoryReport().lines() + frameStatsLines();
+    
+    QFont font("monospace");
+    font.setStyleHint(QFont::TypeWriter);
+    font.setPointSize(8);
+    QFontMetrics fm(font);
+    int width = 0;
+    for (const QString &line : lines) {
+        width = qMax(width, fm.boundingRect(line).width());
+    }
     
-    // Save painter state
+    // Top-left, clear of the zoom controls and the drawer
+    QRect box(10, 10, width + 16, lines.size() * fm.height() + 12);
     painter.save();
-    
-    // Railway track dimensions
-    const double railGauge = 6.0;        // Distance between rails (scaled)
-    const double sleeperWidth = 10.0;    // Width of sleepers
-    const double sleeperSpacing = 15.0;  // Distance between sleepers
-    const double railWidth = 2.5;        // Width of rails
-    
-    // Translate and rotate to align with track
-    painter.translate(start);
-    painter.rotate(-angle);
-    
-    // Draw sleepers (wooden/concrete ties)
-    int numSleepers = static_cast<int>(length / sleeperSpacing);
     painter.setPen(Qt::NoPen);
-    painter.setBrush(QColor(101, 67, 33)); // Brown color for wooden sleepers
-    
-    for (int i = 0; i <= numSleepers; ++i) {
-        double x = i * sleeperSpacing;
-        if (x > length) break;
-        
-        // Draw sleeper as a small rectangle
-        QRectF sleeper(x - 2, -sleeperWidth / 2, 4, sleeperWidth);
-        painter.drawRect(sleeper);
+    painter.setBrush(QColor(0, 0, 0, 170));
+    painter.drawRoundedRect(box, 6, 6);
+    painter.setFont(font);
+    painter.setPen(Qt::white);
+    for (int i = 0; i < lines.size(); ++i) {
+        painter.drawText(box.left() + 8, box.top() + 6 + fm.ascent() + i * fm.height(), lines[i]);
     }
-    
-    // Draw ballast bed (gravel under tracks) - subtle
-    painter.setBrush(QColor(150, 150, 150, 60));
-    QRectF ballast(0, -railGauge - 2, length, railGauge * 2 + 4);
-    painter.drawRect(ballast);
-    
-    // Draw rails (the metal tracks)
-    painter.setPen(Qt::NoPen);
-    
-    // Draw rail shadows for depth
-    painter.setBrush(QColor(0, 0, 0, 80));
-    QRectF rail1Shadow(0, -railGauge / 2 + 0.5, length, railWidth);
-    QRectF rail2Shadow(0, railGauge / 2 + 0.5, length, railWidth);
-    painter.drawRect(rail1Shadow);
-    painter.drawRect(rail2Shadow);
-    
-    // Draw main rails (metallic steel color)
-    painter.setBrush(QColor(192, 192, 192)); // Silver/steel color
-    QRectF rail1(0, -railGauge / 2, length, railWidth);
-    QRectF rail2(0, railGauge / 2, length, railWidth);
-    painter.drawRect(rail1);
-    painter.drawRect(rail2);
-    
-    // Add highlight to rails for metallic effect
-    painter.setBrush(QColor(220, 220, 220, 150));
-    QRectF rail1Highlight(0, -railGauge / 2, length, railWidth * 0.4);
-    QRectF rail2Highlight(0, railGauge / 2, length, railWidth * 0.4);
-    painter.drawRect(rail1Highlight);
-    painter.drawRect(rail2Highlight);
-    
-    // Restore painter state
     painter.restore();
 }
 
-void MapWidget::drawStations(QPainter &painter)
+QFont MapWidget::popupFont() const
+{
+    QFont popupFont = font();
+    popupFont.setPointSize(10);
+    popupFont.setBold(true);
+    return popupFont;
+}
+
+bool MapWidget::stationPopupGeometry(int index, QRect &popupRect, QPolygonF &triangle) const
 {
-    // Draw railway tracks connecting stations
-    for (int i = 0; i < stations.size() - 1; ++i) {
-        drawRailwayTrack(painter, stations[i].screenPos, stations[i + 1].screenPos);
+    if (index < 0 || index >= stations.size()) return false;
+    const Station &station = stations[index];
+    
+    // Calculate popup size
+    QFontMetrics fm(popupFont());
+    QRect textRect = fm.boundingRect(station.name);
+    
+    // Position popup above the station
+    QPoint popupPos = station.screenPos.toPoint() + QPoint(-textRect.width() / 2, -25);
+    
+    // Ensure popup stays within window bounds
+    if (popupPos.x() < 5) popupPos.setX(5);
+    if (popupPos.x() + textRect.width() + 10 > width() - 5) 
+        popupPos.setX(width() - textRect.width() - 15);
+    if (popupPos.y() < 5) popupPos.setY(station.screenPos.y() + 25);
+    
+    popupRect = textRect.translated(popupPos).adjusted(-8, -4, 8, 4);
+    
+    // Small triangle pointing to station
+    triangle.clear();
+    int triangleX = station.screenPos.x();
+    int triangleY = (popupPos.y() < station.screenPos.y()) ? 
+                    popupRect.bottom() : popupRect.top();
+    
+    if (popupPos.y() < station.screenPos.y()) {
+        // Triangle points down
+        triangle << QPointF(triangleX, triangleY + 8)
+                << QPointF(triangleX - 5, triangleY)
+                << QPointF(triangleX + 5, triangleY);
+    } else {
+        // Triangle points up
+        triangle << QPointF(triangleX, triangleY - 8)
+                << QPointF(triangleX - 5, triangleY)
+                << QPointF(triangleX + 5, triangleY);
     }
+    return true;
+}
+
+QRect MapWidget::stationPopupRect(int index) const
+{
+    QRect popupRect;
+    QPolygonF triangle;
+    if (!stationPopupGeometry(index, popupRect, triangle)) return QRect();
     
-    // Draw stations with modern styling
-    QFont font = painter.font();
-    font.setPointSize(9);
-    font.setBold(true);
-    painter.setFont(font);
+    // Include the drop shadow and the 2 px outlines
+    return popupRect.adjusted(-2, -2, 4, 4)
+        .united(triangle.boundingRect().toAlignedRect().adjusted(-2, -2, 2, 2));
+}
+
+QRect MapWidget::stationMarkerRect(int index) const
+{
+    if (index < 0 || index >= stations.size()) return QRect();
     
-    for (const auto &station : stations) {
-        // Draw station marker with gradient effect
-        painter.setPen(QPen(QColor(255, 87, 34), 2)); // Deep orange border
-        painter.setBrush(QColor(255, 152, 0));          // Orange fill
-        
-        // Draw outer circle (shadow)
-        painter.setBrush(QColor(0, 0, 0, 50));
-        painter.setPen(Qt::NoPen);
-        painter.drawEllipse(station.screenPos + QPointF(1, 1), 8, 8);
-        
-        // Draw main station marker
-        painter.setPen(QPen(QColor(255, 87, 34), 2));
-        painter.setBrush(QColor(255, 152, 0));
-        painter.drawEllipse(station.screenPos, 8, 8);
-        
-        // Draw inner white dot
-        painter.setPen(Qt::NoPen);
-        painter.setBrush(Qt::white);
-        painter.drawEllipse(station.screenPos, 3, 3);
-        
-        // Draw station name with background (only if zoom level is high enough)
-        if (scale > 1.5) {
-            QFontMetrics fm(font);
-            QRect textRect = fm.boundingRect(station.name);
-            QPointF textPos = station.screenPos + QPointF(12, -8);
-            
-            // Draw text background
-            painter.setBrush(QColor(255, 255, 255, 200));
-            painter.setPen(QPen(QColor(100, 100, 100), 1));
-            painter.drawRoundedRect(textRect.translated(textPos.toPoint()).adjusted(-2, -1, 2, 1), 3, 3);
-            
-            // Draw text
-            painter.setPen(QColor(33, 33, 33));
-            painter.drawText(textPos, station.name);
-        }
-    }
+    // Marker radius plus outline and shadow offset
+    QPoint center = stations[index].screenPos.toPoint();
+    return QRect(center - QPoint(11, 11), QSize(23, 23));
 }
 
-void MapWidget::drawZoomControls(QPainter &painter)
+QRect MapWidget::trainSpriteRect() const
+{
+    if (currentTrainPos.isNull()) return QRect();
+    
+    // Engine, wheels and smoke stay within this radius at any heading
+    QPoint center = geoToScreen(currentTrainPos.y(), currentTrainPos.x()).toPoint();
+    return QRect(center - QPoint(42, 42), QSize(85, 85));
+}
+
+QRect MapWidget::controlsRect() const
 {
-    // Position zoom controls in top-right corner with attractive styling
+    // Buttons plus their 1 px shadow and outline
+    return zoomInRect.united(tripPlannerRect).adjusted(-2, -2, 3, 3);
+}
+
+QRect MapWidget::zoomMeterRect() const
+{
+    int margin = 15;
+    int meterWidth = 150;
+    int meterHeight = 60;
+    return QRect(margin, height() - meterHeight - margin, meterWidth, meterHeight);
+}
+
+void MapWidget::layoutControls()
+{
+    // Position zoom controls in top-right corner
     int margin = 15;
     int buttonSize = 40;
     int spacing = 5;
@@ -649,6 +765,12 @@ void MapWidget::drawZoomControls(QPainter &painter)
     zoomInRect = QRect(width() - buttonSize - margin, margin, buttonSize, buttonSize);
     zoomOutRect = QRect(width() - buttonSize - margin, margin + buttonSize + spacing, buttonSize, buttonSize);
     recenterRect = QRect(width() - buttonSize - margin, margin + 2 * (buttonSize + spacing), buttonSize, buttonSize);
+    tripPlannerRect = QRect(width() - buttonSize - margin, margin + 3 * (buttonSize + spacing), buttonSize, buttonSize);
+}
+
+void MapWidget::drawZoomControls(QPainter &painter)
+{
+    // Zoom controls in top-right corner with attractive styling (see layoutControls)
     
     // Set up font for buttons
     QFont buttonFont = painter.font();
@@ -699,8 +821,6 @@ void MapWidget::drawZoomControls(QPainter &painter)
     painter.drawText(recenterRect, Qt::AlignCenter, "⌂");
     
     // Draw trip planner button
-    tripPlannerRect = QRect(width() - buttonSize - margin, margin + 3 * (buttonSize + spacing), buttonSize, buttonSize);
-    
     painter.setPen(QPen(QColor(255, 152, 0), 2)); // Orange border
     painter.setBrush(QColor(255, 255, 255, 230));
     painter.drawRoundedRect(tripPlannerRect, 6, 6);
@@ -719,11 +839,7 @@ void MapWidget::drawZoomControls(QPainter &painter)
 void MapWidget::drawZoomMeter(QPainter &painter)
 {
     // Position zoom meter in bottom-left corner
-    int margin = 15;
-    int meterWidth = 150;
-    int meterHeight = 60;
-    
-    QRect meterRect(margin, height() - meterHeight - margin, meterWidth, meterHeight);
+    QRect meterRect = zoomMeterRect();
     
     // Draw background with shadow
     painter.setPen(Qt::NoPen);
@@ -735,11 +851,8 @@ void MapWidget::drawZoomMeter(QPainter &painter)
     painter.setPen(QPen(QColor(70, 130, 180), 2));
     painter.drawRoundedRect(meterRect, 8, 8);
     
-    // Calculate approximate scale in meters
-    // At equator, 1 degree longitude ≈ 111 km = 111000 meters
-    // Screen width represents certain degrees of longitude divided by scale
-    double degreesPerPixel = 1.0 / scale;
-    double metersPerPixel = degreesPerPixel * 111000.0; // Approximate
+    // Ground distance per pixel at the view centre, from the active projection
+    double metersPerPixel = currentView().metresPerPixel();
     double referencePixels = 100.0; // Show scale for 100 pixels
     double scaleMeters = metersPerPixel * referencePixels;
     
@@ -796,40 +909,14 @@ void MapWidget::mousePressEvent(QMouseEvent *event)
     if (event->button() == Qt::LeftButton) {
         // Check if clicking on zoom controls FIRST (highest priority)
         if (zoomInRect.contains(event->pos())) {
-            // Smooth zoom in
-            if (zoomAnimation) {
-                zoomAnimation->stop();
-                delete zoomAnimation;
-            }
-            zoomAnimation = new QPropertyAnimation(this, "scale");
-            zoomAnimation->setDuration(200);
-            zoomAnimation->setStartValue(scale);
-            zoomAnimation->setEndValue(qMin(scale * 1.5, MAX_SCALE));
-            zoomAnimation->setEasingCurve(QEasingCurve::OutCubic);
-            connect(zoomAnimation, &QPropertyAnimation::valueChanged, [this]() {
-                updateStationPositions();
-                update();
-            });
-            zoomAnimation->start();
+            // Smooth zoom in around the widget centre
+            zoomAround(QPointF(width() / 2.0, height() / 2.0), qMin(targetScale() * 1.5, MAX_SCALE), 200, QEasingCurve::OutCubic);
             return;
         }
         
         if (zoomOutRect.contains(event->pos())) {
-            // Smooth zoom out
-            if (zoomAnimation) {
-                zoomAnimation->stop();
-                delete zoomAnimation;
-            }
-            zoomAnimation = new QPropertyAnimation(this, "scale");
-            zoomAnimation->setDuration(200);
-            zoomAnimation->setStartValue(scale);
-            zoomAnimation->setEndValue(qMax(scale / 1.5, MIN_SCALE));
-            zoomAnimation->setEasingCurve(QEasingCurve::OutCubic);
-            connect(zoomAnimation, &QPropertyAnimation::valueChanged, [this]() {
-                updateStationPositions();
-                update();
-            });
-            zoomAnimation->start();
+            // Smooth zoom out around the widget centre
+            zoomAround(QPointF(width() / 2.0, height() / 2.0), qMax(targetScale() / 1.5, MIN_SCALE), 200, QEasingCurve::OutCubic);
             return;
         }
         
@@ -843,14 +930,13 @@ void MapWidget::mousePressEvent(QMouseEvent *event)
             // Toggle drawer
             drawerOpen = !drawerOpen;
             if (drawerOpen) {
-                updateStationComboBoxes();
                 drawerWidget->setGeometry(width() - 300, 0, 300, height());
                 drawerWidget->show();
                 drawerWidget->raise();
             } else {
                 drawerWidget->hide();
             }
-            update();
+            update(controlsRect());
             return;
         }
         
@@ -858,25 +944,29 @@ void MapWidget::mousePressEvent(QMouseEvent *event)
         int stationIndex = findStationAtPoint(event->pos());
         if (stationIndex >= 0) {
             // Toggle popup: if clicking same station, close it; otherwise show new one
+            QRegion dirty(stationPopupRect(clickedStationIndex));
             if (clickedStationIndex == stationIndex) {
                 clickedStationIndex = -1;
             } else {
                 clickedStationIndex = stationIndex;
                 clickedStationPos = event->pos();
             }
-            update(); // Redraw to show/hide popup
+            update(dirty.united(stationPopupRect(clickedStationIndex))); // Redraw to show/hide popup
             return;
         }
         
         // Close popup if clicking elsewhere
         if (clickedStationIndex >= 0) {
+            update(stationPopupRect(clickedStationIndex));
             clickedStationIndex = -1;
-            update();
         }
         
-        // Start panning
+        // Start panning; a running zoom or coast stops where it is
+        stopAnimation();
         isPanning = true;
         lastPanPoint = event->pos();
+        panVelocity = QPointF();
+        panClock.start();
         setCursor(Qt::ClosedHandCursor);
     }
 }
@@ -887,15 +977,23 @@ void MapWidget::mouseMoveEvent(QMouseEvent *event)
         QPoint delta = event->pos() - lastPanPoint;
         panOffset += delta;
         lastPanPoint = event->pos();
-        updateStationPositions();
+        
+        // Smoothed drag velocity for coasting and prediction
+        qint64 elapsed = qMax<qint64>(1, panClock.restart());
+        panVelocity = panVelocity * 0.5 + QPointF(delta) / double(elapsed) * 0.5;
+        requestPrefetch(panOffset + panVelocity * PREFETCH_LOOKAHEAD_MS);
+        
+        // Stations are reprojected once the camera comes to rest
         update();
     } else {
         // Check for station hover
         int stationIndex = findStationAtPoint(event->pos());
         
         if (stationIndex != hoveredStationIndex) {
+            // Only the two markers involved need repainting
+            QRegion dirty(stationMarkerRect(hoveredStationIndex));
             hoveredStationIndex = stationIndex;
-            update(); // Redraw to show/hide tooltip
+            update(dirty.united(stationMarkerRect(hoveredStationIndex)));
         }
         
         // Change cursor over zoom controls or stations
@@ -919,25 +1017,11 @@ void MapWidget::mouseMoveEvent(QMouseEvent *event)
 
 void MapWidget::wheelEvent(QWheelEvent *event)
 {
-    // Smooth wheel zoom
+    // Smooth wheel zoom that keeps the point under the cursor in place;
+    // notches arriving mid-animation add to its target
     double scaleFactor = event->angleDelta().y() > 0 ? 1.2 : 1.0 / 1.2;
-    double newScale = qBound(MIN_SCALE, scale * scaleFactor, MAX_SCALE);
-    
-    if (zoomAnimation) {
-        zoomAnimation->stop();
-        delete zoomAnimation;
-    }
-    
-    zoomAnimation = new QPropertyAnimation(this, "scale");
-    zoomAnimation->setDuration(150);
-    zoomAnimation->setStartValue(scale);
-    zoomAnimation->setEndValue(newScale);
-    zoomAnimation->setEasingCurve(QEasingCurve::OutQuad);
-    connect(zoomAnimation, &QPropertyAnimation::valueChanged, [this]() {
-        updateStationPositions();
-        update();
-    });
-    zoomAnimation->start();
+    double newScale = qBound(MIN_SCALE, targetScale() * scaleFactor, MAX_SCALE);
+    zoomAround(event->position(), newScale, 150, QEasingCurve::OutQuad);
 }
 
 void MapWidget::mouseReleaseEvent(QMouseEvent *event)
@@ -946,12 +1030,23 @@ void MapWidget::mouseReleaseEvent(QMouseEvent *event)
         if (isPanning) {
             isPanning = false;
             setCursor(Qt::ArrowCursor);
+            
+            // A flick keeps coasting: ease-out over the coast duration
+            // starts at the release velocity (OutQuad's initial slope is 2)
+            double speed = std::hypot(panVelocity.x(), panVelocity.y());
+            if (speed >= MIN_FLICK_SPEED && panClock.elapsed() < 80) {
+                QPointF distance = panVelocity * (KINETIC_DURATION_MS / 2.0);
+                animateTo(scale, panOffset + distance, KINETIC_DURATION_MS, QEasingCurve::OutQuad);
+            } else {
+                updateStationPositions();
+                update();
+            }
         }
     } else if (event->button() == Qt::RightButton) {
         // Right click to close popup
         if (clickedStationIndex >= 0) {
+            update(stationPopupRect(clickedStationIndex));
             clickedStationIndex = -1;
-            update();
         }
     }
 }
@@ -959,6 +1054,7 @@ void MapWidget::mouseReleaseEvent(QMouseEvent *event)
 void MapWidget::resizeEvent(QResizeEvent *event)
 {
     Q_UNUSED(event)
+    layoutControls();
     updateStationPositions();
     
     // Reposition drawer if open
@@ -969,12 +1065,166 @@ void MapWidget::resizeEvent(QResizeEvent *event)
     update();
 }
 
-void MapWidget::updateAnimation()
+void MapWidget::animateTo(double toScale, const QPointF &toPan, int durationMs, QEasingCurve::Type easing)
+{
+    // Retargeting starts from wherever the camera is now
+    animationFromScale = scale;
+    animationToScale = toScale;
+    animationFromPan = panOffset;
+    animationToPan = toPan;
+    animationDuration = durationMs;
+    animationAnchored = false;
+    animationEasing.setType(easing);
+    animationClock.start();
+    if (!animationTimer->isActive()) {
+        animationTimer->start();
+    }
+}
+
+void MapWidget::zoomAround(const QPointF &anchor, double toScale, int durationMs, QEasingCurve::Type easing)
+{
+    // The anchor's offset from the projected view centre grows with the
+    // zoom; the pan takes up the difference so the anchor stays put
+    QPointF half(width() / 2.0, height() / 2.0);
+    QPointF toPan = anchor - half - (anchor - half - panOffset) * (toScale / scale);
+    animateTo(toScale, toPan, durationMs, easing);
+    animationAnchored = true;
+    animationAnchor = anchor;
+}
+
+void MapWidget::stopAnimation()
 {
+    if (!animationTimer->isActive()) return;
+    animationTimer->stop();
+    
+    // Settled: stations are reprojected once and the next paint renders
+    // the static layers crisply for the final view
+    panOffset = QPointF(qRound(panOffset.x()), qRound(panOffset.y()));
     updateStationPositions();
     update();
 }
 
+void MapWidget::updateAnimation()
+{
+    double progress = qMin(1.0, animationClock.elapsed() / double(qMax(1, animationDuration)));
+    double eased = animationEasing.valueForProgress(progress);
+    
+    // Geometric interpolation: every step zooms by the same factor
+    scale = animationFromScale * std::pow(animationToScale / animationFromScale, eased);
+    if (animationAnchored) {
+        // Recomputed from the scale each frame, so the anchor never drifts
+        QPointF half(width() / 2.0, height() / 2.0);
+        panOffset = animationAnchor - half - (animationAnchor - half - animationFromPan) * (scale / animationFromScale);
+    } else if (animationFromPan != animationToPan) {
+        panOffset = animationFromPan + (animationToPan - animationFromPan) * eased;
+    }
+    
+    if (progress >= 1.0) {
+        stopAnimation();
+        return;
+    }
+    
+    // Warm the area the camera will reach within the lookahead
+    double ahead = qMin(1.0, progress + double(PREFETCH_LOOKAHEAD_MS) / qMax(1, animationDuration));
+    if (animationFromScale == animationToScale) {
+        requestPrefetch(animationFromPan + (animationToPan - animationFromPan) * animationEasing.valueForProgress(ahead));
+    }
+    update();
+}
+
+MapView MapWidget::cacheView(const QPointF &lead) const
+{
+    // The widget's view grown by the margin on every side and shifted by
+    // lead, so the widget area sits in the middle after panning by lead
+    MapView view = currentView();
+    view.size += QSize(2 * PREFETCH_MARGIN, 2 * PREFETCH_MARGIN);
+    view.panOffset += lead;
+    return view;
+}
+
+void MapWidget::requestPrefetch(const QPointF &predictedPan)
+{
+    // A frame the view is waiting for goes first
+    if (renderThread.isBusy() || staticLayersDirty || staticLayers.isNull()) return;
+    
+    // Nothing to do while the predicted viewport is still inside the cache
+    MapView view = currentView();
+    QTransform cacheToScreen = view.transformFrom(staticLayersView);
+    QRectF cached = cacheToScreen.mapRect(QRectF(QPointF(), QSizeF(staticLayersView.size)));
+    QRectF predicted = QRectF(rect()).translated(-(predictedPan - panOffset));
+    if (view.scale == staticLayersView.scale && cached.contains(predicted)) return;
+    
+    MapScene scene = sceneSnapshot();
+    scene.view = cacheView(predictedPan - panOffset);
+    renderThread.publish(scene, layersGeneration, true);
+}
+
+void MapWidget::requestFrame(const MapView &view)
+{
+    // Repaints while the frame renders ask for the same view again
+    if (view == requestedView && requestedGeneration == layersGeneration) return;
+    
+    MapScene scene = sceneSnapshot();
+    scene.view = view;
+    renderThread.publish(scene, layersGeneration);
+    requestedView = view;
+    requestedGeneration = layersGeneration;
+}
+
+void MapWidget::adoptRenderedFrame()
+{
+    RenderThread::Frame frame;
+    if (!renderThread.takeFrame(frame)) return;
+    
+    // Older than the frame on screen (a prefetch overtaken by a request), or
+    // for a projection that is gone
+    if (frame.request <= staticLayersRequest || frame.view.projection != projection) return;
+    
+    // A prefetch for a zoom the view has left is no use as a stand-in
+    if (frame.speculative && frame.view.scale != scale) return;
+    
+    retireFrame();
+    staticLayers = frame.image;
+    staticLayersView = frame.view;
+    staticLayersRequest = frame.request;
+    staticLayersDirty = frame.generation != layersGeneration;
+    lastFrameStats = frame.stats;
+}
+
+void MapWidget::retireFrame()
+{
+    // Kept for coming back to its zoom or screen; frames of data that has
+    // changed since are of no use
+    if (!staticLayers.isNull() && !staticLayersDirty) {
+        frameCache.insert(FrameCache::Frame{ staticLayers, staticLayersView });
+    }
+}
+
+bool MapWidget::restoreCachedFrame(const MapView &view)
+{
+    FrameCache::Frame cached;
+    if (!frameCache.take(view, cached)) return false;
+    
+    // The frame it replaces goes into the cache in its place
+    retireFrame();
+    staticLayers = cached.image;
+    staticLayersView = cached.view;
+    staticLayersDirty = false;
+    
+    // Its scale may differ from the view's in the last bits; the view takes
+    // the frame's, so the frame is copied, not scaled
+    scale = cached.view.scale;
+    return true;
+}
+
+void MapWidget::invalidateStaticLayers()
+{
+    // The frame stays on screen until its replacement is rendered
+    staticLayersDirty = true;
+    frameCache.clear();
+    ++layersGeneration;
+}
+
 void MapWidget::recenterMap()
 {
     // Reset to initial view
@@ -1031,7 +1281,11 @@ void MapWidget::setupDrawerUI()
     QLabel *sourceLabel = new QLabel("Source Station:", drawerWidget);
     layout->addWidget(sourceLabel);
     
+    // Both combo boxes read the station store through one lazy model
+    stationModel = new StationListModel(&stations, &stationSlots, this);
+    
     sourceComboBox = new QComboBox(drawerWidget);
+    setupStationComboBox(sourceComboBox);
     layout->addWidget(sourceComboBox);
     
     // Destination station
@@ -1039,6 +1293,7 @@ void MapWidget::setupDrawerUI()
     layout->addWidget(destLabel);
     
     destinationComboBox = new QComboBox(drawerWidget);
+    setupStationComboBox(destinationComboBox);
     layout->addWidget(destinationComboBox);
     
     // Speed control
@@ -1079,16 +1334,55 @@ void MapWidget::setupDrawerUI()
     layout->addStretch();
 }
 
+void MapWidget::setupStationComboBox(QComboBox *comboBox)
+{
+    // Uniform rows and a fixed width hint keep the combo box and its popup
+    // from measuring every station name
+    QListView *view = new QListView(comboBox);
+    view->setUniformItemSizes(true);
+    comboBox->setView(view);
+    comboBox->setModel(stationModel);
+    comboBox->setSizeAdjustPolicy(QComboBox::AdjustToMinimumContentsLengthWithIcon);
+    comboBox->setMinimumContentsLength(20);
+    
+    // Typing queries the search index; the default completer would scan
+    // every station name per keystroke
+    comboBox->setEditable(true);
+    comboBox->setInsertPolicy(QComboBox::NoInsert);
+    comboBox->setCompleter(nullptr);
+    comboBox->lineEdit()->setPlaceholderText("Type a station name or code");
+    
+    StationListModel *results = new StationListModel(&stations, &stationSlots, comboBox);
+    results->setFilter(QVector<int>());
+    QCompleter *completer = new QCompleter(results, comboBox);
+    completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    completer->setWidget(comboBox->lineEdit());
+    
+    connect(comboBox->lineEdit(), &QLineEdit::textEdited, completer, [this, results, completer](const QString &text) {
+        QVector<int> matches;
+        for (const auto &match : stationSearch.search(text)) {
+            matches.append(stations[match.station].id);
+        }
+        results->setFilter(matches);
+        if (matches.isEmpty()) {
+            completer->popup()->hide();
+        } else {
+            completer->complete();
+        }
+    });
+    connect(completer, QOverload<const QModelIndex &>::of(&QCompleter::activated), comboBox, [comboBox](const QModelIndex &index) {
+        comboBox->setCurrentIndex(index.data(Qt::UserRole).toInt());
+    });
+}
+
 void MapWidget::updateStationComboBoxes()
 {
-    sourceComboBox->clear();
-    destinationComboBox->clear();
-    
-    for (int i = 0; i < stations.size(); ++i) {
-        sourceComboBox->addItem(stations[i].name, i);
-        destinationComboBox->addItem(stations[i].name, i);
-    }
+    // Only needed when the station store is replaced; opening the drawer
+    // no longer touches the combo boxes
+    stationModel->reload();
+    stationSearch.build(stations);
     
+    sourceComboBox->setCurrentIndex(stations.isEmpty() ? -1 : 0);
     if (stations.size() > 1) {
         destinationComboBox->setCurrentIndex(stations.size() - 1);
     }
@@ -1108,14 +1402,18 @@ void MapWidget::startTrip()
     calculateTrainPath();
     
     // Start animation
+    QRegion dirty(trainSpriteRect());
     trainPosition = 0.0;
     trainMoving = true;
+    if (!trainPath.isEmpty()) {
+        currentTrainPos = trainPath.first();
+    }
     trainTimer->start(30); // ~33 FPS
     
     startButton->setEnabled(false);
     stopButton->setEnabled(true);
     
-    update();
+    update(dirty.united(trainSpriteRect()));
 }
 
 void MapWidget::stopTrip()
@@ -1126,7 +1424,7 @@ void MapWidget::stopTrip()
     startButton->setEnabled(true);
     stopButton->setEnabled(false);
     
-    update();
+    update(trainSpriteRect());
 }
 
 void MapWidget::calculateTrainPath()
@@ -1145,7 +1443,8 @@ void MapWidget::calculateTrainPath()
     
     for (int i = start; i <= end; ++i) {
         // Store as QPointF(lon, lat) for geographic coordinates
-        trainPath.append(QPointF(stations[i].lon, stations[i].lat));
+        const Station &station = stations[stationSlots[i]];
+        trainPath.append(QPointF(station.lon, station.lat));
     }
     
     // Reverse if going backwards
@@ -1160,6 +1459,11 @@ void MapWidget::updateTrainPosition()
         return;
     }
     
+    // Repaint only the old and new sprite bounds unless the camera moves
+    QRegion dirty(trainSpriteRect());
+    double previousCenterLat = centerLat;
+    double previousCenterLon = centerLon;
+    
     // Calculate path length in geographic coordinates
     double pathLength = 0.0;
     for (int i = 0; i < trainPath.size() - 1; ++i) {
@@ -1246,7 +1550,11 @@ void MapWidget::updateTrainPosition()
         currentLength += segmentLength;
     }
     
-    update();
+    if (centerLat != previousCenterLat || centerLon != previousCenterLon) {
+        update();
+    } else {
+        update(dirty.united(trainSpriteRect()));
+    }
 }
 
 void MapWidget::drawTrain(QPainter &painter, const QPointF &position, double angle)
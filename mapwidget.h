@@ -5,41 +5,80 @@
 #include <QPainter>
 #include <QMouseEvent>
 #include <QWheelEvent>
+#include <QKeyEvent>
 #include <QPoint>
 #include <QTimer>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
-#include <QPropertyAnimation>
 #include <QEasingCurve>
+#include <QElapsedTimer>
 #include <QTimer>
 #include <QComboBox>
+#include <QListView>
+#include <QLineEdit>
+#include <QCompleter>
+#include <QAbstractItemView>
 #include <QPushButton>
 #include <QSlider>
 #include <QLabel>
 #include <QVBoxLayout>
-
-struct Station {
-    QString name;
-    double lat;
-    double lon;
-    QPointF screenPos;
-};
+#include "maprenderer.h"
+#include "stationlistmodel.h"
+#include "stationsearchindex.h"
+#include "reversegeocoder.h"
+#include "geometrytilestore.h"
+#include "rastertilearchive.h"
+#include "renderthread.h"
+#include "memoryreport.h"
+#include "mapstyle.h"
+#include "vectortilesource.h"
+#include "framecache.h"
 
 class MapWidget : public QWidget
 {
     Q_OBJECT
-    Q_PROPERTY(double scale READ getScale WRITE setScale)
 
 public:
     explicit MapWidget(QWidget *parent = nullptr);
     void loadStations(const QString &filename = "stations.geojson");
     void loadIndiaBoundary();
     void loadStateBoundaries();
+    void loadRailwayLines();
+    
+    // Draw the static layers from a pre-rendered tile archive (maprender
+    // --archive) where it covers the view; false if it cannot be opened
+    bool setRasterBaseLayer(const QString &path);
+    
+    // States, rivers and other features from a vector tile set (a directory
+    // of .mvt tiles or a packed archive) instead of the GeoJSON files, read
+    // at one level of the set (-1: its coarsest); false if it has none
+    bool loadVectorTiles(const QString &path, int level = -1);
+    
+    // Colours, widths and zoom ranges of the vector layers from a style
+    // sheet (see MapStyle); false if it cannot be read or parsed
+    bool setMapStyle(const QString &path);
+    
+    void setProjection(MapProjection::Type type);
+    MapProjection::Type projectionType() const { return projection.type(); }
+    
+    // Reverse geocoding of a widget position
+    QString stateNameAt(const QPoint &pos) const; // Empty outside every state
+    QVector<ReverseGeocoder::NearbyStation> nearestStations(const QPoint &pos, int count = 1) const;
+    
+    // Choropleth fill per state feature (invalid colour = outline only)
+    void setStateFillColors(const QVector<QColor> &colors);
+    void colorStatesByStationDensity();
     
-    // Property for animation
-    void setScale(double newScale) { scale = newScale; update(); }
-    double getScale() const { return scale; }
+    // Bytes held by the datasets, caches and frame buffers, per subsystem
+    MemoryReport memoryReport() const;
+    
+public slots:
+    // Logs the memory report and the last frame's scratch use
+    void dumpMemoryReport() const;
+    
+    // Debug overlay with the same numbers, refreshed every paint (F12)
+    void setMemoryOverlayVisible(bool visible);
 
 protected:
     void paintEvent(QPaintEvent *event) override;
@@ -48,6 +87,7 @@ protected:
     void mouseReleaseEvent(QMouseEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
 
 private slots:
     void updateAnimation();
@@ -57,22 +97,39 @@ private slots:
 
 private:
     // Map data structures
-    struct StateFeature {
-        QString name;
-        QString type; // "state_border" or "river"
-        double minZoom; // Minimum zoom level to display (0 = always show)
-        QVector<QPolygonF> polygons; // For Polygon/MultiPolygon
-        QVector<QPointF> lineString; // For LineString (rivers)
-    };
-    
-    QVector<Station> stations;
+    QVector<Station> stations; // Hilbert order, see orderStationsSpatially()
+    QVector<int> stationSlots; // Station id -> index into stations
     QVector<QPolygonF> indiaBoundary;
+    QVector<LocalPolygon> indiaBoundaryLocal; // Projected and origin-rebased for rendering
     QVector<StateFeature> stateBoundaries; // State borders and rivers with metadata
+    QVector<QColor> stateFills;
+    ReverseGeocoder geocoder; // Point-in-state and nearest-station lookups
+    TrackGeometryCache trackCache; // Batched sleeper/rail geometry per zoom band
+    GeometryTileStore geometryStore; // Boundary and state tiles streamed by viewport and zoom
+    RasterTileArchive rasterTiles; // Optional pre-rendered base layer
+    MapStyle mapStyle; // Compiled into the style ids of stateBoundaries
+    VectorTileSource vectorTiles; // Optional source of the features
+    QImage staticLayers; // Frame on screen, reused for partial repaints
+    MapView staticLayersView; // May be larger than the widget (prefetch margin)
+    bool staticLayersDirty; // The frame predates the current data
+    int staticLayersRequest; // Render request staticLayers came from
+    int layersGeneration; // Bumped whenever the static layers' data changes
+    FrameCache frameCache; // Earlier frames of the current data, by zoom band and pixel ratio
+    
+    // Frames are rasterized on the render thread from published snapshots;
+    // painting only takes finished frames and blits. Declared after the scene
+    // data it reads, so it is stopped (finishing its frame) first.
+    RenderThread renderThread;
+    MapView requestedView; // Last view published for display
+    int requestedGeneration;
+    MapRenderer::FrameStats lastFrameStats; // Of the frame on screen
+    bool memoryOverlayVisible;
     
     // View parameters
     double centerLat, centerLon;
     double scale;
     QPointF panOffset;
+    MapProjection projection;
     
     // Mouse interaction
     bool isPanning;
@@ -80,27 +137,74 @@ private:
     int hoveredStationIndex;
     int clickedStationIndex;
     QPoint clickedStationPos;
+    QPointF panVelocity; // Pixels per millisecond, smoothed over recent moves
+    QElapsedTimer panClock;
+    
+    // Camera animation. Scale and pan are interpolated on one reused timer;
+    // frames in between scale the last rendered static layers, and stations
+    // are only reprojected once the camera settles.
+    QTimer *animationTimer;
+    QElapsedTimer animationClock;
+    QEasingCurve animationEasing;
+    int animationDuration;
+    double animationFromScale, animationToScale;
+    QPointF animationFromPan, animationToPan;
+    bool animationAnchored; // Zooming around animationAnchor (screen) rather than panning
+    QPointF animationAnchor;
+    void animateTo(double toScale, const QPointF &toPan, int durationMs, QEasingCurve::Type easing);
+    void zoomAround(const QPointF &anchor, double toScale, int durationMs, QEasingCurve::Type easing);
+    void stopAnimation();
+    bool isAnimating() const { return animationTimer->isActive(); }
+    double targetScale() const { return isAnimating() ? animationToScale : scale; }
     
-    // Animation
-    QPropertyAnimation *zoomAnimation;
-    QPropertyAnimation *panAnimation;
+    // Prefetch: predictedPan is where panOffset is expected to be shortly
+    MapView cacheView(const QPointF &lead) const;
+    void requestPrefetch(const QPointF &predictedPan);
+    void requestFrame(const MapView &view);
+    void adoptRenderedFrame();
+    void retireFrame();
+    bool restoreCachedFrame(const MapView &view);
+    void invalidateStaticLayers();
+    
+    static const int PREFETCH_MARGIN;
+    static const int FRAME_CACHE_KILOBYTES;
+    static const int PREFETCH_LOOKAHEAD_MS;
+    static const int KINETIC_DURATION_MS;
+    static const double MIN_FLICK_SPEED;
     
     // Helper functions
-    QPointF geoToScreen(double lat, double lon);
-    void screenToGeo(const QPointF &screen, double &lat, double &lon);
+    QPointF geoToScreen(double lat, double lon) const;
+    void screenToGeo(const QPointF &screen, double &lat, double &lon) const;
     QPointF worldToScreen(const QPointF &worldPos);
     void updateStationPositions();
+    void orderStationsSpatially();
+    void reprojectGeometry();
+    
+    // Tile store for the boundary and states, rebuilt when the GeoJSON changes
+    bool openGeometryStore();
+    void buildGeometryStore();
+    QString geometrySourceStamp() const;
     void fitMapToView();
     int findStationAtPoint(const QPoint &point);
     QString truncateStationName(const QString &name, int maxLength = 10);
+    MapScene sceneSnapshot();
+    MapView currentView() const;
+    
+    // Screen bounds of the parts that change between frames, for update(QRegion)
+    QRect stationMarkerRect(int index) const;
+    QRect stationPopupRect(int index) const;
+    QRect trainSpriteRect() const;
+    QRect controlsRect() const;
+    QRect zoomMeterRect() const;
+    bool stationPopupGeometry(int index, QRect &popupRect, QPolygonF &triangle) const;
+    QFont popupFont() const;
+    void layoutControls();
     
     // Drawing functions
-    void drawIndiaBoundary(QPainter &painter);
-    void drawStateBoundaries(QPainter &painter);
-    void drawStations(QPainter &painter);
-    void drawRailwayTrack(QPainter &painter, const QPointF &start, const QPointF &end);
     void drawZoomControls(QPainter &painter);
     void drawZoomMeter(QPainter &painter);
+    void drawMemoryOverlay(QPainter &painter);
+    QStringList frameStatsLines() const;
     void drawRightDrawer(QPainter &painter);
     void drawTrain(QPainter &painter, const QPointF &position, double angle);
     
@@ -108,6 +212,7 @@ private:
     void recenterMap();
     void calculateTrainPath();
     void setupDrawerUI();
+    void setupStationComboBox(QComboBox *comboBox);
     void updateStationComboBoxes();
     
     // Constants
@@ -122,7 +227,7 @@ private:
     
     // Trip planner
     bool drawerOpen;
-    int sourceStationIndex;
+    int sourceStationIndex; // Station ids (file order)
     int destinationStationIndex;
     double trainSpeed; // Pixels per frame
     bool trainMoving;
@@ -135,6 +240,8 @@ private:
     // Drawer UI components
     QComboBox *sourceComboBox;
     QComboBox *destinationComboBox;
+    StationListModel *stationModel; // Shared by both combo boxes
+    StationSearchIndex stationSearch; // Type-ahead search in the combo boxes
     QSlider *speedSlider;
     QLabel *speedLabel;
     QPushButton *startButton;
@@ -0,0 +1,86 @@
+#include "memoryreport.h"
+
+void MemoryReport::add(const QString &subsystem, qint64 bytes, qint64 items)
+{
+    rows.append(Entry{ subsystem, bytes, items });
+}
+
+qint64 MemoryReport::totalBytes() const
+{
+    qint64 total = 0;
+    for (const Entry &entry : rows) {
+        total += entry.bytes;
+    }
+    return total;
+}
+
+QStringList MemoryReport::lines() const
+{
+    QStringList lines;
+    for (const Entry &entry : rows) {
+        QString line = QString("%1 %2 KB").arg(entry.subsystem, -16).arg(entry.bytes / 1024, 8);
+        if (entry.items >= 0) line += QString("  (%1)").arg(entry.items);
+        lines.append(line);
+    }
+    lines.append(QString("%1 %2 KB").arg("total", -16).arg(totalBytes() / 1024, 8));
+    return lines;
+}
+
+qint64 MemoryReport::bytesOf(const QString &string)
+{
+    return qint64(string.capacity()) * sizeof(QChar);
+}
+
+qint64 MemoryReport::bytesOf(const QVector<Station> &stations)
+{
+    return qint64(stations.capacity()) * sizeof(Station);
+}
+
+qint64 MemoryReport::labelBytesOf(const QVector<Station> &stations)
+{
+    qint64 bytes = 0;
+    for (const Station &station : stations) {
+        bytes += bytesOf(station.name);
+    }
+    return bytes;
+}
+
+qint64 MemoryReport::bytesOf(const QVector<QPolygonF> &polygons)
+{
+    qint64 bytes = qint64(polygons.capacity()) * sizeof(QPolygonF);
+    for (const QPolygonF &polygon : polygons) {
+        bytes += qint64(polygon.capacity()) * sizeof(QPointF);
+    }
+    return bytes;
+}
+
+qint64 MemoryReport::bytesOf(const LocalPolygon &polygon)
+{
+    qint64 bytes = qint64(polygon.points.capacity()) * sizeof(QPointF) + polygon.mesh.byteSize();
+    if (!polygon.strokes.isEmpty()) {
+        // Every point is an element of the whole path and of one chunk
+        bytes += qint64(polygon.strokes.chunks.capacity()) * sizeof(LinePath::Chunk);
+        bytes += 2 * qint64(polygon.points.size()) * sizeof(QPainterPath::Element);
+    }
+    return bytes;
+}
+
+qint64 MemoryReport::bytesOf(const QVector<LocalPolygon> &polygons)
+{
+    qint64 bytes = qint64(polygons.capacity()) * sizeof(LocalPolygon);
+    for (const LocalPolygon &polygon : polygons) {
+        bytes += bytesOf(polygon);
+    }
+    return bytes;
+}
+
+qint64 MemoryReport::bytesOf(const QVector<StateFeature> &features)
+{
+    qint64 bytes = qint64(features.capacity()) * sizeof(StateFeature);
+    for (const StateFeature &feature : features) {
+        bytes += bytesOf(feature.name) + bytesOf(feature.type);
+        bytes += bytesOf(feature.polygons) + qint64(feature.lineString.capacity()) * sizeof(QPointF);
+        bytes += bytesOf(feature.localPolygons) + bytesOf(feature.localLine);
+    }
+    return bytes;
+}
@@ -0,0 +1,46 @@
+#ifndef MEMORYREPORT_H
+#define MEMORYREPORT_H
+
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include <QPolygonF>
+#include "maprenderer.h"
+
+// Memory use of the map, broken down by subsystem.
+//
+// Datasets are measured by walking their containers: element storage at
+// capacity plus the strings, vectors and meshes each element owns. That is
+// an estimate of the heap behind them, without allocator overhead, and data
+// shared between implicitly shared copies is counted once per owner asked
+// about. Caches report their own accounting. The numbers are for spotting
+// growth between builds and runs, not for exact totals.
+class MemoryReport
+{
+public:
+    struct Entry {
+        QString subsystem;
+        qint64 bytes;
+        qint64 items; // -1 where a count does not apply
+    };
+
+    void add(const QString &subsystem, qint64 bytes, qint64 items = -1);
+    const QVector<Entry> &entries() const { return rows; }
+    qint64 totalBytes() const;
+
+    // One line per subsystem and a total, for logs and the debug overlay
+    QStringList lines() const;
+
+    static qint64 bytesOf(const QString &string);
+    static qint64 bytesOf(const QVector<Station> &stations); // Records; names are labelBytesOf()
+    static qint64 labelBytesOf(const QVector<Station> &stations);
+    static qint64 bytesOf(const QVector<QPolygonF> &polygons);
+    static qint64 bytesOf(const LocalPolygon &polygon);
+    static qint64 bytesOf(const QVector<LocalPolygon> &polygons);
+    static qint64 bytesOf(const QVector<StateFeature> &features);
+
+private:
+    QVector<Entry> rows;
+};
+
+#endif // MEMORYREPORT_H
@@ -0,0 +1,384 @@
+#include "mvtdecoder.h"
+#include <QStringList>
+#include <QtMath>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Reader over one protobuf message. Malformed input clears ok and ends the
+// reading; nothing past the buffer is ever touched.
+class ProtoReader
+{
+public:
+    explicit ProtoReader(const QByteArray &bytes)
+        : data(bytes.constData()), end(bytes.constData() + bytes.size()) {}
+    ProtoReader(const char *begin, const char *end)
+        : data(begin), end(end) {}
+
+    // Moves to the next field; false at the end or on an error
+    bool next()
+    {
+        if (!ok || data >= end) return false;
+        quint64 key = varint();
+        field = int(key >> 3);
+        wire = int(key & 7);
+        return ok;
+    }
+
+    quint64 varint()
+    {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64 && data < end; shift += 7) {
+            uchar byte = uchar(*data++);
+            value |= quint64(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        ok = false;
+        return 0;
+    }
+
+    // The length-delimited field as a reader of its own
+    ProtoReader message()
+    {
+        quint64 length = varint();
+        if (!ok || length > quint64(end - data)) {
+            ok = false;
+            return ProtoReader(end, end);
+        }
+        ProtoReader inner(data, data + length);
+        data += length;
+        return inner;
+    }
+
+    QString string()
+    {
+        ProtoReader bytes = message();
+        return QString::fromUtf8(bytes.data, int(bytes.end - bytes.data));
+    }
+
+    double fixed64()
+    {
+        double value = 0;
+        if (!take(&value, 8)) return 0;
+        return value;
+    }
+
+    float fixed32()
+    {
+        float value = 0;
+        if (!take(&value, 4)) return 0;
+        return value;
+    }
+
+    // Packed repeated varints, or a single unpacked one
+    void packed(QVector<quint32> &values)
+    {
+        if (wire == 0) {
+            values.append(quint32(varint()));
+            return;
+        }
+        ProtoReader items = message();
+        while (items.ok && items.data < items.end) values.append(quint32(items.varint()));
+        ok = ok && items.ok;
+    }
+
+    void skip()
+    {
+        switch (wire) {
+        case 0: varint(); break;
+        case 1: take(nullptr, 8); break;
+        case 2: message(); break;
+        case 5: take(nullptr, 4); break;
+        default: ok = false; break;
+        }
+    }
+
+    int field = 0;
+    int wire = 0;
+    bool ok = true;
+
+private:
+    // Little-endian fixed-size field; the decoder targets little-endian hosts
+    bool take(void *value, int size)
+    {
+        if (end - data < size) {
+            ok = false;
+            return false;
+        }
+        if (value) std::memcpy(value, data, size);
+        data += size;
+        return true;
+    }
+
+    const char *data;
+    const char *end;
+};
+
+struct RawFeature {
+    quint64 id = 0;
+    int type = 0;
+    QVector<quint32> tags;     // Key and value indices, alternating
+    QVector<quint32> commands; // Geometry command integers
+};
+
+qint64 zigzag(quint32 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+QVariant readValue(ProtoReader reader)
+{
+    QVariant value;
+    while (reader.next()) {
+        switch (reader.field) {
+        case 1: value = reader.string(); break;
+        case 2: value = double(reader.fixed32()); break;
+        case 3: value = reader.fixed64(); break;
+        case 4: value = qint64(reader.varint()); break;
+        case 5: value = quint64(reader.varint()); break;
+        case 6: {
+            quint64 raw = reader.varint();
+            value = qint64(raw >> 1) ^ -qint64(raw & 1);
+            break;
+        }
+        case 7: value = reader.varint() != 0; break;
+        default: reader.skip(); break;
+        }
+    }
+    return reader.ok ? value : QVariant();
+}
+
+RawFeature readFeature(ProtoReader reader, bool &ok)
+{
+    RawFeature feature;
+    while (reader.next()) {
+        switch (reader.field) {
+        case 1: feature.id = reader.varint(); break;
+        case 2: reader.packed(feature.tags); break;
+        case 3: feature.type = int(reader.varint()); break;
+        case 4: reader.packed(feature.commands); break;
+        default: reader.skip(); break;
+        }
+    }
+    ok = reader.ok;
+    return feature;
+}
+
+// Surveyor's formula in tile coordinates (y down): positive for exterior rings
+double ringArea(const QPolygonF &ring)
+{
+    double area = 0;
+    for (int i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+        area += ring[j].x() * ring[i].y() - ring[i].x() * ring[j].y();
+    }
+    return area / 2;
+}
+
+// Commands carry their id in the low three bits and a repeat count above;
+// MoveTo and LineTo parameters are zigzag-encoded deltas from the cursor
+bool decodeGeometry(const QVector<quint32> &commands, MvtDecoder::GeometryType type, QVector<QPolygonF> &parts)
+{
+    enum { MoveTo = 1, LineTo = 2, ClosePath = 7 };
+    qint64 cursorX = 0, cursorY = 0;
+    QPolygonF current;
+    auto finish = [&]() {
+        if (type == MvtDecoder::LineString ? current.size() > 1 : !current.isEmpty()) parts.append(current);
+        current.clear();
+    };
+
+    for (int i = 0; i < commands.size();) {
+        int command = int(commands[i] & 7);
+        int count = int(commands[i] >> 3);
+        ++i;
+        if (command == MoveTo || command == LineTo) {
+            if (count > (commands.size() - i) / 2) return false;
+            for (int c = 0; c < count; ++c, i += 2) {
+                cursorX += zigzag(commands[i]);
+                cursorY += zigzag(commands[i + 1]);
+                if (command == MoveTo && type == MvtDecoder::LineString) finish();
+                if (command == MoveTo && type == MvtDecoder::Polygon) current.clear(); // Rings count once closed
+                current << QPointF(cursorX, cursorY);
+            }
+        } else if (command == ClosePath) {
+            if (type != MvtDecoder::Polygon || current.size() < 3) return false;
+            current << current.first();
+            finish();
+        } else {
+            return false;
+        }
+    }
+    if (type == MvtDecoder::Polygon) current.clear();
+    finish();
+
+    // Interior rings (negative area) and degenerate ones are dropped
+    if (type == MvtDecoder::Polygon) {
+        QVector<QPolygonF> exteriors;
+        for (const QPolygonF &ring : parts) {
+            if (ringArea(ring) > 0) exteriors.append(ring);
+        }
+        parts = exteriors;
+    }
+    return true;
+}
+
+// Sutherland-Hodgman against the tile square; the result may run along the
+// tile edges, which is harmless for filling
+QPolygonF clipRing(const QPolygonF &ring, int extent)
+{
+    QPolygonF clipped = ring;
+    if (clipped.size() > 1 && clipped.first() == clipped.last()) clipped.removeLast();
+    for (int side = 0; side < 4 && !clipped.isEmpty(); ++side) {
+        // Sides: x >= 0, x <= extent, y >= 0, y <= extent
+        bool vertical = side < 2;
+        double edge = side % 2 ? extent : 0;
+        auto inside = [&](const QPointF &point) {
+            double value = vertical ? point.x() : point.y();
+            return side % 2 ? value <= edge : value >= edge;
+        };
+        auto crossing = [&](const QPointF &a, const QPointF &b) {
+            double t = vertical ? (edge - a.x()) / (b.x() - a.x()) : (edge - a.y()) / (b.y() - a.y());
+            QPointF point = a + (b - a) * t;
+            (vertical ? point.rx() : point.ry()) = edge; // Exactly on the side
+            return point;
+        };
+
+        QPolygonF input = clipped;
+        clipped.clear();
+        for (int i = 0; i < input.size(); ++i) {
+            const QPointF &current = input[i];
+            const QPointF &previous = input[(i + input.size() - 1) % input.size()];
+            if (inside(current)) {
+                if (!inside(previous)) clipped << crossing(previous, current);
+                clipped << current;
+            } else if (inside(previous)) {
+                clipped << crossing(previous, current);
+            }
+        }
+    }
+    if (clipped.size() < 3) return QPolygonF();
+    clipped << clipped.first();
+    return clipped;
+}
+
+bool onTileEdge(const QPointF &a, const QPointF &b, int extent)
+{
+    return (a.x() == b.x() && (a.x() == 0 || a.x() == extent))
+        || (a.y() == b.y() && (a.y() == 0 || a.y() == extent));
+}
+
+// Tile sets clip polygons at the tile edges, with a buffer. The fills are
+// cut back to the tile so neighbours meet without overlapping, and the
+// outlines leave out the cut, so no tile grid shows through the borders.
+void clipToTile(MvtDecoder::Feature &feature, int extent)
+{
+    QVector<QPolygonF> fills;
+    for (const QPolygonF &ring : feature.parts) {
+        QPolygonF fill = clipRing(ring, extent);
+        if (fill.isEmpty() || ringArea(fill) <= 0) continue;
+        fills.append(fill);
+
+        // Runs between edges along the tile border; starting after such an
+        // edge, so no run is split at the ring's first point
+        int edges = fill.size() - 1;
+        int start = 0;
+        while (start < edges && !onTileEdge(fill[start], fill[start + 1], extent)) ++start;
+        if (start == edges) {
+            feature.outlines.append(fill);
+            continue;
+        }
+        QPolygonF run;
+        for (int e = 1; e <= edges; ++e) {
+            int i = (start + e) % edges;
+            const QPointF &a = fill[i], &b = fill[i + 1];
+            if (onTileEdge(a, b, extent)) {
+                if (run.size() > 1) feature.outlines.append(run);
+                run.clear();
+                continue;
+            }
+            if (run.isEmpty()) run << a;
+            run << b;
+        }
+        if (run.size() > 1) feature.outlines.append(run);
+    }
+    feature.parts = fills;
+}
+
+} // namespace
+
+bool MvtDecoder::decode(const QByteArray &data, int z, int x, int y, QVector<Layer> &layers, QString *error)
+{
+    auto fail = [&](const QString &message) {
+        if (error) *error = message;
+        return false;
+    };
+    if (data.size() >= 2 && uchar(data[0]) == 0x1f && uchar(data[1]) == 0x8b) {
+        return fail("gzip-compressed tile");
+    }
+
+    ProtoReader tile(data);
+    while (tile.next()) {
+        if (tile.field != 3 || tile.wire != 2) {
+            tile.skip();
+            continue;
+        }
+
+        // Features may come before the keys and values they refer to
+        ProtoReader reader = tile.message();
+        Layer layer;
+        QStringList keys;
+        QVector<QVariant> values;
+        QVector<RawFeature> rawFeatures;
+        while (reader.next()) {
+            switch (reader.field) {
+            case 1: layer.name = reader.string(); break;
+            case 2: {
+                bool ok = false;
+                rawFeatures.append(readFeature(reader.message(), ok));
+                if (!ok) return fail(QString("malformed feature in layer \"%1\"").arg(layer.name));
+                break;
+            }
+            case 3: keys.append(reader.string()); break;
+            case 4: values.append(readValue(reader.message())); break;
+            case 5: layer.extent = int(reader.varint()); break;
+            default: reader.skip(); break;
+            }
+        }
+        if (!reader.ok || layer.extent <= 0) return fail(QString("malformed layer \"%1\"").arg(layer.name));
+
+        for (const RawFeature &raw : rawFeatures) {
+            Feature feature;
+            feature.id = raw.id;
+            feature.type = raw.type >= Point && raw.type <= Polygon ? GeometryType(raw.type) : Unknown;
+            for (int t = 0; t + 1 < raw.tags.size(); t += 2) {
+                if (raw.tags[t] < quint32(keys.size()) && raw.tags[t + 1] < quint32(values.size())) {
+                    feature.properties.insert(keys[int(raw.tags[t])], values[int(raw.tags[t + 1])]);
+                }
+            }
+            if (feature.type == Unknown || !decodeGeometry(raw.commands, feature.type, feature.parts)) continue;
+            if (feature.type == Polygon) clipToTile(feature, layer.extent);
+
+            // Grid -> lon/lat
+            for (QVector<QPolygonF> *parts : { &feature.parts, &feature.outlines }) {
+                for (QPolygonF &part : *parts) {
+                    for (QPointF &point : part) {
+                        point = tileToGeo(point.x(), point.y(), layer.extent, z, x, y);
+                    }
+                }
+            }
+            if (!feature.parts.isEmpty()) layer.features.append(feature);
+        }
+        layers.append(layer);
+    }
+    if (!tile.ok) return fail("malformed tile");
+    return true;
+}
+
+QPointF MvtDecoder::tileToGeo(double px, double py, int extent, int z, int x, int y)
+{
+    double tiles = std::ldexp(1.0, z);
+    double u = (x + px / extent) / tiles;
+    double v = (y + py / extent) / tiles;
+    double lat = std::atan(std::sinh(M_PI * (1 - 2 * v))) * 180.0 / M_PI;
+    return QPointF(u * 360.0 - 180.0, lat);
+}
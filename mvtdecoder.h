@@ -0,0 +1,50 @@
+#ifndef MVTDECODER_H
+#define MVTDECODER_H
+
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+#include <QVariantHash>
+#include <QPolygonF>
+
+// Decoder for Mapbox Vector Tiles (the version 2 protobuf encoding).
+//
+// The protobuf wire format is read directly; there is no generated code and
+// no protobuf library. Geometry comes out in lon/lat, mapped from the tile's
+// integer grid through the XYZ Web Mercator tiling scheme the tile sets use
+// (y counted down from the north edge), so decoded features can take the
+// same path as GeoJSON ones. Polygons keep their exterior rings only, as the
+// GeoJSON loader does, cut back to the tile; their outlines come separately,
+// without the cuts along the tile edges. Tiles must not be gzip-compressed.
+class MvtDecoder
+{
+public:
+    enum GeometryType { Unknown = 0, Point = 1, LineString = 2, Polygon = 3 };
+
+    struct Feature {
+        quint64 id = 0; // 0 when the tile gives none
+        GeometryType type = Unknown;
+        QVariantHash properties;
+        // Lon/lat: every point in one part, one part per line, or one
+        // closed exterior ring per polygon
+        QVector<QPolygonF> parts;
+        // Polygons only: the ring edges that are not on the tile border, as
+        // open runs. Border edges are where the tile set cut the polygon.
+        QVector<QPolygonF> outlines;
+    };
+
+    struct Layer {
+        QString name;
+        int extent = 4096; // Grid units across the tile
+        QVector<Feature> features;
+    };
+
+    // Layers of tile (z, x, y); false (with a reason) if data is not a
+    // readable tile
+    static bool decode(const QByteArray &data, int z, int x, int y, QVector<Layer> &layers, QString *error = nullptr);
+
+    // Lon/lat of grid position (px, py) in tile (z, x, y)
+    static QPointF tileToGeo(double px, double py, int extent, int z, int x, int y);
+};
+
+#endif // MVTDECODER_H
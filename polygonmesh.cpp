@@ -0,0 +1,594 @@
+#include "polygonmesh.h"
+#include <QtMath>
+#include <cmath>
+
+const int PolygonMesh::TRIANGLES_PER_BUCKET = 8;
+const int PolygonMesh::MAX_BUCKETS_PER_SIDE = 64;
+
+// Rings up to this size skip the z-order hash; a plain scan is cheaper
+static const int HASH_MIN_POINTS = 80;
+
+namespace {
+
+// Ear clipping over a circular doubly linked list of ring vertices, after
+// the approach of Mapbox's earcut: candidate points are found through a
+// z-order sorted list, and rings that get stuck are filtered, cured of
+// local self-intersections and finally split along a valid diagonal.
+class EarClipper
+{
+public:
+    EarClipper(const QPolygonF &ring, QVector<int> &triangles);
+
+private:
+    struct Node {
+        int index;   // Ring vertex
+        double x, y;
+        int prev, next;
+        qint32 z;
+        int prevZ, nextZ;
+    };
+
+    int insertNode(int index, const QPointF &point, int last);
+    void removeNode(int p);
+    int filterPoints(int start, int end = -1);
+    void earcutLinked(int ear, int pass);
+    bool isEar(int ear) const;
+    bool isEarHashed(int ear) const;
+    int cureLocalIntersections(int start);
+    void splitEarcut(int start);
+    void indexCurve(int start);
+    void sortLinked(int list);
+    qint32 zOrder(double x, double y) const;
+
+    double area(int p, int q, int r) const;
+    bool equals(int a, int b) const;
+    bool intersects(int p1, int q1, int p2, int q2) const;
+    bool intersectsPolygon(int a, int b) const;
+    bool locallyInside(int a, int b) const;
+    bool middleInside(int a, int b) const;
+    bool isValidDiagonal(int a, int b) const;
+    int splitPolygon(int a, int b);
+    void emitTriangle(int a, int b, int c);
+
+    QVector<Node> nodes;
+    QVector<int> &triangles;
+    double minX, minY, invSize; // invSize 0 disables hashing
+};
+
+bool pointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py)
+{
+    return (cx - px) * (ay - py) >= (ax - px) * (cy - py)
+        && (ax - px) * (by - py) >= (bx - px) * (ay - py)
+        && (bx - px) * (cy - py) >= (cx - px) * (by - py);
+}
+
+int sign(double value)
+{
+    return value > 0 ? 1 : (value < 0 ? -1 : 0);
+}
+
+EarClipper::EarClipper(const QPolygonF &ring, QVector<int> &triangles)
+    : triangles(triangles)
+    , minX(0.0)
+    , minY(0.0)
+    , invSize(0.0)
+{
+    int count = ring.size();
+    if (ring.size() > 1 && ring.first() == ring.last()) --count; // GeoJSON rings repeat the first point
+    if (count < 3) return;
+    nodes.reserve(count + count / 4);
+
+    // Wind the list one way whatever the input orientation
+    double signedArea = 0;
+    for (int i = 0, j = count - 1; i < count; j = i++) {
+        signedArea += (ring[j].x() - ring[i].x()) * (ring[i].y() + ring[j].y());
+    }
+    int last = -1;
+    if (signedArea > 0) {
+        for (int i = 0; i < count; ++i) last = insertNode(i, ring[i], last);
+    } else {
+        for (int i = count - 1; i >= 0; --i) last = insertNode(i, ring[i], last);
+    }
+    if (last >= 0 && equals(last, nodes[last].next)) {
+        int next = nodes[last].next;
+        removeNode(last);
+        last = next;
+    }
+
+    if (count > HASH_MIN_POINTS) {
+        double maxX = ring[0].x(), maxY = ring[0].y();
+        minX = maxX;
+        minY = maxY;
+        for (int i = 1; i < count; ++i) {
+            minX = qMin(minX, ring[i].x());
+            minY = qMin(minY, ring[i].y());
+            maxX = qMax(maxX, ring[i].x());
+            maxY = qMax(maxY, ring[i].y());
+        }
+        double size = qMax(maxX - minX, maxY - minY);
+        invSize = size != 0.0 ? 32767.0 / size : 0.0;
+    }
+
+    earcutLinked(last, 0);
+}
+
+int EarClipper::insertNode(int index, const QPointF &point, int last)
+{
+    Node node;
+    node.index = index;
+    node.x = point.x();
+    node.y = point.y();
+    node.z = 0;
+    node.prevZ = node.nextZ = -1;
+    int p = nodes.size();
+    if (last < 0) {
+        node.prev = node.next = p;
+        nodes.append(node);
+    } else {
+        node.next = nodes[last].next;
+        node.prev = last;
+        nodes.append(node);
+        nodes[nodes[p].next].prev = p;
+        nodes[last].next = p;
+    }
+    return p;
+}
+
+void EarClipper::removeNode(int p)
+{
+    Node &node = nodes[p];
+    nodes[node.next].prev = node.prev;
+    nodes[node.prev].next = node.next;
+    if (node.prevZ >= 0) nodes[node.prevZ].nextZ = node.nextZ;
+    if (node.nextZ >= 0) nodes[node.nextZ].prevZ = node.prevZ;
+}
+
+void EarClipper::emitTriangle(int a, int b, int c)
+{
+    triangles << nodes[a].index << nodes[b].index << nodes[c].index;
+}
+
+double EarClipper::area(int p, int q, int r) const
+{
+    const Node &a = nodes[p], &b = nodes[q], &c = nodes[r];
+    return (b.y - a.y) * (c.x - b.x) - (b.x - a.x) * (c.y - b.y);
+}
+
+bool EarClipper::equals(int a, int b) const
+{
+    return nodes[a].x == nodes[b].x && nodes[a].y == nodes[b].y;
+}
+
+// Drops duplicate and collinear points
+int EarClipper::filterPoints(int start, int end)
+{
+    if (start < 0) return start;
+    if (end < 0) end = start;
+
+    int p = start;
+    bool again;
+    do {
+        again = false;
+        if (equals(p, nodes[p].next) || area(nodes[p].prev, p, nodes[p].next) == 0) {
+            int prev = nodes[p].prev;
+            removeNode(p);
+            p = end = prev;
+            if (p == nodes[p].next) break;
+            again = true;
+        } else {
+            p = nodes[p].next;
+        }
+    } while (again || p != end);
+    return end;
+}
+
+void EarClipper::earcutLinked(int ear, int pass)
+{
+    if (ear < 0) return;
+    if (pass == 0 && invSize != 0.0) indexCurve(ear);
+
+    int stop = ear;
+    while (nodes[ear].prev != nodes[ear].next) {
+        int prev = nodes[ear].prev, next = nodes[ear].next;
+
+        if (invSize != 0.0 ? isEarHashed(ear) : isEar(ear)) {
+            emitTriangle(prev, ear, next);
+            removeNode(ear);
+            ear = stop = nodes[next].next;
+            continue;
+        }
+
+        ear = next;
+        if (ear == stop) {
+            // No ear found in a full turn: progressively more forgiving passes
+            if (pass == 0) {
+                earcutLinked(filterPoints(ear), 1);
+            } else if (pass == 1) {
+                earcutLinked(cureLocalIntersections(filterPoints(ear)), 2);
+            } else {
+                splitEarcut(ear);
+            }
+            break;
+        }
+    }
+}
+
+bool EarClipper::isEar(int ear) const
+{
+    int a = nodes[ear].prev, b = ear, c = nodes[ear].next;
+    if (area(a, b, c) >= 0) return false; // Reflex
+
+    const Node &na = nodes[a], &nb = nodes[b], &nc = nodes[c];
+    double x0 = qMin(na.x, qMin(nb.x, nc.x)), y0 = qMin(na.y, qMin(nb.y, nc.y));
+    double x1 = qMax(na.x, qMax(nb.x, nc.x)), y1 = qMax(na.y, qMax(nb.y, nc.y));
+
+    for (int p = nodes[c].next; p != a; p = nodes[p].next) {
+        const Node &np = nodes[p];
+        if (np.x >= x0 && np.x <= x1 && np.y >= y0 && np.y <= y1
+            && pointInTriangle(na.x, na.y, nb.x, nb.y, nc.x, nc.y, np.x, np.y)
+            && area(np.prev, p, np.next) >= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool EarClipper::isEarHashed(int ear) const
+{
+    int a = nodes[ear].prev, b = ear, c = nodes[ear].next;
+    if (area(a, b, c) >= 0) return false;
+
+    const Node &na = nodes[a], &nb = nodes[b], &nc = nodes[c];
+    double x0 = qMin(na.x, qMin(nb.x, nc.x)), y0 = qMin(na.y, qMin(nb.y, nc.y));
+    double x1 = qMax(na.x, qMax(nb.x, nc.x)), y1 = qMax(na.y, qMax(nb.y, nc.y));
+    qint32 minZ = zOrder(x0, y0), maxZ = zOrder(x1, y1);
+
+    auto blocks = [&](int p) {
+        const Node &np = nodes[p];
+        return np.x >= x0 && np.x <= x1 && np.y >= y0 && np.y <= y1 && p != a && p != c
+            && pointInTriangle(na.x, na.y, nb.x, nb.y, nc.x, nc.y, np.x, np.y)
+            && area(np.prev, p, np.next) >= 0;
+    };
+
+    // Only points whose z-order lies within the triangle's bbox range matter
+    int p = nodes[ear].prevZ, n = nodes[ear].nextZ;
+    while (p >= 0 && nodes[p].z >= minZ && n >= 0 && nodes[n].z <= maxZ) {
+        if (blocks(p)) return false;
+        p = nodes[p].prevZ;
+        if (blocks(n)) return false;
+        n = nodes[n].nextZ;
+    }
+    while (p >= 0 && nodes[p].z >= minZ) {
+        if (blocks(p)) return false;
+        p = nodes[p].prevZ;
+    }
+    while (n >= 0 && nodes[n].z <= maxZ) {
+        if (blocks(n)) return false;
+        n = nodes[n].nextZ;
+    }
+    return true;
+}
+
+int EarClipper::cureLocalIntersections(int start)
+{
+    int p = start;
+    do {
+        int a = nodes[p].prev, b = nodes[nodes[p].next].next;
+        if (!equals(a, b) && intersects(a, p, nodes[p].next, b) && locallyInside(a, b) && locallyInside(b, a)) {
+            emitTriangle(a, p, b);
+            int next = nodes[p].next;
+            removeNode(p);
+            removeNode(next);
+            p = start = b;
+        }
+        p = nodes[p].next;
+    } while (p != start);
+    return filterPoints(p);
+}
+
+void EarClipper::splitEarcut(int start)
+{
+    int a = start;
+    do {
+        int b = nodes[nodes[a].next].next;
+        while (b != nodes[a].prev) {
+            if (nodes[a].index != nodes[b].index && isValidDiagonal(a, b)) {
+                int c = splitPolygon(a, b);
+                a = filterPoints(a, nodes[a].next);
+                c = filterPoints(c, nodes[c].next);
+                earcutLinked(a, 0);
+                earcutLinked(c, 0);
+                return;
+            }
+            b = nodes[b].next;
+        }
+        a = nodes[a].next;
+    } while (a != start);
+}
+
+void EarClipper::indexCurve(int start)
+{
+    int p = start;
+    do {
+        if (nodes[p].z == 0) nodes[p].z = zOrder(nodes[p].x, nodes[p].y);
+        nodes[p].prevZ = nodes[p].prev;
+        nodes[p].nextZ = nodes[p].next;
+        p = nodes[p].next;
+    } while (p != start);
+
+    nodes[nodes[p].prevZ].nextZ = -1;
+    nodes[p].prevZ = -1;
+    sortLinked(p);
+}
+
+// Bottom-up merge sort of the z list (Simon Tatham's linked list sort)
+void EarClipper::sortLinked(int list)
+{
+    int inSize = 1;
+    int numMerges;
+    do {
+        int p = list, tail = -1;
+        list = -1;
+        numMerges = 0;
+
+        while (p >= 0) {
+            ++numMerges;
+            int q = p, pSize = 0;
+            for (int i = 0; i < inSize; ++i) {
+                ++pSize;
+                q = nodes[q].nextZ;
+                if (q < 0) break;
+            }
+            int qSize = inSize;
+
+            while (pSize > 0 || (qSize > 0 && q >= 0)) {
+                int e;
+                if (pSize != 0 && (qSize == 0 || q < 0 || nodes[p].z <= nodes[q].z)) {
+                    e = p;
+                    p = nodes[p].nextZ;
+                    --pSize;
+                } else {
+                    e = q;
+                    q = nodes[q].nextZ;
+                    --qSize;
+                }
+                if (tail >= 0) nodes[tail].nextZ = e;
+                else list = e;
+                nodes[e].prevZ = tail;
+                tail = e;
+            }
+            p = q;
+        }
+        nodes[tail].nextZ = -1;
+        inSize *= 2;
+    } while (numMerges > 1);
+}
+
+qint32 EarClipper::zOrder(double px, double py) const
+{
+    // Interleave 15-bit coordinates into a Morton code
+    qint32 x = qint32((px - minX) * invSize);
+    qint32 y = qint32((py - minY) * invSize);
+    x = (x | (x << 8)) & 0x00FF00FF;
+    x = (x | (x << 4)) & 0x0F0F0F0F;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    y = (y | (y << 8)) & 0x00FF00FF;
+    y = (y | (y << 4)) & 0x0F0F0F0F;
+    y = (y | (y << 2)) & 0x33333333;
+    y = (y | (y << 1)) & 0x55555555;
+    return x | (y << 1);
+}
+
+bool EarClipper::intersects(int p1, int q1, int p2, int q2) const
+{
+    auto onSegment = [this](int p, int q, int r) {
+        return nodes[q].x <= qMax(nodes[p].x, nodes[r].x) && nodes[q].x >= qMin(nodes[p].x, nodes[r].x)
+            && nodes[q].y <= qMax(nodes[p].y, nodes[r].y) && nodes[q].y >= qMin(nodes[p].y, nodes[r].y);
+    };
+
+    int o1 = sign(area(p1, q1, p2)), o2 = sign(area(p1, q1, q2));
+    int o3 = sign(area(p2, q2, p1)), o4 = sign(area(p2, q2, q1));
+    if (o1 != o2 && o3 != o4) return true;
+    if (o1 == 0 && onSegment(p1, p2, q1)) return true;
+    if (o2 == 0 && onSegment(p1, q2, q1)) return true;
+    if (o3 == 0 && onSegment(p2, p1, q2)) return true;
+    if (o4 == 0 && onSegment(p2, q1, q2)) return true;
+    return false;
+}
+
+bool EarClipper::intersectsPolygon(int a, int b) const
+{
+    int ia = nodes[a].index, ib = nodes[b].index;
+    int p = a;
+    do {
+        int next = nodes[p].next;
+        if (nodes[p].index != ia && nodes[next].index != ia && nodes[p].index != ib && nodes[next].index != ib
+            && intersects(p, next, a, b)) {
+            return true;
+        }
+        p = next;
+    } while (p != a);
+    return false;
+}
+
+bool EarClipper::locallyInside(int a, int b) const
+{
+    int prev = nodes[a].prev, next = nodes[a].next;
+    return area(prev, a, next) < 0
+        ? area(a, b, next) >= 0 && area(a, prev, b) >= 0
+        : area(a, b, prev) < 0 || area(a, next, b) < 0;
+}
+
+bool EarClipper::middleInside(int a, int b) const
+{
+    double px = (nodes[a].x + nodes[b].x) / 2, py = (nodes[a].y + nodes[b].y) / 2;
+    bool inside = false;
+    int p = a;
+    do {
+        const Node &np = nodes[p], &nn = nodes[np.next];
+        if ((np.y > py) != (nn.y > py) && nn.y != np.y
+            && px < (nn.x - np.x) * (py - np.y) / (nn.y - np.y) + np.x) {
+            inside = !inside;
+        }
+        p = np.next;
+    } while (p != a);
+    return inside;
+}
+
+bool EarClipper::isValidDiagonal(int a, int b) const
+{
+    const Node &na = nodes[a], &nb = nodes[b];
+    if (nodes[na.next].index == nb.index || nodes[na.prev].index == nb.index || intersectsPolygon(a, b)) {
+        return false;
+    }
+    if (locallyInside(a, b) && locallyInside(b, a) && middleInside(a, b)
+        && (area(na.prev, a, nb.prev) != 0 || area(a, nb.prev, b) != 0)) {
+        return true;
+    }
+    return equals(a, b) && area(na.prev, a, na.next) > 0 && area(nb.prev, b, nb.next) > 0;
+}
+
+// Links a and b with a bridge, returning the new node of the split-off ring
+int EarClipper::splitPolygon(int a, int b)
+{
+    Node a2 = nodes[a], b2 = nodes[b];
+    a2.z = b2.z = 0;
+    a2.prevZ = a2.nextZ = b2.prevZ = b2.nextZ = -1;
+    int ia2 = nodes.size(), ib2 = ia2 + 1;
+    int an = nodes[a].next, bp = nodes[b].prev;
+
+    nodes.append(a2);
+    nodes.append(b2);
+
+    nodes[a].next = b;
+    nodes[b].prev = a;
+
+    nodes[ia2].next = an;
+    nodes[an].prev = ia2;
+
+    nodes[ib2].next = ia2;
+    nodes[ia2].prev = ib2;
+
+    nodes[bp].next = ib2;
+    nodes[ib2].prev = bp;
+
+    return ib2;
+}
+
+} // namespace
+
+PolygonMesh::PolygonMesh()
+    : columns(0)
+    , rows(0)
+    , bucketWidth(1.0)
+    , bucketHeight(1.0)
+{
+}
+
+PolygonMesh::PolygonMesh(const QPolygonF &ring)
+    : PolygonMesh()
+{
+    indices = triangulate(ring);
+    buildBuckets(ring);
+}
+
+qint64 PolygonMesh::byteSize() const
+{
+    return qint64(indices.capacity()) * sizeof(int)
+        + qint64(triangleBuckets.capacity()) * sizeof(BucketRange)
+        + qint64(bucketStart.capacity() + bucketTriangles.capacity()) * sizeof(int);
+}
+
+QVector<int> PolygonMesh::triangulate(const QPolygonF &ring)
+{
+    QVector<int> triangles;
+    EarClipper clipper(ring, triangles);
+    return triangles;
+}
+
+void PolygonMesh::buildBuckets(const QPolygonF &ring)
+{
+    int count = triangleCount();
+    if (count == 0) return;
+
+    bounds = ring.boundingRect();
+    int side = qBound(1, int(std::sqrt(double(count) / TRIANGLES_PER_BUCKET)), MAX_BUCKETS_PER_SIDE);
+    columns = rows = side;
+    bucketWidth = bounds.width() > 0 ? bounds.width() / columns : 1.0;
+    bucketHeight = bounds.height() > 0 ? bounds.height() / rows : 1.0;
+
+    auto column = [&](double x) { return qBound(0, int((x - bounds.left()) / bucketWidth), columns - 1); };
+    auto row = [&](double y) { return qBound(0, int((y - bounds.top()) / bucketHeight), rows - 1); };
+
+    // A triangle is listed in every bucket its bounding box touches
+    triangleBuckets.resize(count);
+    bucketStart.fill(0, columns * rows + 1);
+    for (int t = 0; t < count; ++t) {
+        const QPointF &a = ring[indices[3 * t]], &b = ring[indices[3 * t + 1]], &c = ring[indices[3 * t + 2]];
+        BucketRange &range = triangleBuckets[t];
+        range.x0 = quint16(column(qMin(a.x(), qMin(b.x(), c.x()))));
+        range.x1 = quint16(column(qMax(a.x(), qMax(b.x(), c.x()))));
+        range.y0 = quint16(row(qMin(a.y(), qMin(b.y(), c.y()))));
+        range.y1 = quint16(row(qMax(a.y(), qMax(b.y(), c.y()))));
+        for (int y = range.y0; y <= range.y1; ++y) {
+            for (int x = range.x0; x <= range.x1; ++x) ++bucketStart[y * columns + x + 1];
+        }
+    }
+    for (int b = 0; b < columns * rows; ++b) bucketStart[b + 1] += bucketStart[b];
+
+    bucketTriangles.resize(bucketStart.last());
+    QVector<int> cursor = bucketStart;
+    for (int t = 0; t < count; ++t) {
+        const BucketRange &range = triangleBuckets[t];
+        for (int y = range.y0; y <= range.y1; ++y) {
+            for (int x = range.x0; x <= range.x1; ++x) bucketTriangles[cursor[y * columns + x]++] = t;
+        }
+    }
+}
+
+int PolygonMesh::fill(QPainter &painter, const QPolygonF &ring, const QPointF &origin, double pixelsPerUnit,
+                      const QRectF &screenRect) const
+{
+    if (isEmpty() || pixelsPerUnit <= 0.0) return 0;
+
+    // Screen rect in ring coordinates (y flips: north up)
+    QRectF local(QPointF((screenRect.left() - origin.x()) / pixelsPerUnit, (origin.y() - screenRect.bottom()) / pixelsPerUnit),
+                 QPointF((screenRect.right() - origin.x()) / pixelsPerUnit, (origin.y() - screenRect.top()) / pixelsPerUnit));
+    if (!local.intersects(bounds)) return 0;
+
+    QPointF triangle[3];
+    auto drawTriangle = [&](int t) {
+        for (int k = 0; k < 3; ++k) {
+            const QPointF &p = ring[indices[3 * t + k]];
+            triangle[k] = QPointF(origin.x() + p.x() * pixelsPerUnit, origin.y() - p.y() * pixelsPerUnit);
+        }
+        painter.drawConvexPolygon(triangle, 3);
+    };
+
+    if (local.contains(bounds)) {
+        for (int t = 0; t < triangleCount(); ++t) drawTriangle(t);
+        return triangleCount();
+    }
+
+    int qx0 = qBound(0, int((local.left() - bounds.left()) / bucketWidth), columns - 1);
+    int qx1 = qBound(0, int((local.right() - bounds.left()) / bucketWidth), columns - 1);
+    int qy0 = qBound(0, int((local.top() - bounds.top()) / bucketHeight), rows - 1);
+    int qy1 = qBound(0, int((local.bottom() - bounds.top()) / bucketHeight), rows - 1);
+
+    int drawn = 0;
+    for (int y = qy0; y <= qy1; ++y) {
+        for (int x = qx0; x <= qx1; ++x) {
+            int bucket = y * columns + x;
+            for (int k = bucketStart[bucket]; k < bucketStart[bucket + 1]; ++k) {
+                int t = bucketTriangles[k];
+                // Draw each triangle once: in the first queried bucket it covers
+                const BucketRange &range = triangleBuckets[t];
+                if (x != qMax(int(range.x0), qx0) || y != qMax(int(range.y0), qy0)) continue;
+                drawTriangle(t);
+                ++drawn;
+            }
+        }
+    }
+    return drawn;
+}
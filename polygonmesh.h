@@ -0,0 +1,58 @@
+#ifndef POLYGONMESH_H
+#define POLYGONMESH_H
+
+#include <QVector>
+#include <QPointF>
+#include <QRectF>
+#include <QPolygonF>
+#include <QPainter>
+
+// Triangle mesh of a simple polygon, built once by ear clipping (with a
+// z-order hash so large boundaries triangulate in near-linear time).
+//
+// Triangles are bucketed on a coarse grid over the polygon bounds so a
+// zoomed-in view fills only the triangles it can see, without walking or
+// clipping the whole outline. Coordinates are those of the polygon the mesh
+// was built from (LocalPolygon points, i.e. relative to its origin).
+class PolygonMesh
+{
+public:
+    PolygonMesh();
+    explicit PolygonMesh(const QPolygonF &ring);
+
+    bool isEmpty() const { return indices.isEmpty(); }
+    int triangleCount() const { return indices.size() / 3; }
+    const QVector<int> &triangles() const { return indices; } // Index triples into the ring
+    qint64 byteSize() const; // Triangles and buckets
+
+    // Fills the triangles that overlap screenRect. A ring point p lands on
+    // screen at (origin.x + p.x * ppu, origin.y - p.y * ppu). Uses the
+    // current brush; antialiasing should be off so shared edges do not
+    // blend twice. Returns the number of triangles drawn.
+    int fill(QPainter &painter, const QPolygonF &ring, const QPointF &origin, double pixelsPerUnit,
+             const QRectF &screenRect) const;
+
+    static QVector<int> triangulate(const QPolygonF &ring);
+
+private:
+    struct BucketRange {
+        quint16 x0, y0, x1, y1;
+    };
+
+    void buildBuckets(const QPolygonF &ring);
+
+    QVector<int> indices;
+    QRectF bounds;
+    int columns;
+    int rows;
+    double bucketWidth;
+    double bucketHeight;
+    QVector<BucketRange> triangleBuckets; // Per triangle
+    QVector<int> bucketStart;             // Bucket b holds bucketTriangles[bucketStart[b] .. bucketStart[b + 1])
+    QVector<int> bucketTriangles;
+
+    static const int TRIANGLES_PER_BUCKET;
+    static const int MAX_BUCKETS_PER_SIDE;
+};
+
+#endif // POLYGONMESH_H
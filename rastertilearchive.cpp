@@ -0,0 +1,151 @@
+#include "rastertilearchive.h"
+#include <QBuffer>
+#include <QDataStream>
+#include <QDebug>
+#include <cmath>
+#include <climits>
+
+const int RasterTileArchive::MAX_LEVEL = 24;
+
+static const quint32 FORMAT_VERSION = 1;
+static const double WORLD_SPAN = 360.0; // Projected units covered by level 0
+
+RasterTileArchive::Writer::Writer(const QString &path, MapProjection::Type projection, int tileSize)
+    : pages(path)
+    , projection(projection)
+    , tileSize(tileSize)
+    , minLevel(INT_MAX)
+    , maxLevel(-1)
+{
+}
+
+void RasterTileArchive::Writer::addTile(int level, int x, int y, const QImage &image)
+{
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    if (!image.save(&buffer, "PNG")) {
+        qWarning() << "Could not encode tile" << level << x << y;
+        return;
+    }
+    pages.addPage(tileKey(level, x, y), png);
+    minLevel = qMin(minLevel, level);
+    maxLevel = qMax(maxLevel, level);
+}
+
+bool RasterTileArchive::Writer::finish()
+{
+    QByteArray metadata;
+    QDataStream stream(&metadata, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << FORMAT_VERSION << qint32(projection) << qint32(tileSize)
+           << qint32(maxLevel < 0 ? 0 : minLevel) << qint32(maxLevel);
+    return pages.finish(metadata);
+}
+
+RasterTileArchive::RasterTileArchive()
+    : projectionType(MapProjection::Equirectangular)
+    , size(0)
+    , minLevel(0)
+    , maxLevel(-1)
+    , cache(64 * 1024) // Kilobytes
+{
+}
+
+bool RasterTileArchive::open(const QString &path)
+{
+    close();
+
+    QMutexLocker locker(&mutex);
+    if (!pages.open(path, true)) return false;
+
+    QDataStream stream(pages.metadata());
+    stream.setVersion(QDataStream::Qt_5_12);
+    quint32 version = 0;
+    qint32 projection = 0, tileSize = 0, first = 0, last = -1;
+    stream >> version >> projection >> tileSize >> first >> last;
+    if (version != FORMAT_VERSION || stream.status() != QDataStream::Ok || tileSize <= 0
+        || projection < MapProjection::Equirectangular || projection > MapProjection::LambertConformalConic) {
+        qWarning() << "Unsupported raster tile archive" << path;
+        pages.close();
+        return false;
+    }
+    projectionType = MapProjection::Type(projection);
+    size = tileSize;
+    minLevel = first;
+    maxLevel = last;
+    qDebug() << "Raster tiles:" << pages.pageCount() << "tiles, levels" << minLevel << "-" << maxLevel << "from" << path;
+    return true;
+}
+
+void RasterTileArchive::close()
+{
+    QMutexLocker locker(&mutex);
+    cache.clear();
+    pages.close();
+    maxLevel = -1;
+}
+
+int RasterTileArchive::levelFor(double pixelsPerUnit) const
+{
+    if (!isOpen() || maxLevel < 0) return -1;
+
+    // Smallest level whose tiles are at least as sharp as the view
+    int level = int(std::ceil(std::log2(pixelsPerUnit * WORLD_SPAN / size)));
+    if (level <= maxLevel) return qMax(level, minLevel);
+    double deepest = size * double(1 << maxLevel) / WORLD_SPAN;
+    return pixelsPerUnit <= 2 * deepest ? maxLevel : -1;
+}
+
+QImage RasterTileArchive::tile(int level, int x, int y) const
+{
+    quint64 key = tileKey(level, x, y);
+    {
+        QMutexLocker locker(&mutex);
+        if (QImage *cached = cache.object(key)) return *cached;
+    }
+
+    // Decoded outside the lock, so render bands decode in parallel. The page
+    // points into the mapping; decoding copies it out.
+    QByteArray png = pages.page(key);
+    if (png.isEmpty()) return QImage();
+    QImage image = QImage::fromData(png, "PNG");
+    if (image.isNull()) {
+        qWarning() << "Could not decode raster tile" << level << x << y;
+        return image;
+    }
+    image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    QMutexLocker locker(&mutex);
+    cache.insert(key, new QImage(image), qMax(1, int(image.sizeInBytes() / 1024)));
+    return image;
+}
+
+int RasterTileArchive::cachedKilobytes() const
+{
+    QMutexLocker locker(&mutex);
+    return cache.totalCost();
+}
+
+QRectF RasterTileArchive::tileRect(int level, int x, int y)
+{
+    double span = WORLD_SPAN / (1 << level);
+    return QRectF(-WORLD_SPAN / 2 + x * span, WORLD_SPAN / 2 - (y + 1) * span, span, span);
+}
+
+QRect RasterTileArchive::tileRange(const QRectF &projected, int level)
+{
+    int n = 1 << level;
+    double span = WORLD_SPAN / n;
+    int x0 = qBound(0, int(std::floor((projected.left() + WORLD_SPAN / 2) / span)), n - 1);
+    int x1 = qBound(0, int(std::floor((projected.right() + WORLD_SPAN / 2) / span)), n - 1);
+    int y0 = qBound(0, int(std::floor((WORLD_SPAN / 2 - projected.bottom()) / span)), n - 1);
+    int y1 = qBound(0, int(std::floor((WORLD_SPAN / 2 - projected.top()) / span)), n - 1);
+    return QRect(QPoint(x0, y0), QPoint(x1, y1));
+}
+
+quint64 RasterTileArchive::tileKey(int level, int x, int y)
+{
+    // Level in bits 48+, y in bits 24-47, x in bits 0-23
+    return (quint64(level) << 48) | (quint64(y) << 24) | quint64(x);
+}
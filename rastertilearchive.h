@@ -0,0 +1,76 @@
+#ifndef RASTERTILEARCHIVE_H
+#define RASTERTILEARCHIVE_H
+
+#include <QString>
+#include <QImage>
+#include <QRect>
+#include <QRectF>
+#include <QCache>
+#include <QMutex>
+#include "featurestore.h"
+#include "mapprojection.h"
+
+// Pre-rendered raster tiles of the static layers in one packed file.
+//
+// Tiles sit on a power-of-two grid over the projected plane: level 0 is one
+// tile spanning 360 projected units from (-180, 180), and every level halves
+// the span. The archive is a FeatureStore with one PNG page per tile,
+// written by maprender --archive and read memory-mapped, so drawing a tile
+// costs a decode (once, then cached) and a blit.
+class RasterTileArchive
+{
+public:
+    class Writer
+    {
+    public:
+        Writer(const QString &path, MapProjection::Type projection, int tileSize);
+
+        bool isOk() const { return pages.isOk(); }
+        // Not thread-safe; callers rendering in parallel serialize the adds
+        void addTile(int level, int x, int y, const QImage &image);
+        bool finish();
+
+    private:
+        FeatureStore::Writer pages;
+        MapProjection::Type projection;
+        int tileSize;
+        int minLevel, maxLevel;
+    };
+
+    RasterTileArchive();
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return pages.isOpen(); }
+
+    MapProjection::Type projection() const { return projectionType; }
+    int tileSize() const { return size; }
+
+    // Level to draw at the given zoom, or -1 when even the deepest level
+    // would be magnified more than twice (the vector layers look better)
+    int levelFor(double pixelsPerUnit) const;
+
+    // Decoded tile, or a null image if the archive has none. Thread-safe,
+    // but must not overlap open() or close(), which remap the file.
+    QImage tile(int level, int x, int y) const;
+    int cachedKilobytes() const; // Decoded tiles
+
+    // Tile grid in projected units (y north)
+    static QRectF tileRect(int level, int x, int y);
+    static QRect tileRange(const QRectF &projected, int level); // Clamped to the grid
+
+    static const int MAX_LEVEL;
+
+private:
+    static quint64 tileKey(int level, int x, int y);
+
+    FeatureStore pages; // Tile key -> PNG
+    MapProjection::Type projectionType;
+    int size;
+    int minLevel, maxLevel;
+
+    mutable QCache<quint64, QImage> cache; // Decoded tiles, cost in kilobytes
+    mutable QMutex mutex;
+};
+
+#endif // RASTERTILEARCHIVE_H
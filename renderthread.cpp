@@ -0,0 +1,103 @@
+#include "renderthread.h"
+#include <QMutexLocker>
+
+RenderThread::RenderThread(QObject *parent)
+    : QThread(parent)
+    , hasPending(false)
+    , rendering(false)
+    , stopping(false)
+    , hasReady(false)
+    , nextRequest(1)
+{
+}
+
+RenderThread::~RenderThread()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        hasPending = false;
+        wake.wakeAll();
+    }
+    wait();
+}
+
+int RenderThread::publish(const MapScene &scene, int generation, bool speculative)
+{
+    QMutexLocker locker(&mutex);
+    if (speculative && hasPending && !pendingInfo.speculative) return 0;
+
+    pending = scene;
+    pendingInfo.view = scene.view;
+    pendingInfo.generation = generation;
+    pendingInfo.request = nextRequest++;
+    pendingInfo.speculative = speculative;
+    hasPending = true;
+
+    if (!isRunning()) start(QThread::HighPriority);
+    wake.wakeAll();
+    return pendingInfo.request;
+}
+
+bool RenderThread::takeFrame(Frame &frame)
+{
+    QMutexLocker locker(&mutex);
+    if (!hasReady) return false;
+    frame = ready;
+    ready = Frame();
+    hasReady = false;
+    return true;
+}
+
+bool RenderThread::isBusy() const
+{
+    QMutexLocker locker(&mutex);
+    return hasPending || rendering;
+}
+
+void RenderThread::waitForIdle()
+{
+    QMutexLocker locker(&mutex);
+    while (hasPending || rendering) {
+        idle.wait(&mutex);
+    }
+}
+
+void RenderThread::run()
+{
+    QMutexLocker locker(&mutex);
+    for (;;) {
+        while (!hasPending && !stopping) {
+            wake.wait(&mutex);
+        }
+        if (stopping) break;
+
+        // Take the snapshot out of the mailbox so the GUI can queue the next
+        MapScene scene = pending;
+        Frame frame = pendingInfo;
+        pending = MapScene();
+        hasPending = false;
+        rendering = true;
+
+        locker.unlock();
+        frame.image = renderer.renderStaticLayers(scene);
+        frame.stats = renderer.frameStats();
+        scene = MapScene(); // Drop the shared data outside the lock
+        locker.relock();
+
+        // A newer frame overwrites one the GUI has not taken yet, except
+        // that a prefetch never displaces a frame the view asked for
+        rendering = false;
+        if (!hasReady || !frame.speculative || ready.speculative) {
+            ready = frame;
+            hasReady = true;
+        }
+        if (!hasPending) idle.wakeAll();
+
+        locker.unlock();
+        emit frameReady();
+        locker.relock();
+    }
+    rendering = false;
+    idle.wakeAll();
+}
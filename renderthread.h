@@ -0,0 +1,73 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QImage>
+#include "maprenderer.h"
+
+// Rasterizes the static layers off the GUI thread.
+//
+// The GUI publishes scene snapshots and takes finished frames; neither side
+// ever waits for the other. Snapshots are immutable (their vectors are
+// implicitly shared copies), so the GUI can go on editing its data while a
+// frame renders. There are three buffers: the pending snapshot, replaced by
+// every newer one so a superseded view is never started; the frame being
+// rendered; and the finished frame waiting to be taken. The frame on screen
+// is the widget's own.
+class RenderThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    struct Frame {
+        QImage image;
+        MapView view;
+        int generation = 0; // Data generation the snapshot was taken at
+        int request = 0;    // Increases with every publish()
+        bool speculative = false;
+        MapRenderer::FrameStats stats; // Scratch use while rendering it
+    };
+
+    explicit RenderThread(QObject *parent = nullptr);
+    ~RenderThread() override; // Stops after the frame in progress
+
+    // Queues a snapshot, replacing one not yet started. A speculative
+    // snapshot (a prefetch) never replaces a frame the view is waiting for.
+    // Returns the request number, or 0 if the snapshot was dropped.
+    int publish(const MapScene &scene, int generation, bool speculative = false);
+
+    // Moves the newest finished frame into frame; false if there is none
+    bool takeFrame(Frame &frame);
+
+    bool isBusy() const; // A snapshot is pending or rendering
+
+    // Blocks until nothing is pending or rendering. For callers about to
+    // close or remap data that snapshots point at.
+    void waitForIdle();
+
+signals:
+    // Emitted from the render thread; connections to GUI objects are queued
+    void frameReady();
+
+protected:
+    void run() override;
+
+private:
+    MapRenderer renderer;
+
+    mutable QMutex mutex;
+    QWaitCondition wake; // Signalled on publish and stop
+    QWaitCondition idle; // Signalled when a frame finishes with nothing pending
+    MapScene pending;
+    Frame pendingInfo; // Everything but the image
+    bool hasPending;
+    bool rendering;
+    bool stopping;
+    Frame ready;
+    bool hasReady;
+    int nextRequest;
+};
+
+#endif // RENDERTHREAD_H
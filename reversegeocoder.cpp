@@ -0,0 +1,216 @@
+#include "reversegeocoder.h"
+#include <QtMath>
+#include <cmath>
+
+const int ReverseGeocoder::EDGES_PER_SLAB = 8;     // Average edges tested per query
+const int ReverseGeocoder::STATIONS_PER_CELL = 4;
+const int ReverseGeocoder::MAX_GRID_SIZE = 1024;   // Cells per side
+
+static const double EARTH_RADIUS_KM = 6371.0;
+static const double DEG = M_PI / 180.0;
+
+static double haversineKm(const QPointF &a, const QPointF &b)
+{
+    double dLat = (b.y() - a.y()) * DEG;
+    double dLon = (b.x() - a.x()) * DEG;
+    double h = std::sin(dLat / 2) * std::sin(dLat / 2)
+             + std::cos(a.y() * DEG) * std::cos(b.y() * DEG) * std::sin(dLon / 2) * std::sin(dLon / 2);
+    return 2 * EARTH_RADIUS_KM * std::asin(std::sqrt(qMin(1.0, h)));
+}
+
+ReverseGeocoder::ReverseGeocoder()
+    : lonScale(1.0)
+    , cellSize(1.0)
+    , gridWidth(0)
+    , gridHeight(0)
+{
+}
+
+ReverseGeocoder::IndexedPolygon ReverseGeocoder::indexPolygon(int feature, const QPolygonF &ring)
+{
+    IndexedPolygon polygon;
+    polygon.feature = feature;
+    polygon.ring = ring;
+    polygon.bounds = ring.boundingRect();
+
+    int edgeCount = ring.size();
+    int slabCount = qBound(1, edgeCount / EDGES_PER_SLAB, 4096);
+    polygon.slabHeight = polygon.bounds.height() > 0 ? polygon.bounds.height() / slabCount : 1.0;
+
+    auto slabOf = [&](double y) {
+        return qBound(0, int((y - polygon.bounds.top()) / polygon.slabHeight), slabCount - 1);
+    };
+
+    // Each edge goes into every slab its latitude range overlaps
+    polygon.slabStart.fill(0, slabCount + 1);
+    for (int i = 0; i < edgeCount; ++i) {
+        const QPointF &a = ring[i], &b = ring[(i + 1) % edgeCount];
+        for (int s = slabOf(qMin(a.y(), b.y())); s <= slabOf(qMax(a.y(), b.y())); ++s) {
+            ++polygon.slabStart[s + 1];
+        }
+    }
+    for (int s = 0; s < slabCount; ++s) {
+        polygon.slabStart[s + 1] += polygon.slabStart[s];
+    }
+
+    polygon.slabEdges.resize(polygon.slabStart[slabCount]);
+    QVector<int> cursor = polygon.slabStart;
+    for (int i = 0; i < edgeCount; ++i) {
+        const QPointF &a = ring[i], &b = ring[(i + 1) % edgeCount];
+        for (int s = slabOf(qMin(a.y(), b.y())); s <= slabOf(qMax(a.y(), b.y())); ++s) {
+            polygon.slabEdges[cursor[s]++] = i;
+        }
+    }
+    return polygon;
+}
+
+void ReverseGeocoder::setFeatures(const QVector<StateFeature> &features)
+{
+    polygons.clear();
+    for (int f = 0; f < features.size(); ++f) {
+        for (const auto &ring : features[f].polygons) {
+            if (ring.size() >= 3) polygons.append(indexPolygon(f, ring));
+        }
+    }
+}
+
+bool ReverseGeocoder::contains(const IndexedPolygon &polygon, const QPointF &point)
+{
+    if (!polygon.bounds.contains(point)) return false;
+
+    int slabCount = polygon.slabStart.size() - 1;
+    int slab = qBound(0, int((point.y() - polygon.bounds.top()) / polygon.slabHeight), slabCount - 1);
+
+    // Ray casting towards +x; only edges spanning the point's latitude can
+    // cross the ray, and they are all in this slab
+    const QPolygonF &ring = polygon.ring;
+    int edgeCount = ring.size();
+    bool inside = false;
+    for (int k = polygon.slabStart[slab]; k < polygon.slabStart[slab + 1]; ++k) {
+        int i = polygon.slabEdges[k];
+        const QPointF &a = ring[i], &b = ring[(i + 1) % edgeCount];
+        if ((a.y() > point.y()) != (b.y() > point.y())) {
+            double x = a.x() + (point.y() - a.y()) * (b.x() - a.x()) / (b.y() - a.y());
+            if (point.x() < x) inside = !inside;
+        }
+    }
+    return inside;
+}
+
+int ReverseGeocoder::featureAt(double lat, double lon) const
+{
+    QPointF point(lon, lat);
+    for (const auto &polygon : polygons) {
+        if (contains(polygon, point)) return polygon.feature;
+    }
+    return -1;
+}
+
+QPointF ReverseGeocoder::gridPoint(double lat, double lon) const
+{
+    return QPointF(lon * lonScale, lat);
+}
+
+void ReverseGeocoder::setStations(const QVector<Station> &stations)
+{
+    stationPoints.clear();
+    stationGeo.clear();
+    cellStart.clear();
+    cellStations.clear();
+    gridWidth = gridHeight = 0;
+    if (stations.isEmpty()) return;
+
+    double latSum = 0;
+    for (const auto &station : stations) latSum += station.lat;
+    lonScale = std::cos(latSum / stations.size() * DEG);
+
+    stationPoints.reserve(stations.size());
+    stationGeo.reserve(stations.size());
+    for (const auto &station : stations) {
+        stationPoints.append(gridPoint(station.lat, station.lon));
+        stationGeo.append(QPointF(station.lon, station.lat));
+    }
+
+    QRectF bounds = QPolygonF(stationPoints).boundingRect();
+    double width = bounds.width(), height = bounds.height();
+    cellSize = std::sqrt(qMax(width * height, 1e-9) * STATIONS_PER_CELL / stations.size());
+    cellSize = qMax(cellSize, qMax(width, height) / (MAX_GRID_SIZE - 1));
+    cellSize = qMax(cellSize, 1e-6);
+    gridOrigin = bounds.topLeft();
+    gridWidth = int(width / cellSize) + 1;
+    gridHeight = int(height / cellSize) + 1;
+
+    auto cellOf = [&](const QPointF &p) {
+        int cx = qBound(0, int((p.x() - gridOrigin.x()) / cellSize), gridWidth - 1);
+        int cy = qBound(0, int((p.y() - gridOrigin.y()) / cellSize), gridHeight - 1);
+        return cy * gridWidth + cx;
+    };
+
+    cellStart.fill(0, gridWidth * gridHeight + 1);
+    for (const QPointF &p : stationPoints) ++cellStart[cellOf(p) + 1];
+    for (int c = 0; c < gridWidth * gridHeight; ++c) cellStart[c + 1] += cellStart[c];
+
+    cellStations.resize(stationPoints.size());
+    QVector<int> cursor = cellStart;
+    for (int i = 0; i < stationPoints.size(); ++i) {
+        cellStations[cursor[cellOf(stationPoints[i])]++] = i;
+    }
+}
+
+QVector<ReverseGeocoder::NearbyStation> ReverseGeocoder::nearestStations(double lat, double lon, int count) const
+{
+    QVector<NearbyStation> result;
+    if (count <= 0 || stationPoints.isEmpty()) return result;
+    count = qMin(count, stationPoints.size());
+
+    QPointF query = gridPoint(lat, lon);
+    int cx = qBound(0, qFloor((query.x() - gridOrigin.x()) / cellSize), gridWidth - 1);
+    int cy = qBound(0, qFloor((query.y() - gridOrigin.y()) / cellSize), gridHeight - 1);
+
+    // Best candidates so far, ascending squared grid distance
+    struct Candidate {
+        int station;
+        double distance2;
+    };
+    QVector<Candidate> best;
+    best.reserve(count + 1);
+
+    auto visitCell = [&](int x, int y) {
+        if (x < 0 || y < 0 || x >= gridWidth || y >= gridHeight) return;
+        int cell = y * gridWidth + x;
+        for (int k = cellStart[cell]; k < cellStart[cell + 1]; ++k) {
+            int station = cellStations[k];
+            QPointF d = stationPoints[station] - query;
+            double distance2 = d.x() * d.x() + d.y() * d.y();
+            if (best.size() == count && distance2 >= best.last().distance2) continue;
+
+            int position = best.size();
+            while (position > 0 && best[position - 1].distance2 > distance2) --position;
+            best.insert(position, Candidate{ station, distance2 });
+            if (best.size() > count) best.removeLast();
+        }
+    };
+
+    int maxRing = qMax(gridWidth, gridHeight);
+    for (int ring = 0; ring <= maxRing; ++ring) {
+        for (int x = cx - ring; x <= cx + ring; ++x) {
+            visitCell(x, cy - ring);
+            if (ring > 0) visitCell(x, cy + ring);
+        }
+        for (int y = cy - ring + 1; y <= cy + ring - 1; ++y) {
+            visitCell(cx - ring, y);
+            visitCell(cx + ring, y);
+        }
+
+        // Cells beyond this ring are at least ring cells away
+        double reach = ring * cellSize;
+        if (best.size() == count && best.last().distance2 <= reach * reach) break;
+    }
+
+    QPointF queryGeo(lon, lat);
+    result.reserve(best.size());
+    for (const Candidate &candidate : best) {
+        result.append(NearbyStation{ candidate.station, haversineKm(queryGeo, stationGeo[candidate.station]) });
+    }
+    return result;
+}
@@ -0,0 +1,69 @@
+#ifndef REVERSEGEOCODER_H
+#define REVERSEGEOCODER_H
+
+#include <QVector>
+#include <QPointF>
+#include <QRectF>
+#include <QPolygonF>
+#include "maprenderer.h"
+
+// Geographic lookups for an arbitrary point (lon/lat degrees): which state
+// polygon contains it, and which stations are closest.
+//
+// Polygons are pruned by bounding box, then tested by ray casting against
+// only the edges of the horizontal slab the point falls in. Stations sit in
+// a uniform grid searched ring by ring outwards from the query point.
+class ReverseGeocoder
+{
+public:
+    struct NearbyStation {
+        int station;       // Index into the stations passed to setStations()
+        double distanceKm; // Great-circle distance
+    };
+
+    ReverseGeocoder();
+
+    void setStations(const QVector<Station> &stations);
+    void setFeatures(const QVector<StateFeature> &features);
+
+    // Index of the first feature whose polygons contain the point, or -1.
+    // Line features (rivers) never match.
+    int featureAt(double lat, double lon) const;
+
+    // Up to count stations, nearest first
+    QVector<NearbyStation> nearestStations(double lat, double lon, int count) const;
+
+private:
+    struct IndexedPolygon {
+        int feature;
+        QRectF bounds;
+        QPolygonF ring;
+        double slabHeight;
+        QVector<int> slabStart; // Slab s holds slabEdges[slabStart[s] .. slabStart[s + 1])
+        QVector<int> slabEdges; // Edge i runs from ring[i] to ring[i + 1] (wrapping)
+    };
+
+    static IndexedPolygon indexPolygon(int feature, const QPolygonF &ring);
+    static bool contains(const IndexedPolygon &polygon, const QPointF &point);
+    QPointF gridPoint(double lat, double lon) const;
+
+    QVector<IndexedPolygon> polygons;
+
+    // Station grid in (lon * cos(refLat), lat), so cells are roughly square
+    // on the ground and Euclidean distance ranks like ground distance
+    QVector<QPointF> stationPoints;
+    QVector<QPointF> stationGeo; // (lon, lat)
+    double lonScale;
+    QPointF gridOrigin;
+    double cellSize;
+    int gridWidth;
+    int gridHeight;
+    QVector<int> cellStart;
+    QVector<int> cellStations;
+
+    static const int EDGES_PER_SLAB;
+    static const int STATIONS_PER_CELL;
+    static const int MAX_GRID_SIZE;
+};
+
+#endif // REVERSEGEOCODER_H
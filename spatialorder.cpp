@@ -0,0 +1,54 @@
+#include "spatialorder.h"
+#include <QRectF>
+#include <QPair>
+#include <algorithm>
+
+quint64 SpatialOrder::hilbertIndex(int order, quint32 x, quint32 y)
+{
+    // Classic xy -> d: walk the quadrants from the top bit, rotating the
+    // frame so every sub-square is entered where the curve enters it
+    quint64 d = 0;
+    for (quint32 s = order > 0 ? 1u << (order - 1) : 0; s > 0; s >>= 1) {
+        quint32 rx = (x & s) ? 1 : 0;
+        quint32 ry = (y & s) ? 1 : 0;
+        d += quint64(s) * s * ((3 * rx) ^ ry);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - (x & (s - 1));
+                y = s - 1 - (y & (s - 1));
+            }
+            std::swap(x, y);
+        }
+    }
+    return d;
+}
+
+QVector<int> SpatialOrder::hilbertOrder(const QVector<QPointF> &points, int order)
+{
+    // QRectF::united() ignores empty rects, so the bounds are grown by hand
+    QRectF bounds;
+    if (!points.isEmpty()) bounds = QRectF(points.first(), QSizeF(0, 0));
+    for (const QPointF &point : points) {
+        bounds.setLeft(qMin(bounds.left(), point.x()));
+        bounds.setRight(qMax(bounds.right(), point.x()));
+        bounds.setTop(qMin(bounds.top(), point.y()));
+        bounds.setBottom(qMax(bounds.bottom(), point.y()));
+    }
+
+    // Square grid, so the curve is not stretched along the longer side
+    double side = qMax(qMax(bounds.width(), bounds.height()), 1e-9);
+    quint32 cells = 1u << order;
+    QVector<QPair<quint64, int>> keyed;
+    keyed.reserve(points.size());
+    for (int i = 0; i < points.size(); ++i) {
+        quint32 x = quint32(qBound(0.0, (points[i].x() - bounds.left()) / side * cells, cells - 1.0));
+        quint32 y = quint32(qBound(0.0, (points[i].y() - bounds.top()) / side * cells, cells - 1.0));
+        keyed.append(qMakePair(hilbertIndex(order, x, y), i));
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    QVector<int> result;
+    result.reserve(keyed.size());
+    for (const auto &key : keyed) result.append(key.second);
+    return result;
+}
@@ -0,0 +1,24 @@
+#ifndef SPATIALORDER_H
+#define SPATIALORDER_H
+
+#include <QVector>
+#include <QPointF>
+
+// Hilbert-curve ordering of points and tiles.
+//
+// Sorting data along the curve keeps things that are near each other on the
+// map near each other in memory (or on disk), so loops over a viewport walk
+// contiguous runs instead of jumping across the whole array.
+class SpatialOrder
+{
+public:
+    // Position of cell (x, y) along the Hilbert curve over a 2^order grid
+    static quint64 hilbertIndex(int order, quint32 x, quint32 y);
+
+    // Permutation that visits the points along a Hilbert curve over their
+    // bounding box: result[i] is the index of the i-th point in curve order.
+    // Points in the same cell keep their relative order.
+    static QVector<int> hilbertOrder(const QVector<QPointF> &points, int order = 16);
+};
+
+#endif // SPATIALORDER_H
@@ -0,0 +1,55 @@
+#include "stationlistmodel.h"
+
+StationListModel::StationListModel(const QVector<Station> *stations, const QVector<int> *stationSlots, QObject *parent)
+    : QAbstractListModel(parent)
+    , stations(stations)
+    , stationSlots(stationSlots)
+    , filtered(false)
+{
+}
+
+void StationListModel::reload()
+{
+    beginResetModel();
+    endResetModel();
+}
+
+void StationListModel::setFilter(const QVector<int> &stationIds)
+{
+    beginResetModel();
+    rows = stationIds;
+    filtered = true;
+    endResetModel();
+}
+
+void StationListModel::clearFilter()
+{
+    beginResetModel();
+    rows.clear();
+    filtered = false;
+    endResetModel();
+}
+
+int StationListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) return 0;
+    return filtered ? rows.size() : stations->size();
+}
+
+QVariant StationListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount()) return QVariant();
+
+    int station = stationAt(index.row());
+    if (station >= stationSlots->size()) return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        return stations->at(stationSlots->at(station)).name;
+    case Qt::UserRole:
+        return station;
+    default:
+        return QVariant();
+    }
+}
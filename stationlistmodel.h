@@ -0,0 +1,40 @@
+#ifndef STATIONLISTMODEL_H
+#define STATIONLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QVector>
+#include "maprenderer.h"
+
+// Read-only list model over the widget's station store, shared by the trip
+// planner combo boxes. Rows are served on demand straight from the store, so
+// attaching it to a view does not copy or enumerate the stations.
+// Rows follow station ids (file order), not the spatial storage order;
+// Qt::UserRole holds the station id. A filter restricts the rows to a list
+// of station ids, e.g. search results.
+class StationListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    // stationSlots maps a station id to its index in stations
+    StationListModel(const QVector<Station> *stations, const QVector<int> *stationSlots, QObject *parent = nullptr);
+
+    // Call after the station store was replaced
+    void reload();
+    
+    void setFilter(const QVector<int> &stationIds);
+    void clearFilter();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private:
+    int stationAt(int row) const { return filtered ? rows[row] : row; }
+    
+    const QVector<Station> *stations;
+    const QVector<int> *stationSlots;
+    QVector<int> rows;
+    bool filtered;
+};
+
+#endif // STATIONLISTMODEL_H
@@ -0,0 +1,265 @@
+#include "stationsearchindex.h"
+#include <algorithm>
+#include <cmath>
+
+const int StationSearchIndex::MAX_FUZZY_POSTINGS_DIVISOR = 4; // Trigrams in over 1/4 of stations carry no signal
+const int StationSearchIndex::MIN_FUZZY_PERCENT = 50;         // Query trigrams a fuzzy match must share
+
+// Prefix scores; the name length is subtracted (up to 99) so shorter names
+// win ties, and fuzzy matches (at most 200) always rank below prefix matches
+static const int SCORE_CODE_EXACT = 1000;
+static const int SCORE_CODE_PREFIX = 800;
+static const int SCORE_FIRST_WORD_EXACT = 700;
+static const int SCORE_FIRST_WORD_PREFIX = 600;
+static const int SCORE_WORD_EXACT = 500;
+static const int SCORE_WORD_PREFIX = 400;
+
+namespace {
+
+bool better(const StationSearchIndex::Match &a, const StationSearchIndex::Match &b)
+{
+    return a.score > b.score || (a.score == b.score && a.station < b.station);
+}
+
+} // namespace
+
+StationSearchIndex::StationSearchIndex()
+{
+}
+
+void StationSearchIndex::clear()
+{
+    tokenText.clear();
+    tokens.clear();
+    stationFirstToken.clear();
+    sortedTokens.clear();
+    nameLengths.clear();
+    trigramStations.clear();
+}
+
+QStringList StationSearchIndex::splitWords(const QString &text)
+{
+    QStringList words;
+    QString word;
+    for (QChar c : text) {
+        if (c.isLetterOrNumber()) {
+            word += c.toLower();
+        } else if (!word.isEmpty()) {
+            words.append(word);
+            word.clear();
+        }
+    }
+    if (!word.isEmpty()) words.append(word);
+    return words;
+}
+
+quint64 StationSearchIndex::trigramKey(QChar a, QChar b, QChar c)
+{
+    return (quint64(a.unicode()) << 32) | (quint64(b.unicode()) << 16) | c.unicode();
+}
+
+void StationSearchIndex::appendTrigrams(const QString &word, QVector<quint64> &keys)
+{
+    // Padded so word starts and ends count, and one-letter words have one
+    QString padded = QLatin1Char(' ') + word + QLatin1Char(' ');
+    for (int i = 0; i + 2 < padded.size(); ++i) {
+        keys.append(trigramKey(padded[i], padded[i + 1], padded[i + 2]));
+    }
+}
+
+void StationSearchIndex::build(const QVector<Station> &stations)
+{
+    clear();
+    stationFirstToken.reserve(stations.size() + 1);
+    nameLengths.reserve(stations.size());
+
+    QVector<quint64> keys;
+    for (int i = 0; i < stations.size(); ++i) {
+        const QString &name = stations[i].name;
+        stationFirstToken.append(tokens.size());
+        nameLengths.append(name.size());
+
+        // "New Delhi (NDLS)" -> words "new", "delhi" and code "ndls"
+        QString words = name, code;
+        int open = name.lastIndexOf(QLatin1Char('('));
+        int close = name.lastIndexOf(QLatin1Char(')'));
+        if (open >= 0 && close > open) {
+            code = name.mid(open + 1, close - open - 1);
+            words = name.left(open);
+        }
+
+        keys.clear();
+        auto addTokens = [&](const QStringList &list, bool isCode) {
+            for (int w = 0; w < list.size(); ++w) {
+                Token token;
+                token.offset = tokenText.size();
+                token.length = list[w].size();
+                token.station = i;
+                token.code = isCode;
+                token.first = !isCode && w == 0;
+                tokens.append(token);
+                tokenText += list[w];
+                appendTrigrams(list[w], keys);
+            }
+        };
+        addTokens(splitWords(words), false);
+        addTokens(splitWords(code), true);
+
+        // Stations are visited in order, so posting lists come out sorted
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        for (quint64 key : keys) {
+            trigramStations[key].append(i);
+        }
+    }
+    stationFirstToken.append(tokens.size());
+
+    sortedTokens.resize(tokens.size());
+    for (int i = 0; i < sortedTokens.size(); ++i) sortedTokens[i] = i;
+    const QChar *text = tokenText.constData();
+    std::sort(sortedTokens.begin(), sortedTokens.end(), [&](int a, int b) {
+        const Token &ta = tokens[a], &tb = tokens[b];
+        const QChar *da = text + ta.offset, *db = text + tb.offset;
+        if (std::lexicographical_compare(da, da + ta.length, db, db + tb.length)) return true;
+        if (std::lexicographical_compare(db, db + tb.length, da, da + ta.length)) return false;
+        return a < b;
+    });
+}
+
+bool StationSearchIndex::tokenHasPrefix(const Token &token, const QString &prefix) const
+{
+    return token.length >= prefix.size()
+        && std::equal(prefix.constData(), prefix.constData() + prefix.size(), tokenText.constData() + token.offset);
+}
+
+StationSearchIndex::Range StationSearchIndex::prefixRange(const QString &prefix) const
+{
+    const QChar *text = tokenText.constData();
+    const QChar *p = prefix.constData();
+    int length = prefix.size();
+
+    // First token not below the prefix, then first token past the prefix
+    // once both are cut to the prefix length
+    auto begin = std::lower_bound(sortedTokens.begin(), sortedTokens.end(), 0, [&](int index, int) {
+        const Token &token = tokens[index];
+        const QChar *d = text + token.offset;
+        return std::lexicographical_compare(d, d + token.length, p, p + length);
+    });
+    auto end = std::upper_bound(begin, sortedTokens.end(), 0, [&](int, int index) {
+        const Token &token = tokens[index];
+        const QChar *d = text + token.offset;
+        return std::lexicographical_compare(p, p + length, d, d + qMin(token.length, length));
+    });
+
+    Range range;
+    range.begin = int(begin - sortedTokens.begin());
+    range.end = int(end - sortedTokens.begin());
+    return range;
+}
+
+bool StationSearchIndex::stationHasPrefix(int station, const QString &prefix) const
+{
+    for (int t = stationFirstToken[station]; t < stationFirstToken[station + 1]; ++t) {
+        if (tokenHasPrefix(tokens[t], prefix)) return true;
+    }
+    return false;
+}
+
+void StationSearchIndex::offer(QVector<Match> &top, const Match &match, int limit)
+{
+    // A station reached through several tokens keeps its best score
+    for (int i = 0; i < top.size(); ++i) {
+        if (top[i].station == match.station) {
+            if (!better(match, top[i])) return;
+            top.remove(i);
+            break;
+        }
+    }
+    if (top.size() == limit && !better(match, top.last())) return;
+
+    auto position = std::find_if(top.begin(), top.end(), [&](const Match &other) { return better(match, other); });
+    top.insert(position, match);
+    if (top.size() > limit) top.removeLast();
+}
+
+QVector<StationSearchIndex::Match> StationSearchIndex::search(const QString &query, int limit) const
+{
+    QVector<Match> top;
+    QStringList terms = splitWords(query);
+    if (terms.isEmpty() || limit <= 0 || tokens.isEmpty()) return top;
+    top.reserve(limit + 1);
+
+    // The narrowest term drives the scan; the others only filter
+    QVector<Range> ranges;
+    int driver = 0;
+    for (int i = 0; i < terms.size(); ++i) {
+        ranges.append(prefixRange(terms[i]));
+        if (ranges[i].end - ranges[i].begin < ranges[driver].end - ranges[driver].begin) driver = i;
+    }
+
+    int termLength = terms[driver].size();
+    for (int i = ranges[driver].begin; i < ranges[driver].end; ++i) {
+        const Token &token = tokens[sortedTokens[i]];
+        bool exact = token.length == termLength;
+
+        Match match;
+        match.station = token.station;
+        if (token.code) {
+            match.score = exact ? SCORE_CODE_EXACT : SCORE_CODE_PREFIX;
+        } else if (token.first) {
+            match.score = exact ? SCORE_FIRST_WORD_EXACT : SCORE_FIRST_WORD_PREFIX;
+        } else {
+            match.score = exact ? SCORE_WORD_EXACT : SCORE_WORD_PREFIX;
+        }
+        match.score -= qMin(nameLengths[token.station], 99);
+
+        // Cheap rejection before the per-term checks
+        if (top.size() == limit && !better(match, top.last())) continue;
+
+        bool allTerms = true;
+        for (int t = 0; t < terms.size() && allTerms; ++t) {
+            if (t != driver) allTerms = stationHasPrefix(token.station, terms[t]);
+        }
+        if (allTerms) offer(top, match, limit);
+    }
+
+    if (top.size() == limit) return top;
+
+    // Too few prefix matches: rank stations by shared query trigrams
+    QVector<quint64> keys;
+    for (const QString &term : terms) appendTrigrams(term, keys);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    int maxPostings = qMax(1, stationCount() / MAX_FUZZY_POSTINGS_DIVISOR);
+    QVector<const QVector<int> *> postings;
+    for (quint64 key : keys) {
+        auto it = trigramStations.constFind(key);
+        if (it != trigramStations.constEnd() && it->size() <= maxPostings) postings.append(&it.value());
+    }
+    if (postings.isEmpty()) return top;
+
+    // Counted over the posting hits only, sorted so each station's hits
+    // are one run: no per-keystroke buffer of every station
+    QVector<int> hits;
+    int hitCount = 0;
+    for (const QVector<int> *list : postings) hitCount += list->size();
+    hits.reserve(hitCount);
+    for (const QVector<int> *list : postings) hits += *list;
+    std::sort(hits.begin(), hits.end());
+
+    int used = postings.size();
+    int needed = int(std::ceil(used * MIN_FUZZY_PERCENT / 100.0));
+    for (int i = 0; i < hits.size();) {
+        int station = hits[i];
+        int run = i;
+        while (i < hits.size() && hits[i] == station) ++i;
+        int count = i - run;
+        if (count < needed) continue;
+        Match match;
+        match.station = station;
+        match.score = 2 * (count * 100 / used);
+        offer(top, match, limit);
+    }
+    return top;
+}
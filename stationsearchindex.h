@@ -0,0 +1,73 @@
+#ifndef STATIONSEARCHINDEX_H
+#define STATIONSEARCHINDEX_H
+
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include "maprenderer.h"
+
+// Ranked, typo-tolerant station lookup for the trip planner.
+//
+// Station names are split into lower-cased word tokens; the text inside the
+// trailing parentheses ("New Delhi (NDLS)") is the station code. Tokens are
+// kept in one sorted table, which works as a flattened prefix trie: the
+// entries sharing a prefix are one contiguous range found by binary search.
+// When prefix matching yields too few results, a trigram index over the
+// same tokens supplies fuzzy matches ("lucnow" -> "Lucknow").
+//
+// search() does not modify the index, so one index may serve several
+// callers and threads once built.
+class StationSearchIndex
+{
+public:
+    struct Match {
+        int station; // Index into the stations passed to build()
+        int score;   // Higher is better
+    };
+
+    StationSearchIndex();
+
+    void build(const QVector<Station> &stations);
+    void clear();
+    int stationCount() const { return nameLengths.size(); }
+
+    // Best matches first. Every query word must prefix-match a word of the
+    // station name or its code; fuzzy matches fill up the remaining slots.
+    QVector<Match> search(const QString &query, int limit = 20) const;
+
+private:
+    struct Token {
+        int offset;  // Into tokenText
+        int length;
+        int station;
+        bool code;
+        bool first;  // First word of the name
+    };
+
+    struct Range {
+        int begin;
+        int end;
+    };
+
+    static QStringList splitWords(const QString &text);
+    static quint64 trigramKey(QChar a, QChar b, QChar c);
+    static void appendTrigrams(const QString &word, QVector<quint64> &keys);
+
+    bool tokenHasPrefix(const Token &token, const QString &prefix) const;
+    Range prefixRange(const QString &prefix) const;
+    bool stationHasPrefix(int station, const QString &prefix) const;
+    static void offer(QVector<Match> &top, const Match &match, int limit);
+
+    QString tokenText;                // All tokens back to back
+    QVector<Token> tokens;            // In station order
+    QVector<int> stationFirstToken;   // stationCount() + 1 offsets into tokens
+    QVector<int> sortedTokens;        // Indices into tokens, lexicographic
+    QVector<int> nameLengths;
+    QHash<quint64, QVector<int>> trigramStations; // Posting lists, ascending
+
+    static const int MAX_FUZZY_POSTINGS_DIVISOR;
+    static const int MIN_FUZZY_PERCENT;
+};
+
+#endif // STATIONSEARCHINDEX_H
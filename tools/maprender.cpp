@@ -0,0 +1,380 @@
+// Headless batch renderer for map images.
+//
+// Renders the same static layers as the map widget (boundary, states,
+// railway track and stations) to PNG files, with no window system, spreading
+// the images over all cores. Usage:
+//   maprender [options] jobs.txt
+//
+// Every line of the job file that is not empty or a '#' comment is
+//   name minLon minLat maxLon maxLat [zoom,zoom,...]
+// Without zooms, one --size image is fitted to the box (name.png). With
+// zooms, one image per zoom covers the box at that widget zoom value
+// (name_z<zoom>.png). With --tiles, each zoom is an integer tile level and
+// the box is covered by square tiles, written as name/<level>/<x>/<y>.png;
+// level 0 is one tile spanning 360 projected units. With --archive, the
+// tiles of all boxes go into one packed archive instead, which the map
+// widget can use as its base layer (sample --raster-tiles).
+// --pack-vector-tiles packs a directory of Mapbox Vector Tiles into such an
+// archive for sample --vector-tiles.
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QSet>
+#include <QScopedPointer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QImage>
+#include <QtMath>
+#include <cmath>
+#include <algorithm>
+#include "maprenderer.h"
+#include "geometrytilestore.h"
+#include "geojsonloader.h"
+#include "spatialorder.h"
+#include "rastertilearchive.h"
+#include "mapstyle.h"
+#include "vectortilesource.h"
+
+namespace {
+
+QTextStream out(stdout);
+
+const int MAX_IMAGE_SIZE = 16384; // Pixels per side; larger images are skipped
+
+struct RenderJob {
+    MapView view;
+    QString path;  // PNG file, or "level/x/y" for archive tiles
+    int level = -1; // Tile jobs only
+    int x = 0, y = 0;
+};
+
+// Where finished images go; shared by all tasks
+struct RenderOutput {
+    RasterTileArchive::Writer *archive = nullptr;
+    QMutex archiveMutex;
+    QAtomicInt failures;
+};
+
+// Renders one job on a pool thread. Each task has its own single-threaded
+// renderer: the pool already keeps every core busy with whole images.
+class RenderTask : public QRunnable
+{
+public:
+    RenderTask(const MapScene &scene, const RenderJob &job, RenderOutput &output)
+        : scene(scene), job(job), output(output) {}
+
+    void run() override
+    {
+        scene.view = job.view;
+        MapRenderer renderer(1);
+        QImage image = renderer.renderStaticLayers(scene);
+        if (output.archive && !image.isNull()) {
+            QMutexLocker locker(&output.archiveMutex);
+            output.archive->addTile(job.level, job.x, job.y, image);
+        } else if (image.isNull() || !QDir().mkpath(QFileInfo(job.path).path()) || !image.save(job.path, "PNG")) {
+            qWarning() << "Could not write" << job.path;
+            output.failures.ref();
+        }
+    }
+
+private:
+    MapScene scene;
+    RenderJob job;
+    RenderOutput &output;
+};
+
+// Projected bounds of a lon/lat box; the edges are sampled because
+// projected parallels can curve
+QRectF projectedBounds(const QRectF &geo, const MapProjection &projection)
+{
+    const int STEPS = 8;
+    QPolygonF edge;
+    for (int i = 0; i <= STEPS; ++i) {
+        double t = double(i) / STEPS;
+        edge << QPointF(geo.left() + t * geo.width(), geo.top())
+             << QPointF(geo.left() + t * geo.width(), geo.bottom())
+             << QPointF(geo.left(), geo.top() + t * geo.height())
+             << QPointF(geo.right(), geo.top() + t * geo.height());
+    }
+    projection.forward(edge.constData(), edge.data(), edge.size());
+    return edge.boundingRect();
+}
+
+// A view of the given size and zoom centred on a projected point
+MapView viewAt(const QPointF &projectedCenter, double scale, const QSize &size, const MapProjection &projection)
+{
+    MapView view;
+    QPointF center = projection.inverse(projectedCenter);
+    view.centerLon = center.x();
+    view.centerLat = center.y();
+    view.scale = scale;
+    view.size = size;
+    view.projection = projection;
+    return view;
+}
+
+bool parseSize(const QString &text, QSize &size)
+{
+    QStringList parts = text.toLower().split('x');
+    bool okWidth = false, okHeight = false;
+    if (parts.size() == 2) size = QSize(parts[0].toInt(&okWidth), parts[1].toInt(&okHeight));
+    return okWidth && okHeight && size.width() > 0 && size.height() > 0
+        && size.width() <= MAX_IMAGE_SIZE && size.height() <= MAX_IMAGE_SIZE;
+}
+
+// Expands one job file line into render jobs; false if it is malformed
+bool parseJobLine(const QString &line, const QSize &imageSize, bool tiles, int tileSize, bool archive,
+                  const MapProjection &projection, const QString &outputDir, QVector<RenderJob> &jobs)
+{
+    QStringList fields = line.simplified().split(' ');
+    if (fields.size() != 5 && fields.size() != 6) return false;
+
+    QString name = fields[0];
+    double coords[4];
+    for (int i = 0; i < 4; ++i) {
+        bool ok = false;
+        coords[i] = fields[i + 1].toDouble(&ok);
+        if (!ok) return false;
+    }
+    QRectF geo(QPointF(coords[0], coords[1]), QPointF(coords[2], coords[3]));
+    if (!geo.isValid()) return false;
+    QRectF bounds = projectedBounds(geo, projection);
+
+    QVector<double> zooms;
+    if (fields.size() == 6) {
+        for (const QString &field : fields[5].split(',')) {
+            bool ok = false;
+            double zoom = field.toDouble(&ok);
+            if (!ok || zoom <= 0 || (tiles && (zoom != std::floor(zoom) || zoom > RasterTileArchive::MAX_LEVEL))) return false;
+            zooms.append(zoom);
+        }
+    }
+    if (tiles && zooms.isEmpty()) return false;
+
+    QDir dir(outputDir);
+    if (zooms.isEmpty()) {
+        // Fit the box into the requested image size
+        double pixelsPerUnit = qMin(imageSize.width() / qMax(bounds.width(), 1e-9),
+                                    imageSize.height() / qMax(bounds.height(), 1e-9));
+        jobs.append({ viewAt(bounds.center(), pixelsPerUnit / 100, imageSize, projection),
+                      dir.filePath(name + ".png") });
+        return true;
+    }
+
+    for (double zoom : zooms) {
+        if (!tiles) {
+            double pixelsPerUnit = zoom * 100;
+            QSize size(qCeil(bounds.width() * pixelsPerUnit), qCeil(bounds.height() * pixelsPerUnit));
+            if (size.width() > MAX_IMAGE_SIZE || size.height() > MAX_IMAGE_SIZE) {
+                qWarning() << "Skipping" << name << "at zoom" << zoom << "- image would be" << size;
+                continue;
+            }
+            jobs.append({ viewAt(bounds.center(), zoom, size.expandedTo(QSize(1, 1)), projection),
+                          dir.filePath(QString("%1_z%2.png").arg(name).arg(zoom)) });
+            continue;
+        }
+
+        // Same grid as the widget's raster base layer
+        int level = int(zoom);
+        QRect range = RasterTileArchive::tileRange(bounds, level);
+        for (int y = range.top(); y <= range.bottom(); ++y) {
+            for (int x = range.left(); x <= range.right(); ++x) {
+                QRectF rect = RasterTileArchive::tileRect(level, x, y);
+                QString path = archive ? QString("%1/%2/%3").arg(level).arg(x).arg(y)
+                                       : dir.filePath(QString("%1/%2/%3/%4.png").arg(name).arg(level).arg(x).arg(y));
+                jobs.append({ viewAt(rect.center(), tileSize / rect.width() / 100, QSize(tileSize, tileSize), projection),
+                              path, level, x, y });
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    // No window system needed
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders map images for a list of bounding boxes and zoom levels.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("jobs", "Job file: one 'name minLon minLat maxLon maxLat [zoom,...]' per line.");
+    QCommandLineOption dataOption("data", "Directory with the GeoJSON data files.", "dir", ".");
+    QCommandLineOption outputOption("output", "Directory the images are written to.", "dir", ".");
+    QCommandLineOption sizeOption("size", "Image size for boxes without zooms.", "WxH", "1024x768");
+    QCommandLineOption tilesOption("tiles", "Write tile sets; zooms are integer tile levels.");
+    QCommandLineOption tileSizeOption("tile-size", "Tile size in pixels.", "pixels", "256");
+    QCommandLineOption projectionOption("projection",
+        "Map projection: equirectangular (default), mercator or lcc.", "name", "equirectangular");
+    QCommandLineOption archiveOption("archive", "Write the tiles of all boxes into one tile archive (implies --tiles).", "file");
+    QCommandLineOption threadsOption("threads", "Images rendered at once (default: one per core).", "count");
+    QCommandLineOption styleOption("style", "Style sheet (default: mapstyle.json in the data directory, if any).", "file");
+    QCommandLineOption packOption("pack-vector-tiles",
+        "Pack a directory of z/x/y.mvt vector tiles into the --archive file and exit.", "dir");
+    parser.addOptions({ dataOption, outputOption, sizeOption, tilesOption, tileSizeOption, archiveOption,
+                        projectionOption, threadsOption, styleOption, packOption });
+    parser.process(app);
+
+    // Packing needs no jobs file
+    if (parser.isSet(packOption)) {
+        if (!parser.isSet(archiveOption)) {
+            qWarning() << "--pack-vector-tiles needs --archive";
+            return 1;
+        }
+        return VectorTileSource::pack(parser.value(packOption), parser.value(archiveOption)) ? 0 : 1;
+    }
+
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+
+    bool ok = false;
+    MapProjection projection(MapProjection::typeFromName(parser.value(projectionOption), &ok));
+    if (!ok) {
+        qWarning() << "Unknown projection" << parser.value(projectionOption);
+        return 1;
+    }
+    QSize imageSize;
+    if (!parseSize(parser.value(sizeOption), imageSize)) {
+        qWarning() << "Invalid image size" << parser.value(sizeOption);
+        return 1;
+    }
+    int tileSize = parser.value(tileSizeOption).toInt();
+    if (tileSize <= 0 || tileSize > MAX_IMAGE_SIZE) {
+        qWarning() << "Invalid tile size" << parser.value(tileSizeOption);
+        return 1;
+    }
+
+    // Jobs first, so a bad job file fails before the data is loaded
+    QFile jobFile(parser.positionalArguments().first());
+    if (!jobFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning() << "Could not open" << jobFile.fileName();
+        return 1;
+    }
+    bool archive = parser.isSet(archiveOption);
+    QVector<RenderJob> parsed;
+    int lineNumber = 0;
+    while (!jobFile.atEnd()) {
+        QString line = QString::fromUtf8(jobFile.readLine()).trimmed();
+        ++lineNumber;
+        if (line.isEmpty() || line.startsWith('#')) continue;
+        if (!parseJobLine(line, imageSize, archive || parser.isSet(tilesOption), tileSize, archive, projection,
+                          parser.value(outputOption), parsed)) {
+            qWarning() << "Invalid job on line" << lineNumber << ":" << line;
+            return 1;
+        }
+    }
+
+    // Overlapping boxes share tiles; each is rendered once. Tiles are
+    // queued level by level along the Hilbert curve, so neighbouring tiles
+    // finish (and land in the archive) close together.
+    QVector<RenderJob> jobs;
+    QSet<QString> seen;
+    for (const RenderJob &job : parsed) {
+        if (seen.contains(job.path)) continue;
+        seen.insert(job.path);
+        jobs.append(job);
+    }
+    std::stable_sort(jobs.begin(), jobs.end(), [](const RenderJob &a, const RenderJob &b) {
+        if (a.level != b.level) return a.level < b.level;
+        return a.level >= 0 && SpatialOrder::hilbertIndex(a.level, a.x, a.y) < SpatialOrder::hilbertIndex(b.level, b.x, b.y);
+    });
+
+    // Same data and store as the widget: boundary, states and railway lines
+    // stream from the geometry store when it matches the GeoJSON
+    QDir data(parser.value(dataOption));
+    QString storePath = data.filePath("geometry.store");
+    QString stamp = GeoJsonLoader::sourceStamp({ data.filePath("india_boundary_detailed.geojson"),
+                                                 data.filePath("states.geojson"),
+                                                 data.filePath("railways.geojson") });
+    QVector<QPolygonF> boundary;
+    QVector<StateFeature> features;
+    GeometryTileStore store;
+    if (!store.open(storePath) || store.sourceStamp() != stamp) {
+        store.close();
+        boundary = GeoJsonLoader::loadBoundary(data.filePath("india_boundary_detailed.geojson"));
+        features = GeoJsonLoader::loadStateBoundaries(data.filePath("states.geojson"))
+                 + GeoJsonLoader::loadRailwayLines(data.filePath("railways.geojson"));
+        // Without a writable store the loaded geometry is drawn from memory
+        if (GeometryTileStore::build(storePath, features, boundary, stamp)) store.open(storePath);
+    }
+    if (store.isOpen()) {
+        GeometryTileStore::Overview overview = store.overview();
+        boundary = overview.boundary;
+        features = overview.features;
+    }
+
+    // Same style as the widget unless another sheet is given
+    MapStyle style;
+    QString stylePath = parser.isSet(styleOption) ? parser.value(styleOption) : data.filePath("mapstyle.json");
+    if ((parser.isSet(styleOption) || QFileInfo::exists(stylePath)) && !style.load(stylePath)) {
+        return 1;
+    }
+
+    MapScene scene;
+    for (const auto &polygon : boundary) {
+        scene.indiaBoundary.append(LocalPolygon::fromGeo(polygon, projection, true));
+    }
+    for (auto &feature : features) {
+        feature.reproject(projection);
+    }
+    style.compile(features);
+    scene.stateBoundaries = features;
+    scene.style = &style;
+    scene.tileStore = &store;
+
+    // Track through the stations in file order; stations drawn in Hilbert order
+    QVector<Station> stations = GeoJsonLoader::loadStations(data.filePath("stations.geojson"));
+    QVector<QPointF> points;
+    for (const auto &station : stations) points.append(QPointF(station.lon, station.lat));
+    QVector<QPointF> trackNodes(points.size());
+    projection.forward(points.constData(), trackNodes.data(), points.size());
+    TrackGeometryCache trackCache;
+    trackCache.setNodes(trackNodes);
+    scene.trackCache = &trackCache;
+    for (int index : SpatialOrder::hilbertOrder(points)) scene.stations.append(stations[index]);
+
+    out << QString("%1 stations, %2 features%3\n").arg(scene.stations.size()).arg(features.size())
+           .arg(store.isOpen() ? QString(", streamed from ") + storePath : QString());
+    out.flush();
+
+    RenderOutput output;
+    QScopedPointer<RasterTileArchive::Writer> archiveWriter;
+    if (archive) {
+        archiveWriter.reset(new RasterTileArchive::Writer(parser.value(archiveOption), projection.type(), tileSize));
+        if (!archiveWriter->isOk()) return 1;
+        output.archive = archiveWriter.data();
+    }
+
+    QThreadPool pool;
+    if (parser.isSet(threadsOption)) pool.setMaxThreadCount(qMax(1, parser.value(threadsOption).toInt()));
+    QElapsedTimer timer;
+    timer.start();
+    for (const RenderJob &job : jobs) {
+        pool.start(new RenderTask(scene, job, output));
+    }
+    pool.waitForDone();
+    if (archiveWriter && !archiveWriter->finish()) {
+        qWarning() << "Could not write" << parser.value(archiveOption);
+        return 1;
+    }
+
+    double seconds = timer.nsecsElapsed() / 1e9;
+    int failures = output.failures.load();
+    out << QString("rendered %1 images in %2 s (%3 ms/image, %4 threads), %5 failed\n")
+           .arg(jobs.size() - failures).arg(seconds, 0, 'f', 2)
+           .arg(jobs.isEmpty() ? 0.0 : seconds * 1000 / jobs.size(), 0, 'f', 1)
+           .arg(pool.maxThreadCount()).arg(failures);
+    return failures == 0 ? 0 : 1;
+}
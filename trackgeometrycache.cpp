@@ -0,0 +1,301 @@
+#include "trackgeometrycache.h"
+#include <QtMath>
+#include <QMutexLocker>
+#include <QPair>
+#include <cmath>
+#include <iterator>
+
+const int TrackGeometryCache::BANDS_PER_OCTAVE = 4;   // Reference scale within ~19% of the real one
+const int TrackGeometryCache::MAX_CACHED_BANDS = 3;
+const double TrackGeometryCache::CELL_SIZE = 1024.0;  // World pixels per cache cell
+
+// Same palette as the old per-segment drawRailwayTrack
+const QBrush TrackGeometryCache::LAYER_BRUSHES[LayerCount] = {
+    QColor(101, 67, 33),        // Wooden sleepers
+    QColor(150, 150, 150, 60),  // Ballast bed
+    QColor(0, 0, 0, 80),        // Rail shadows
+    QColor(192, 192, 192),      // Steel rails
+    QColor(220, 220, 220, 150)  // Rail highlights
+};
+
+// Railway track dimensions in pixels
+static const double RAIL_GAUGE = 6.0;
+static const double SLEEPER_WIDTH = 10.0;
+static const double SLEEPER_SPACING = 15.0;
+static const double RAIL_WIDTH = 2.5;
+static const double TRACK_HALF_WIDTH = RAIL_GAUGE + 2.0;
+
+TrackGeometryCache::TrackGeometryCache()
+{
+}
+
+void TrackGeometryCache::setNodes(const QVector<QPointF> &newNodes)
+{
+    QMutexLocker locker(&mutex);
+    nodes = newNodes;
+    bands.clear();
+}
+
+void TrackGeometryCache::clear()
+{
+    QMutexLocker locker(&mutex);
+    bands.clear();
+}
+
+int TrackGeometryCache::bandForScale(double pixelsPerUnit)
+{
+    return static_cast<int>(std::floor(std::log2(pixelsPerUnit) * BANDS_PER_OCTAVE));
+}
+
+quint64 TrackGeometryCache::cellKey(int cx, int cy)
+{
+    return (static_cast<quint64>(static_cast<quint32>(cx)) << 32) | static_cast<quint32>(cy);
+}
+
+TrackGeometryCache::Band &TrackGeometryCache::bandFor(int bandIndex)
+{
+    auto it = bands.find(bandIndex);
+    if (it != bands.end()) {
+        return it.value();
+    }
+
+    // Evict the band furthest from the requested one
+    while (bands.size() >= MAX_CACHED_BANDS) {
+        if (qAbs(bands.firstKey() - bandIndex) > qAbs(bands.lastKey() - bandIndex)) {
+            bands.erase(bands.begin());
+        } else {
+            bands.erase(std::prev(bands.end()));
+        }
+    }
+
+    Band band;
+    band.worldScale = std::exp2(static_cast<double>(bandIndex) / BANDS_PER_OCTAVE);
+
+    // Segments and the cell they belong to; cell paths are built lazily
+    for (int i = 0; i < nodes.size() - 1; ++i) {
+        Segment segment;
+        segment.start = QPointF(nodes[i].x() * band.worldScale, -nodes[i].y() * band.worldScale);
+        segment.end = QPointF(nodes[i + 1].x() * band.worldScale, -nodes[i + 1].y() * band.worldScale);
+        segment.length = QLineF(segment.start, segment.end).length();
+
+        // Don't draw if too short
+        if (segment.length < 2) continue;
+
+        segment.bounds = QRectF(segment.start, segment.end).normalized()
+            .adjusted(-TRACK_HALF_WIDTH, -TRACK_HALF_WIDTH, TRACK_HALF_WIDTH, TRACK_HALF_WIDTH);
+
+        int index = band.segments.size();
+        band.segments.append(segment);
+
+        if (segment.length > CELL_SIZE) {
+            band.longSegments.append(index);
+            continue;
+        }
+
+        QPointF mid = (segment.start + segment.end) / 2.0;
+        int cx = qFloor(mid.x() / CELL_SIZE), cy = qFloor(mid.y() / CELL_SIZE);
+        Cell &cell = band.cells[cellKey(cx, cy)];
+        cell.origin = QPointF(cx * CELL_SIZE, cy * CELL_SIZE);
+        cell.bounds = cell.bounds.isNull() ? segment.bounds : cell.bounds.united(segment.bounds);
+        cell.segments.append(index);
+    }
+
+    return bands.insert(bandIndex, band).value();
+}
+
+void TrackGeometryCache::buildCell(const Band &band, Cell &cell)
+{
+    for (int i = 0; i < LayerCount; ++i) {
+        cell.layers[i] = QPainterPath();
+        // Overlapping joints must not cancel out
+        cell.layers[i].setFillRule(Qt::WindingFill);
+    }
+
+    for (int index : cell.segments) {
+        const Segment &segment = band.segments[index];
+        appendSegment(cell.layers, segment, 0.0, segment.length, cell.origin);
+    }
+
+    cell.built = true;
+}
+
+static void addTrackRect(QPainterPath &path, const QPointF &origin, const QPointF &u, const QPointF &n,
+                         double x, double y, double w, double h)
+{
+    // Rectangle in track-local coordinates (x along the track, y across it)
+    path.moveTo(origin + u * x + n * y);
+    path.lineTo(origin + u * (x + w) + n * y);
+    path.lineTo(origin + u * (x + w) + n * (y + h));
+    path.lineTo(origin + u * x + n * (y + h));
+    path.closeSubpath();
+}
+
+void TrackGeometryCache::appendSegment(QPainterPath *layers, const Segment &segment, double from, double to,
+                                       const QPointF &offset)
+{
+    QPointF u = (segment.end - segment.start) / segment.length;
+    QPointF n(-u.y(), u.x());
+    QPointF o = segment.start - offset;
+    double length = to - from;
+
+    // Sleepers stay on the global spacing grid even when the segment is clipped
+    int first = qMax(0, qCeil((from - 2.0) / SLEEPER_SPACING));
+    for (int i = first; ; ++i) {
+        double x = i * SLEEPER_SPACING;
+        if (x > to || x > segment.length) break;
+        addTrackRect(layers[SleeperLayer], o, u, n, x - 2, -SLEEPER_WIDTH / 2, 4, SLEEPER_WIDTH);
+    }
+
+    addTrackRect(layers[BallastLayer], o, u, n, from, -RAIL_GAUGE - 2, length, RAIL_GAUGE * 2 + 4);
+
+    addTrackRect(layers[RailShadowLayer], o, u, n, from, -RAIL_GAUGE / 2 + 0.5, length, RAIL_WIDTH);
+    addTrackRect(layers[RailShadowLayer], o, u, n, from, RAIL_GAUGE / 2 + 0.5, length, RAIL_WIDTH);
+
+    addTrackRect(layers[RailLayer], o, u, n, from, -RAIL_GAUGE / 2, length, RAIL_WIDTH);
+    addTrackRect(layers[RailLayer], o, u, n, from, RAIL_GAUGE / 2, length, RAIL_WIDTH);
+
+    addTrackRect(layers[RailHighlightLayer], o, u, n, from, -RAIL_GAUGE / 2, length, RAIL_WIDTH * 0.4);
+    addTrackRect(layers[RailHighlightLayer], o, u, n, from, RAIL_GAUGE / 2, length, RAIL_WIDTH * 0.4);
+}
+
+bool TrackGeometryCache::clipSegment(const Segment &segment, const QRectF &rect, double &from, double &to)
+{
+    // Liang-Barsky clip of the centre line, as distances along the segment
+    QPointF d = segment.end - segment.start;
+    double t0 = 0.0, t1 = 1.0;
+    const double p[4] = { -d.x(), d.x(), -d.y(), d.y() };
+    const double q[4] = { segment.start.x() - rect.left(), rect.right() - segment.start.x(),
+                          segment.start.y() - rect.top(), rect.bottom() - segment.start.y() };
+
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.0) {
+            if (q[i] < 0.0) return false;
+            continue;
+        }
+        double r = q[i] / p[i];
+        if (p[i] < 0.0) {
+            t0 = qMax(t0, r);
+        } else {
+            t1 = qMin(t1, r);
+        }
+        if (t0 > t1) return false;
+    }
+
+    from = t0 * segment.length;
+    to = t1 * segment.length;
+    return to > from;
+}
+
+void TrackGeometryCache::draw(QPainter &painter, const ViewTransform &view, const QRectF &viewport, FrameArena &arena)
+{
+    if (view.pixelsPerUnit <= 0.0) return;
+
+    // Band workers may draw concurrently; building and eviction are
+    // serialized, and setNodes() may replace the nodes meanwhile
+    QMutexLocker locker(&mutex);
+    if (nodes.size() < 2) return;
+    int bandIndex = bandForScale(view.pixelsPerUnit);
+    Band &band = bandFor(bandIndex);
+
+    // World pixels -> screen pixels, relative to the camera position
+    double zoom = view.pixelsPerUnit / band.worldScale;
+    QPointF camera(view.center.x() * band.worldScale, -view.center.y() * band.worldScale);
+    QRectF visible = QRectF((viewport.topLeft() - view.screenCenter) / zoom + camera, viewport.size() / zoom)
+        .adjusted(-TRACK_HALF_WIDTH, -TRACK_HALF_WIDTH, TRACK_HALF_WIDTH, TRACK_HALF_WIDTH);
+
+    // Cells are keyed by segment midpoint, so look one cell beyond the view
+    ArenaVector<Cell *> visibleCells = arena.vector<Cell *>();
+    int cx0 = qFloor(visible.left() / CELL_SIZE) - 1;
+    int cx1 = qFloor(visible.right() / CELL_SIZE) + 1;
+    int cy0 = qFloor(visible.top() / CELL_SIZE) - 1;
+    int cy1 = qFloor(visible.bottom() / CELL_SIZE) + 1;
+
+    if (static_cast<qint64>(cx1 - cx0 + 1) * (cy1 - cy0 + 1) > band.cells.size()) {
+        for (auto it = band.cells.begin(); it != band.cells.end(); ++it) {
+            if (it.value().bounds.intersects(visible)) visibleCells.push_back(&it.value());
+        }
+    } else {
+        for (int cx = cx0; cx <= cx1; ++cx) {
+            for (int cy = cy0; cy <= cy1; ++cy) {
+                auto it = band.cells.find(cellKey(cx, cy));
+                if (it != band.cells.end() && it.value().bounds.intersects(visible)) {
+                    visibleCells.push_back(&it.value());
+                }
+            }
+        }
+    }
+
+    // Paths are implicitly shared, so drawing can happen outside the lock
+    // (one entry per cell and layer, layers innermost)
+    ArenaVector<QPair<QPointF, QPainterPath>> paths = arena.vector<QPair<QPointF, QPainterPath>>();
+    paths.reserve(visibleCells.size() * LayerCount);
+    for (Cell *cell : visibleCells) {
+        if (!cell->built) buildCell(band, *cell);
+        for (int i = 0; i < LayerCount; ++i) {
+            paths.push_back(qMakePair(cell->origin, cell->layers[i]));
+        }
+    }
+
+    ArenaVector<Segment> longSegments = arena.vector<Segment>();
+    for (int index : band.longSegments) {
+        if (band.segments[index].bounds.intersects(visible)) {
+            longSegments.push_back(band.segments[index]);
+        }
+    }
+    locker.unlock();
+
+    // Long segments only exist at deep zoom; clip them to what is on screen
+    // and rebase them on the corner of the visible area
+    QPointF frameOrigin = visible.topLeft();
+    QPainterPath clipped[LayerCount];
+    for (const Segment &segment : longSegments) {
+        double from, to;
+        if (clipSegment(segment, visible, from, to)) {
+            // Setting the fill rule allocates, so only once there is a segment
+            if (clipped[0].fillRule() != Qt::WindingFill) {
+                for (int i = 0; i < LayerCount; ++i) clipped[i].setFillRule(Qt::WindingFill);
+            }
+            appendSegment(clipped, segment, from, to, frameOrigin);
+        }
+    }
+
+    // Local origin -> screen; the origin offset is taken before scaling
+    auto localToScreen = [&](const QPointF &origin) {
+        return QTransform(zoom, 0, 0, zoom,
+                          (origin.x() - camera.x()) * zoom + view.screenCenter.x(),
+                          (origin.y() - camera.y()) * zoom + view.screenCenter.y());
+    };
+
+    // One brush change per layer for the whole network
+    painter.save();
+    QTransform base = painter.transform();
+    painter.setPen(Qt::NoPen);
+    for (int i = 0; i < LayerCount; ++i) {
+        painter.setBrush(LAYER_BRUSHES[i]);
+        for (size_t p = i; p < paths.size(); p += LayerCount) {
+            painter.setTransform(localToScreen(paths[p].first) * base);
+            painter.drawPath(paths[p].second);
+        }
+        if (!clipped[i].isEmpty()) {
+            painter.setTransform(localToScreen(frameOrigin) * base);
+            painter.drawPath(clipped[i]);
+        }
+    }
+    painter.restore();
+}
+
+qint64 TrackGeometryCache::cachedBytes() const
+{
+    QMutexLocker locker(&mutex);
+    qint64 bytes = qint64(nodes.capacity()) * sizeof(QPointF);
+    for (const Band &band : bands) {
+        bytes += qint64(band.segments.capacity()) * sizeof(Segment) + qint64(band.longSegments.capacity()) * sizeof(int);
+        for (const Cell &cell : band.cells) {
+            bytes += sizeof(Cell) + qint64(cell.segments.capacity()) * sizeof(int);
+            for (const QPainterPath &path : cell.layers) {
+                bytes += qint64(path.elementCount()) * sizeof(QPainterPath::Element);
+            }
+        }
+    }
+    return bytes;
+}
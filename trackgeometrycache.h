@@ -0,0 +1,97 @@
+#ifndef TRACKGEOMETRYCACHE_H
+#define TRACKGEOMETRYCACHE_H
+
+#include <QVector>
+#include <QHash>
+#include <QMap>
+#include <QPointF>
+#include <QRectF>
+#include <QColor>
+#include <QPainter>
+#include <QPainterPath>
+#include <QMutex>
+#include "localgeometry.h"
+
+// Batched railway track geometry.
+//
+// The track is a polyline through the station positions. Instead of drawing
+// every sleeper and rail with its own drawRect, the geometry of each layer
+// (sleepers, ballast, rail shadows, rails, highlights) is merged into one
+// QPainterPath per grid cell. Paths are built in "world" pixels at the
+// reference scale of a zoom band, so they stay valid while panning and while
+// zooming inside the band; the painter transform absorbs the difference.
+// The track's dimensions scale with it: sleepers and rails are filled
+// shapes, not strokes, so they cannot be drawn with cosmetic pens. On screen
+// they are up to ~19% off the fixed pixel sizes (BANDS_PER_OCTAVE = 4),
+// and snap back at each band change. Finer bands would narrow the drift at
+// the cost of more rebuilds while zooming.
+// Each cell's path is stored relative to the cell corner, so at deep zoom the
+// painter only ever sees small, camera-relative coordinates.
+class TrackGeometryCache
+{
+public:
+    TrackGeometryCache();
+
+    // Track nodes in projected units (x east, y north), connected in order
+    void setNodes(const QVector<QPointF> &nodes);
+    void clear();
+
+    // Draws the track with the given camera; per-frame lists come from arena.
+    // Safe to call from several render threads at once.
+    void draw(QPainter &painter, const ViewTransform &view, const QRectF &viewport, FrameArena &arena);
+
+    // Built cell paths and segment lists of every cached zoom band
+    qint64 cachedBytes() const;
+
+private:
+    enum Layer {
+        SleeperLayer = 0,
+        BallastLayer,
+        RailShadowLayer,
+        RailLayer,
+        RailHighlightLayer,
+        LayerCount
+    };
+
+    struct Segment {
+        QPointF start;  // World pixels at the band's reference scale
+        QPointF end;
+        double length;
+        QRectF bounds;
+    };
+
+    struct Cell {
+        QPointF origin; // Cell corner in world pixels; paths are relative to it
+        QRectF bounds;
+        QVector<int> segments;
+        bool built = false;
+        QPainterPath layers[LayerCount];
+    };
+
+    struct Band {
+        double worldScale = 1.0;  // World pixels per map unit
+        QVector<Segment> segments;
+        QVector<int> longSegments;  // Clipped to the viewport every frame
+        QHash<quint64, Cell> cells;
+    };
+
+    static int bandForScale(double pixelsPerUnit);
+    static quint64 cellKey(int cx, int cy);
+
+    Band &bandFor(int band);
+    void buildCell(const Band &band, Cell &cell);
+    static void appendSegment(QPainterPath *layers, const Segment &segment, double from, double to,
+                              const QPointF &offset);
+    static bool clipSegment(const Segment &segment, const QRectF &rect, double &from, double &to);
+
+    QVector<QPointF> nodes;
+    QMap<int, Band> bands;
+    mutable QMutex mutex;
+
+    static const int BANDS_PER_OCTAVE;
+    static const int MAX_CACHED_BANDS;
+    static const double CELL_SIZE;
+    static const QBrush LAYER_BRUSHES[LayerCount]; // Shared, so setting one does not allocate
+};
+
+#endif // TRACKGEOMETRYCACHE_H
@@ -0,0 +1,283 @@
+#include "vectortilesource.h"
+#include "spatialorder.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QHash>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QDebug>
+#include <algorithm>
+
+static const quint32 FORMAT_VERSION = 1;
+static const char *const TILE_SUFFIXES[] = { "mvt", "pbf" };
+
+namespace {
+
+// Decodes one tile of a features() call into its slot
+class DecodeTask : public QRunnable
+{
+public:
+    DecodeTask(const VectorTileSource &source, int level, const QPoint &position, VectorTileSource::TilePointer &result)
+        : source(source), level(level), position(position), result(result) {}
+
+    void run() override
+    {
+        result = source.tile(level, position.x(), position.y());
+    }
+
+private:
+    const VectorTileSource &source;
+    int level;
+    QPoint position;
+    VectorTileSource::TilePointer &result;
+};
+
+// Numeric entries of a directory, e.g. the levels or columns of a tile set
+QVector<int> numberedEntries(const QString &path, QDir::Filters filters, bool tileFiles)
+{
+    QVector<int> numbers;
+    for (const QFileInfo &entry : QDir(path).entryInfoList(filters | QDir::NoDotAndDotDot)) {
+        if (tileFiles && entry.suffix() != TILE_SUFFIXES[0] && entry.suffix() != TILE_SUFFIXES[1]) continue;
+        bool ok = false;
+        int number = (tileFiles ? entry.completeBaseName() : entry.fileName()).toInt(&ok);
+        if (ok && number >= 0) numbers.append(number);
+    }
+    std::sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+} // namespace
+
+VectorTileSource::VectorTileSource()
+    : firstLevel(0)
+    , lastLevel(-1)
+    , cache(64 * 1024) // Kilobytes
+{
+}
+
+bool VectorTileSource::open(const QString &path)
+{
+    close();
+
+    QMutexLocker locker(&mutex);
+    if (QFileInfo(path).isDir()) {
+        QVector<int> levels = numberedEntries(path, QDir::Dirs, false);
+        if (levels.isEmpty()) {
+            qWarning() << "No tile levels in" << path;
+            return false;
+        }
+        directory = path;
+        firstLevel = levels.first();
+        lastLevel = levels.last();
+        qDebug() << "Vector tiles: levels" << firstLevel << "-" << lastLevel << "in" << path;
+        return true;
+    }
+
+    if (!pages.open(path, true)) return false;
+    QDataStream stream(pages.metadata());
+    stream.setVersion(QDataStream::Qt_5_12);
+    quint32 version = 0;
+    qint32 first = 0, last = -1;
+    QVector<QRect> levelRanges;
+    stream >> version >> first >> last >> levelRanges;
+    if (version != FORMAT_VERSION || stream.status() != QDataStream::Ok || levelRanges.size() != qMax(0, last + 1)) {
+        qWarning() << "Unsupported vector tile archive" << path;
+        pages.close();
+        return false;
+    }
+    firstLevel = first;
+    lastLevel = last;
+    ranges = levelRanges;
+    qDebug() << "Vector tiles:" << pages.pageCount() << "tiles, levels" << firstLevel << "-" << lastLevel << "from" << path;
+    return true;
+}
+
+void VectorTileSource::close()
+{
+    QMutexLocker locker(&mutex);
+    cache.clear();
+    pages.close();
+    directory.clear();
+    ranges.clear();
+    firstLevel = 0;
+    lastLevel = -1;
+}
+
+QVector<QPoint> VectorTileSource::tilesAt(int level) const
+{
+    QVector<QPoint> tiles;
+    if (level < firstLevel || level > lastLevel) return tiles;
+
+    if (!directory.isEmpty()) {
+        QString levelPath = QString("%1/%2").arg(directory).arg(level);
+        for (int x : numberedEntries(levelPath, QDir::Dirs, false)) {
+            for (int y : numberedEntries(QString("%1/%2").arg(levelPath).arg(x), QDir::Files, true)) {
+                tiles.append(QPoint(x, y));
+            }
+        }
+        return tiles;
+    }
+
+    const QRect &range = ranges[level];
+    for (int y = range.top(); y <= range.bottom(); ++y) {
+        for (int x = range.left(); x <= range.right(); ++x) {
+            if (pages.find(tileKey(level, x, y))) tiles.append(QPoint(x, y));
+        }
+    }
+    return tiles;
+}
+
+QByteArray VectorTileSource::tileData(int level, int x, int y) const
+{
+    if (directory.isEmpty()) return pages.page(tileKey(level, x, y));
+
+    for (const char *suffix : TILE_SUFFIXES) {
+        QFile file(QString("%1/%2/%3/%4.%5").arg(directory).arg(level).arg(x).arg(y).arg(suffix));
+        if (file.open(QIODevice::ReadOnly)) return file.readAll();
+    }
+    return QByteArray();
+}
+
+VectorTileSource::TilePointer VectorTileSource::tile(int level, int x, int y) const
+{
+    quint64 key = tileKey(level, x, y);
+    {
+        QMutexLocker locker(&mutex);
+        if (TilePointer *cached = cache.object(key)) return *cached;
+    }
+
+    // Read and decoded outside the lock, so workers decode in parallel
+    QByteArray data = tileData(level, x, y);
+    if (data.isEmpty()) return TilePointer();
+    QSharedPointer<Tile> decoded(new Tile);
+    QString error;
+    if (!MvtDecoder::decode(data, level, x, y, decoded->layers, &error)) {
+        qWarning() << "Could not decode vector tile" << level << x << y << "-" << error;
+        return TilePointer();
+    }
+    for (const auto &layer : decoded->layers) {
+        for (const auto &feature : layer.features) {
+            decoded->bytes += int(sizeof(feature));
+            for (const auto &part : feature.parts) decoded->bytes += part.size() * int(sizeof(QPointF));
+        }
+    }
+
+    QMutexLocker locker(&mutex);
+    TilePointer result = decoded;
+    cache.insert(key, new TilePointer(result), qMax(1, decoded->bytes / 1024));
+    return result;
+}
+
+QVector<StateFeature> VectorTileSource::features(int level) const
+{
+    QVector<QPoint> positions = tilesAt(level);
+    QVector<TilePointer> tiles(positions.size());
+    {
+        QThreadPool pool;
+        for (int i = 0; i < positions.size(); ++i) {
+            pool.start(new DecodeTask(*this, level, positions[i], tiles[i]));
+        }
+        pool.waitForDone();
+    }
+
+    // In tile order, so the result does not depend on which worker finished first
+    QVector<StateFeature> features;
+    QHash<QString, int> polygonFeatures; // Layer and id (or name) -> index in features
+    for (const TilePointer &tile : tiles) {
+        if (!tile) continue;
+        for (const auto &layer : tile->layers) {
+            for (const auto &feature : layer.features) {
+                if (feature.type == MvtDecoder::Point) continue;
+
+                StateFeature base;
+                base.name = feature.properties.value("name").toString();
+                base.type = feature.properties.value("type").toString();
+                if (base.type.isEmpty()) base.type = layer.name;
+                base.minZoom = feature.properties.value("min_zoom").toDouble();
+
+                if (feature.type == MvtDecoder::LineString) {
+                    for (const QPolygonF &part : feature.parts) {
+                        StateFeature line = base;
+                        line.lineString = part;
+                        features.append(line);
+                    }
+                    continue;
+                }
+
+                // Fills merge into one feature (for lookups and the
+                // choropleth); outlines are lines, without the tile cuts
+                QString identity = feature.id ? QString::number(feature.id) : base.name;
+                QString key = layer.name + QLatin1Char('/') + identity;
+                int index = identity.isEmpty() ? -1 : polygonFeatures.value(key, -1);
+                if (index < 0) {
+                    index = features.size();
+                    features.append(base);
+                    features.last().outlined = false;
+                    if (!identity.isEmpty()) polygonFeatures.insert(key, index);
+                }
+                features[index].polygons += feature.parts;
+                for (const QPolygonF &outline : feature.outlines) {
+                    StateFeature line = base;
+                    line.lineString = outline;
+                    features.append(line);
+                }
+            }
+        }
+    }
+    qDebug() << "Vector tiles:" << features.size() << "features from" << positions.size() << "tiles at level" << level;
+    return features;
+}
+
+int VectorTileSource::cachedKilobytes() const
+{
+    QMutexLocker locker(&mutex);
+    return cache.totalCost() + pages.cachedKilobytes();
+}
+
+bool VectorTileSource::pack(const QString &directoryPath, const QString &archivePath)
+{
+    VectorTileSource source;
+    if (!QFileInfo(directoryPath).isDir() || !source.open(directoryPath)) return false;
+
+    struct Entry {
+        int level;
+        QPoint position;
+        quint64 order;
+    };
+    QVector<Entry> entries;
+    QVector<QRect> levelRanges(source.maxLevel() + 1);
+    for (int level = source.minLevel(); level <= source.maxLevel(); ++level) {
+        for (const QPoint &position : source.tilesAt(level)) {
+            entries.append(Entry{ level, position, SpatialOrder::hilbertIndex(level, position.x(), position.y()) });
+            levelRanges[level] |= QRect(position, QSize(1, 1));
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.level != b.level ? a.level < b.level : a.order < b.order;
+    });
+
+    FeatureStore::Writer writer(archivePath);
+    for (const Entry &entry : entries) {
+        writer.addPage(tileKey(entry.level, entry.position.x(), entry.position.y()),
+                       source.tileData(entry.level, entry.position.x(), entry.position.y()));
+    }
+
+    QByteArray metadata;
+    QDataStream stream(&metadata, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << FORMAT_VERSION << qint32(source.minLevel()) << qint32(source.maxLevel()) << levelRanges;
+    if (!writer.isOk() || !writer.finish(metadata)) {
+        qWarning() << "Could not write vector tile archive" << archivePath;
+        return false;
+    }
+    qDebug() << "Packed" << entries.size() << "vector tiles into" << archivePath;
+    return true;
+}
+
+quint64 VectorTileSource::tileKey(int level, int x, int y)
+{
+    // Level in bits 48+, y in bits 24-47, x in bits 0-23
+    return (quint64(level) << 48) | (quint64(y) << 24) | quint64(x);
+}
@@ -0,0 +1,79 @@
+#ifndef VECTORTILESOURCE_H
+#define VECTORTILESOURCE_H
+
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+#include <QPoint>
+#include <QRect>
+#include <QCache>
+#include <QMutex>
+#include <QSharedPointer>
+#include "featurestore.h"
+#include "mvtdecoder.h"
+#include "maprenderer.h"
+
+// Precomputed Mapbox Vector Tile sets as a source of map features.
+//
+// A source is a directory of z/x/y.mvt (or .pbf) files in the XYZ scheme,
+// or the same tiles packed into one FeatureStore archive by pack(). Tiles
+// are decoded on first use and kept in an LRU cache of decoded tiles, so
+// reading a tile set costs a protobuf decode per tile instead of a JSON
+// parse of the whole dataset. features() turns a level of the tile set into
+// StateFeatures, which then take the same projection, style and rendering
+// path as the GeoJSON layers.
+class VectorTileSource
+{
+public:
+    struct Tile {
+        QVector<MvtDecoder::Layer> layers;
+        int bytes = 0; // Decoded size estimate, the cache cost
+    };
+    typedef QSharedPointer<const Tile> TilePointer;
+
+    VectorTileSource();
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return !directory.isEmpty() || pages.isOpen(); }
+
+    // Zoom levels of the tile set; maxLevel() is -1 when it has none
+    int minLevel() const { return firstLevel; }
+    int maxLevel() const { return lastLevel; }
+
+    // Tiles present at a level, as (x, y)
+    QVector<QPoint> tilesAt(int level) const;
+
+    // Decoded tile through the cache; null if missing or unreadable.
+    // Thread-safe.
+    TilePointer tile(int level, int x, int y) const;
+
+    // Every feature of the tiles at a level, decoded on a worker pool.
+    // Polygons of one feature (same layer and id, or name when there is no
+    // id) are merged across tiles and filled, not outlined; their outlines,
+    // less the tile cuts, and each line part become features of their own;
+    // points are skipped. The type is the "type" property, or else the
+    // layer name, for the style rules to match; "name" and "min_zoom" are
+    // read as in the GeoJSON files.
+    QVector<StateFeature> features(int level) const;
+
+    int cachedKilobytes() const;
+
+    // Writes the tiles of a directory into one archive, near tiles stored
+    // near each other in the file
+    static bool pack(const QString &directoryPath, const QString &archivePath);
+
+private:
+    static quint64 tileKey(int level, int x, int y);
+    QByteArray tileData(int level, int x, int y) const; // Encoded
+
+    QString directory; // Set when reading loose files
+    FeatureStore pages; // Tile key -> encoded tile, when reading an archive
+    int firstLevel, lastLevel;
+    QVector<QRect> ranges; // Tiles present in an archive, per level
+
+    mutable QCache<quint64, TilePointer> cache; // Cost in kilobytes
+    mutable QMutex mutex;
+};
+
+#endif // VECTORTILESOURCE_H